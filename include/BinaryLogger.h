@@ -8,120 +8,491 @@
 #include <atomic>
 #include <chrono>
 #include <variant>
+#include <tuple>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
 #include <cstring> // for memcpy
+#include <exception>
 #include <iostream>
+#include "WalFile.h"
+#include "WalCodec.h"
+#include "Metrics.h"
 
-class BinaryLogger {
+// 持久化级别 (每张表单独选)
+enum Durability {
+    DURABILITY_ASYNC, // 后台线程定时写盘，不等 fdatasync (崩溃可能丢最近几毫秒)
+    DURABILITY_GROUP, // 组提交：写入线程等后台线程的下一次 fdatasync，一次同步覆盖一批事务
+    DURABILITY_SYNC   // 同步：写入线程自己刷盘 + fdatasync 后才返回
+};
+
+// 后台刷盘间隔随负载自适应：一批攒够 WAL_FLUSH_TARGET_BYTES 就缩短间隔，攒不满就拉长
+// 有人在等提交确认时不看间隔，立刻刷 (没有固定的等待下限)
+constexpr int64_t WAL_FLUSH_MIN_US = 100;
+constexpr int64_t WAL_FLUSH_MAX_US = 10000;
+constexpr size_t WAL_FLUSH_TARGET_BYTES = 256 * 1024;
+
+// 日志选项 (每张表单独选)
+struct WalOptions {
+    Durability durability = DURABILITY_ASYNC;
+    size_t streams = 1;              // 并行日志流个数
+    bool block_compression = false;  // 刷盘时整块 zlib 压缩 (编译时没有 zlib 则忽略)
+};
+
+// --- 日志流 ---
+// 一个流 = 一个缓冲 + 一个后台刷盘线程 + 一串段文件 <dir>/<流号>-<段号>.log
+// 记录按 WalCodec.h 的紧凑格式编码；每次刷盘把这一批包成一个块
+// 段写满 WAL_SEGMENT_BYTES (按编码后、压缩前的字节数算) 就换下一段；checkpoint 之后旧段整个删掉
+class LogStream {
 private:
-    std::fstream log_file; // fstream 既能读也能写
+    std::string log_dir;
+    size_t stream_id;
+    uint64_t segment_no;
+    std::unique_ptr<WalFile> wal;
+    Durability durability;
+    bool compress_blocks;
+    std::mutex io_mutex;   // 保护 wal 本身 (后台写盘 vs 同步提交 vs 换段/清空)
     std::atomic<bool> running{true};
     std::thread background_thread;
 
     // 缓冲区：这次存的是原始字节 (char)
-    std::vector<char> buffer; 
+    std::vector<char> buffer;
     std::mutex buffer_mutex;
     std::condition_variable cv;
+    std::vector<char> swap_buffer;  // 正在写盘的那一批 (受 io_mutex 保护)
+    std::vector<char> block_buffer; // 包好的块 (受 io_mutex 保护)
+    bool flush_requested = false;   // 组提交：有人在等，后台线程别睡了
+
+    // 编码状态跟着段走：缓冲里记下换段的位置，刷盘时在这些位置切开分别写进新旧段
+    WalEncoder encoder;                 // 受 buffer_mutex 保护
+    size_t segment_bytes = 0;           // 当前段 (编码中的) 已经写了多少字节
+    std::vector<size_t> segment_breaks; // buffer 里的换段位置
+    std::vector<size_t> swap_breaks;    // swap_buffer 里的换段位置 (受 io_mutex 保护)
+
+    // 流内序号：每条记录一个，按缓冲顺序递增 (提交确认看它，不看 lsn)
+    uint64_t next_seq = 0;                  // 受 buffer_mutex 保护
+    std::atomic<uint64_t> durable_seq{0};   // 已经 fdatasync 过的最大序号
+    std::mutex durable_mutex;
+    std::condition_variable durable_cv;
+
+    // 刷盘失败是粘住的：第一次的错误记下来，之后不再写这个流，等确认的和新来的写入都拿到这个错误
+    // (失败的那一批不能换回缓冲再写一遍，否则记录会重复或者乱序)
+    std::atomic<bool> failed{false};
+    std::exception_ptr failure;             // 受 durable_mutex 保护
 
-    const int FLUSH_INTERVAL_MS = 10; 
+    std::atomic<int64_t> flush_interval_us{WAL_FLUSH_MAX_US}; // 只有后台线程写
 
 public:
-    // truncate = true 表示清空旧日志（新表）
-    // truncate = false 表示保留旧日志（用于恢复）
-    BinaryLogger(const std::string& filename, bool truncate = true) {
-        auto mode = std::ios::out | std::ios::binary;
-        if (truncate) {
-            mode |= std::ios::trunc; // 清空文件
-        } else {
-            mode |= std::ios::app;   // 追加模式
-        }
-        
-        log_file.open(filename, mode);
-        
+    LogStream(const std::string& dir, size_t id, uint64_t first_segment, Durability level, bool compress)
+        : log_dir(dir), stream_id(id), segment_no(first_segment), durability(level), compress_blocks(compress) {
+        wal = std::make_unique<WalFile>(segmentPath(log_dir, stream_id, segment_no), true);
+
         buffer.reserve(65536); // 64KB Buffer
-        background_thread = std::thread(&BinaryLogger::worker_loop, this);
+        swap_buffer.reserve(65536);
+        background_thread = std::thread(&LogStream::worker_loop, this);
     }
 
-    ~BinaryLogger() {
+    ~LogStream() {
         running = false;
         cv.notify_all();
         if (background_thread.joinable()) background_thread.join();
-        if (log_file.is_open()) log_file.close();
+        // 后台线程退出前已经把缓冲写完，这里补一次同步 (流已经坏了就算了，错误早就报过)
+        std::lock_guard<std::mutex> io_lock(io_mutex);
+        try {
+            flushLocked(true);
+        } catch (...) {
+        }
+    }
+
+    static std::string segmentPath(const std::string& dir, size_t id, uint64_t segment) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%zu-%08llu.log", id, static_cast<unsigned long long>(segment));
+        return dir + "/" + name;
+    }
+
+    // 从文件名解析出 (流号, 段号)；不是段文件返回 false
+    static bool parseSegmentName(const std::string& name, size_t& id, uint64_t& segment) {
+        unsigned long long seg;
+        int consumed = 0;
+        if (std::sscanf(name.c_str(), "%zu-%llu.log%n", &id, &seg, &consumed) != 2) return false;
+        if (consumed != static_cast<int>(name.size())) return false;
+        segment = seg;
+        return true;
     }
 
     // --- 极速写入 (Binary Append) ---
-    // 这里的 row_data 包含 int 或 string
-    void appendEntry(const std::vector<std::variant<int, std::string>>& row) {
+    // 这里的 row_data 包含 int、string 或 NULL (std::monostate，稀疏行没给出的列)；返回流内序号 (给 waitDurableFor 用)
+    // 流已经刷盘失败时抛出那个错误
+    uint64_t append(const std::vector<std::variant<int, std::string, std::monostate>>& row, uint64_t lsn) {
+        throwIfFailed();
         std::lock_guard<std::mutex> lock(buffer_mutex);
-        
-        // 简单协议：直接按列顺序写入数据
-        for (const auto& val : row) {
-            if (std::holds_alternative<int>(val)) {
-                // 写入 Int (4 bytes)
-                int v = std::get<int>(val);
-                const char* ptr = reinterpret_cast<const char*>(&v);
-                buffer.insert(buffer.end(), ptr, ptr + sizeof(int));
-            } else {
-                // 写入 String: [Length 4bytes] + [Body]
-                const std::string& s = std::get<std::string>(val);
-                int len = static_cast<int>(s.size());
-                const char* len_ptr = reinterpret_cast<const char*>(&len);
-                
-                buffer.insert(buffer.end(), len_ptr, len_ptr + sizeof(int));
-                buffer.insert(buffer.end(), s.begin(), s.end());
-            }
+
+        size_t before = buffer.size();
+        segment_bytes += encoder.encode(buffer, row, lsn);
+
+        // 当前段写满：在这里切一刀，后面的记录用新段的字典编码
+        if (segment_bytes >= WAL_SEGMENT_BYTES) {
+            segment_breaks.push_back(buffer.size());
+            encoder.reset();
+            segment_bytes = 0;
         }
-        // 不需要换行符，因为是二进制流
+
+        // 缓冲刚攒满一批：不等间隔到期，叫醒后台线程
+        if (before < WAL_FLUSH_TARGET_BYTES && buffer.size() >= WAL_FLUSH_TARGET_BYTES) cv.notify_one();
+        return ++next_seq;
     }
 
-    // --- 恢复功能：读取整个日志 ---
-    // 需要传入文件名，因为 fstream 在构造函数里是以 write mode 打开的
-    static std::vector<std::vector<std::variant<int, std::string>>> readLog(
-        const std::string& filename, 
-        const std::vector<int>& col_types // 需要 Schema 才知道怎么读 (0:INT, 1:STRING)
-    ) {
-        std::vector<std::vector<std::variant<int, std::string>>> rows;
-        std::ifstream infile(filename, std::ios::binary);
-        if (!infile.is_open()) return rows;
-
-        while (infile.peek() != EOF) {
-            std::vector<std::variant<int, std::string>> row;
-            for (int type : col_types) {
-                if (type == 0) { // TYPE_INT
-                    int val;
-                    if (!infile.read(reinterpret_cast<char*>(&val), sizeof(int))) break;
-                    row.push_back(val);
-                } else { // TYPE_STRING
-                    int len;
-                    if (!infile.read(reinterpret_cast<char*>(&len), sizeof(int))) break;
-                    std::string s(len, ' '); // 预分配
-                    if (!infile.read(&s[0], len)) break;
-                    row.push_back(s);
-                }
+    bool isDurable(uint64_t seq) const {
+        return durable_seq.load(std::memory_order_acquire) >= seq;
+    }
+
+    // 等到 seq 这条记录 fdatasync 到盘上，最多等 timeout
+    // SYNC 级别由调用线程自己刷；其他级别叫醒后台线程，等它下一次组提交
+    // 后台线程正在 fdatasync 时到达的请求会合并进下一批，一次同步确认一群事务
+    // 这条记录还没落盘而流已经刷盘失败时抛出那个错误
+    bool waitDurableFor(uint64_t seq, std::chrono::microseconds timeout) {
+        if (isDurable(seq)) return true;
+        throwIfFailed();
+
+        if (durability == DURABILITY_SYNC) {
+            std::lock_guard<std::mutex> io_lock(io_mutex);
+            // 拿到锁时别人可能已经把我们的记录一起刷掉了
+            if (!isDurable(seq)) flushLocked(true);
+            return true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(buffer_mutex);
+            flush_requested = true;
+        }
+        cv.notify_one();
+        std::unique_lock<std::mutex> lock(durable_mutex);
+        auto done = [&] { return isDurable(seq) || !running || failure; };
+        if (timeout == std::chrono::microseconds::max()) {
+            durable_cv.wait(lock, done);
+        } else {
+            durable_cv.wait_for(lock, timeout, done);
+        }
+        if (isDurable(seq)) return true;
+        if (failure) std::rethrow_exception(failure);
+        return false;
+    }
+
+    // checkpoint 之后：丢掉缓冲，当前段清空；返回当前段号 (更早的段由 BinaryLogger 删除)
+    // 调用方保证缓冲里的行都已经在 checkpoint 里
+    uint64_t retire() {
+        std::lock_guard<std::mutex> io_lock(io_mutex);
+        uint64_t seq;
+        {
+            std::lock_guard<std::mutex> lock(buffer_mutex);
+            buffer.clear();
+            segment_breaks.clear();
+            encoder.reset();
+            segment_bytes = 0;
+            seq = next_seq;
+        }
+        wal->reset();
+        publishDurable(seq); // 丢掉的记录已经由 checkpoint 持久化了
+        return segment_no;
+    }
+
+    int64_t flushIntervalUs() const { return flush_interval_us.load(std::memory_order_relaxed); }
+    const char* backendName() const { return wal->backendName(); }
+
+private:
+    void throwIfFailed() {
+        if (!failed.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> lock(durable_mutex);
+        std::rethrow_exception(failure);
+    }
+
+    // 记下第一次刷盘失败，叫醒所有等确认的线程
+    void fail(std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lock(durable_mutex);
+            if (!failure) failure = e;
+            failed.store(true, std::memory_order_release);
+        }
+        durable_cv.notify_all();
+    }
+
+    void publishDurable(uint64_t seq) {
+        {
+            std::lock_guard<std::mutex> lock(durable_mutex);
+            if (seq > durable_seq.load(std::memory_order_relaxed)) durable_seq.store(seq, std::memory_order_release);
+        }
+        durable_cv.notify_all();
+    }
+
+    // 当前段写满：同步后换下一段 (旧段里可能还有 ASYNC 没同步的数据)
+    void rotateLocked() {
+        wal->sync();
+        wal.reset();
+        wal = std::make_unique<WalFile>(segmentPath(log_dir, stream_id, ++segment_no), true);
+    }
+
+    // 把 swap_buffer[from, to) 包成一个块写进当前段
+    void writeBlockLocked(size_t from, size_t to, bool sync) {
+        block_buffer.clear();
+        if (to > from) walWrapBlock(block_buffer, swap_buffer.data() + from, to - from, compress_blocks);
+        wal->append(block_buffer.data(), block_buffer.size(), sync);
+    }
+
+    // 把缓冲里的记录写进 WAL；调用方持有 io_mutex
+    // sync = false 时只写不同步 (ASYNC 级别的定时刷盘)，也就不推进 durable_seq
+    // 返回这一批 (编码后、压缩前) 的字节数；写盘出错时记成流的粘性错误再抛出
+    size_t flushLocked(bool sync) {
+        throwIfFailed();
+        uint64_t seq;
+        {
+            std::lock_guard<std::mutex> lock(buffer_mutex);
+            buffer.swap(swap_buffer);
+            segment_breaks.swap(swap_breaks);
+            seq = next_seq;
+            // 有人在等确认：这一批必须同步
+            if (flush_requested) sync = true;
+            flush_requested = false;
+        }
+        size_t bytes = swap_buffer.size();
+        if (bytes > 0 || (sync && !isDurable(seq))) {
+            MetricTimer timer(METRIC_WAL_FLUSH_NS);
+            if (bytes > 0) {
+                Metrics::add(METRIC_WAL_FLUSHES);
+                Metrics::record(METRIC_WAL_FLUSH_BYTES, bytes);
             }
-            if (row.size() == col_types.size()) {
-                rows.push_back(std::move(row));
+            try {
+                size_t from = 0;
+                for (size_t cut : swap_breaks) {
+                    writeBlockLocked(from, cut, false);
+                    rotateLocked();
+                    from = cut;
+                }
+                writeBlockLocked(from, bytes, sync);
+            } catch (...) {
+                fail(std::current_exception());
+                throw;
             }
+            swap_buffer.clear();
+            swap_breaks.clear();
         }
-        return rows;
+        if (sync) publishDurable(seq);
+        return bytes;
     }
 
-private:
     void worker_loop() {
-        std::vector<char> swap_buffer;
-        swap_buffer.reserve(65536);
-
         while (running) {
             {
                 std::unique_lock<std::mutex> lock(buffer_mutex);
-                cv.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this] { return !running; });
-                buffer.swap(swap_buffer);
+                cv.wait_for(lock, std::chrono::microseconds(flush_interval_us.load()), [this] {
+                    return !running || flush_requested || buffer.size() >= WAL_FLUSH_TARGET_BYTES;
+                });
             }
 
-            if (!swap_buffer.empty()) {
-                log_file.write(swap_buffer.data(), swap_buffer.size());
-                log_file.flush(); // 刷盘！
-                swap_buffer.clear();
+            // 先拿 io_mutex 再换缓冲：retire 之前换出来的数据不会写进清空后的文件
+            std::lock_guard<std::mutex> io_lock(io_mutex);
+            try {
+                size_t bytes = flushLocked(durability != DURABILITY_ASYNC);
+                // 自适应间隔：一批超过目标说明写得快，间隔减半；不到四分之一说明闲，间隔加倍
+                int64_t interval = flush_interval_us.load(std::memory_order_relaxed);
+                if (bytes >= WAL_FLUSH_TARGET_BYTES) {
+                    interval = std::max(WAL_FLUSH_MIN_US, interval / 2);
+                } else if (bytes < WAL_FLUSH_TARGET_BYTES / 4) {
+                    interval = std::min(WAL_FLUSH_MAX_US, interval * 2);
+                }
+                flush_interval_us.store(interval, std::memory_order_relaxed);
+            } catch (const std::exception& e) {
+                // 错误已经记在流上 (等确认的线程会拿到它)，流不能再写了，后台线程就此退出
+                std::cerr << "[WAL] " << log_dir << " stream " << stream_id << ": " << e.what() << std::endl;
+                return;
+            }
+        }
+    }
+};
+
+// 提交确认：insertRowAsync 返回，wait() 返回时这行已经 fdatasync 到盘上
+// 持有的是日志流的裸指针，不能比表活得久
+class CommitToken {
+private:
+    LogStream* stream = nullptr;
+    uint64_t seq = 0;
+
+public:
+    CommitToken() = default;
+    CommitToken(LogStream* log, uint64_t s) : stream(log), seq(s) {}
+
+    bool ready() const { return !stream || stream->isDurable(seq); }
+    // 日志流刷盘失败 (这行永远落不了盘) 时抛出那个错误
+    void wait() const {
+        if (stream) stream->waitDurableFor(seq, std::chrono::microseconds::max());
+    }
+    // 最多等 timeout，返回是否已经落盘
+    bool waitFor(std::chrono::microseconds timeout) const {
+        return !stream || stream->waitDurableFor(seq, timeout);
+    }
+};
+
+// 一张表的 WAL：目录 <dir> 下 N 个并行日志流
+// 写线程按线程固定分到某个流 (第 i 个写线程 -> 流 i % N)，各流独立缓冲、独立刷盘
+class BinaryLogger {
+private:
+    std::string log_dir;
+    WalOptions options;
+    std::vector<std::unique_ptr<LogStream>> streams;
+    uint64_t expired_horizon = 0; // 已经落盘的过期水位 (只有 truncateExpired 在 gc_mutex 下改)
+
+    static inline std::atomic<size_t> next_writer_slot{0};
+
+    LogStream& localStream() {
+        thread_local size_t slot = next_writer_slot.fetch_add(1);
+        return *streams[slot % streams.size()];
+    }
+
+public:
+    // truncate = true 表示清空旧日志（新表）
+    // truncate = false 表示保留旧日志（用于恢复），新记录写进新的段，旧段留到下一次 checkpoint
+    BinaryLogger(const std::string& dir, bool truncate = true, const WalOptions& opts = {})
+        : log_dir(dir), options(opts) {
+        if (options.streams == 0) throw std::invalid_argument("BinaryLogger needs at least one stream");
+        std::filesystem::create_directories(log_dir);
+
+        // 新段号接在目录里最大的段号后面
+        uint64_t next_segment = 1;
+        for (const auto& entry : std::filesystem::directory_iterator(log_dir)) {
+            size_t id;
+            uint64_t segment;
+            if (!LogStream::parseSegmentName(entry.path().filename().string(), id, segment)) continue;
+            if (truncate) {
+                std::filesystem::remove(entry.path());
+            } else {
+                next_segment = std::max(next_segment, segment + 1);
             }
         }
+        if (truncate) {
+            std::filesystem::remove(horizonPath(log_dir));
+        } else {
+            expired_horizon = readExpiredHorizon(log_dir);
+        }
+
+        for (size_t i = 0; i < options.streams; ++i) {
+            streams.push_back(std::make_unique<LogStream>(log_dir, i, next_segment, options.durability,
+                                                          options.block_compression));
+        }
+    }
+
+    // 写一条记录；lsn 传这行的提交时间戳
+    CommitToken appendEntry(const std::vector<std::variant<int, std::string, std::monostate>>& row, uint64_t lsn) {
+        LogStream& stream = localStream();
+        return CommitToken(&stream, stream.append(row, lsn));
+    }
+
+    Durability durabilityLevel() const { return options.durability; }
+    size_t streamCount() const { return streams.size(); }
+    const char* backendName() const { return streams[0]->backendName(); }
+
+    // 清空日志：checkpoint 已经覆盖了日志里的所有数据，所有旧段退役
+    // 还没刷盘的缓冲一起丢掉 (调用方保证这些行都在 checkpoint 里)
+    void truncate() {
+        std::vector<uint64_t> current;
+        for (auto& stream : streams) current.push_back(stream->retire());
+
+        // 删掉每个流当前段之前的段，以及上次运行时多出来的流 (流数可以变)
+        // 之后换段只会产生更大的段号，不会被误删
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(log_dir, ec)) {
+            size_t id;
+            uint64_t segment;
+            if (!LogStream::parseSegmentName(entry.path().filename().string(), id, segment)) continue;
+            if (id >= current.size() || segment < current[id]) std::filesystem::remove(entry.path(), ec);
+        }
+    }
+
+    // --- 过期水位 ---
+    // 按保留策略截掉的块不写日志记录，这些行还留在段里；截断时把块里最大的提交时间戳记成水位，
+    // lsn 不超过水位的行都已过期，恢复时不再重放 (按时间过期的采样不落盘，不记的话重启后要再等一整个保留期)
+    // 先写临时文件再改名，fsync 之后才算数；写不进去就算了：最坏是崩溃恢复把过期的行放回来，下一轮再截
+    void saveExpiredHorizon(uint64_t lsn) {
+        if (lsn <= expired_horizon) return;
+        std::string path = horizonPath(log_dir);
+        std::string tmp = path + ".tmp";
+        std::string text = std::to_string(lsn) + "\n";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return;
+        bool ok = ::write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()) && ::fsync(fd) == 0;
+        ::close(fd);
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) return;
+        int dir_fd = ::open(log_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd >= 0) {
+            ok = ::fsync(dir_fd) == 0;
+            ::close(dir_fd);
+            if (ok) expired_horizon = lsn;
+        }
+    }
+
+    // 读过期水位；没有截断过返回 0
+    static uint64_t readExpiredHorizon(const std::string& dir) {
+        std::ifstream in(horizonPath(dir));
+        uint64_t lsn = 0;
+        if (!(in >> lsn)) return 0;
+        return lsn;
+    }
+
+    // 一条日志记录：(lsn = 提交时间戳, 行)
+    using LogRecord = std::pair<uint64_t, std::vector<std::variant<int, std::string, std::monostate>>>;
+
+    // --- 恢复功能：读取整个日志 ---
+    // 读目录下所有流的所有段，按 lsn (提交时间戳) 合并成一条序列
+    // 同一个 lsn 可能有好几条 (logBulk 一批共用一个时间戳)：再按 (流号, 段号, 段内位置) 排，
+    // 顺序只取决于日志内容，和目录遍历的顺序无关，每次恢复出来的行号都一样
+    static std::vector<LogRecord> readLog(
+        const std::string& dir,
+        const std::vector<int>& col_types // 需要 Schema 才知道怎么读 (0:INT, 1:STRING)
+    ) {
+        struct Entry {
+            uint64_t lsn;
+            size_t stream;
+            uint64_t segment;
+            size_t pos;
+            std::vector<std::variant<int, std::string, std::monostate>> row;
+        };
+        std::vector<Entry> entries;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+            size_t id;
+            uint64_t segment;
+            if (!LogStream::parseSegmentName(entry.path().filename().string(), id, segment)) continue;
+
+            // 字典和 lsn 基准每段独立，一个段从头顺序解码
+            WalDecoder decoder;
+            size_t pos = 0;
+            std::vector<char> data = readFile(entry.path().string());
+            walForEachBlock(data, [&](const char* raw, size_t len) {
+                return decoder.decodeBlock(raw, raw + len, col_types, [&](uint64_t lsn, auto&& row) {
+                    entries.push_back({lsn, id, segment, pos++, std::move(row)});
+                });
+            });
+        }
+
+        // 同一个流里不同线程的提交可能交错，不能只做归并，直接整体排序
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return std::tie(a.lsn, a.stream, a.segment, a.pos) < std::tie(b.lsn, b.stream, b.segment, b.pos);
+        });
+        std::vector<LogRecord> records;
+        records.reserve(entries.size());
+        for (auto& e : entries) records.emplace_back(e.lsn, std::move(e.row));
+        return records;
+    }
+
+private:
+    static std::string horizonPath(const std::string& dir) { return dir + "/expired"; }
+
+    static std::vector<char> readFile(const std::string& filename) {
+        std::ifstream infile(filename, std::ios::binary | std::ios::ate);
+        if (!infile.is_open()) return {};
+        std::vector<char> data(static_cast<size_t>(infile.tellg()));
+        infile.seekg(0);
+        infile.read(data.data(), data.size());
+        return data;
     }
-};
\ No newline at end of file
+};
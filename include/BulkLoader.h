@@ -0,0 +1,474 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Table.h"
+
+// --- 批量导入 (CSV / 列存二进制文件) ---
+// 1. 输入文件整个 mmap 进来。CSV 按字节切成若干段，每段从行首开始
+// 2. 第一遍并行数每段的行数 (memchr 找换行，glibc 的 memchr 是向量化的)，前缀和算出每段的起始行号
+// 3. 表尾一次预留够用的整块。第二遍每个线程解析自己领到的段，直接写进对应行号的列块
+// 4. 一次提交：先建索引，再让所有行用同一个时间戳同时可见；可选封存成压缩块、写 checkpoint
+// 持久化：给了 checkpoint_path 就写 checkpoint (覆盖整张表，写完清空 WAL)；
+//        没给时提交后把导入的行补写进 WAL (同一个时间戳)，崩溃恢复照样能重放出来
+// CSV：字段可以用双引号括起来 ("" 表示一个引号)，但引号里不能有换行；空行跳过
+
+// 每个线程分几段 (行长不均匀时，先做完的线程接着领后面的段)
+constexpr size_t BULK_RANGES_PER_THREAD = 4;
+
+constexpr char COLUMNAR_FILE_MAGIC[8] = {'H', 'A', 'V', 'A', 'N', 'A', 'C', 'F'};
+
+// 列存导入文件：
+//   [ColumnarFileHeader] [ColumnarColumnEntry x 列数] [列 0 数据] [列 1 数据] ...
+//   INT 列：int32 x 行数
+//   STRING 列：uint64 偏移 x (行数 + 1) (相对字符区开头)，后面紧跟字符区
+struct ColumnarFileHeader {
+    char magic[8];
+    uint32_t num_columns;
+    uint32_t reserved;
+    uint64_t num_rows;
+};
+
+struct ColumnarColumnEntry {
+    uint32_t type;      // ColumnType
+    uint32_t reserved;
+    uint64_t offset;    // 相对文件开头
+    uint64_t length;
+};
+
+struct BulkLoadOptions {
+    size_t threads = 0;           // 0 = hardware_concurrency
+    char delimiter = ',';         // CSV 分隔符
+    bool header = false;          // CSV 第一行是列名，跳过
+    bool seal = true;             // 导入后直接封存成压缩块
+    // 非空：导入后写 checkpoint (和 Table::saveCheckpoint 一样，这期间不能有并发 insert)
+    // 空：导入的行写进 WAL，按表的持久化级别落盘
+    std::string checkpoint_path;
+};
+
+struct BulkLoadStats {
+    size_t rows = 0;
+    size_t chunks = 0;
+    uint64_t commit_ts = 0;
+};
+
+// 只读映射输入文件 (空文件不映射)
+class BulkInputFile {
+private:
+    void* addr = MAP_FAILED;
+    size_t length = 0;
+
+public:
+    explicit BulkInputFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open input file: " + path);
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat input file: " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) ::madvise(addr, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+        if (length > 0 && addr == MAP_FAILED) throw std::runtime_error("mmap failed: " + path);
+    }
+
+    ~BulkInputFile() {
+        if (addr != MAP_FAILED) ::munmap(addr, length);
+    }
+
+    BulkInputFile(const BulkInputFile&) = delete;
+    BulkInputFile& operator=(const BulkInputFile&) = delete;
+
+    const char* data() const { return addr == MAP_FAILED ? nullptr : static_cast<const char*>(addr); }
+    size_t size() const { return length; }
+};
+
+// 写列存导入文件：行先按列攒在内存里，finish() 一次写出
+class ColumnarFileWriter {
+private:
+    std::string path;
+    std::vector<ColumnType> types;
+    std::vector<std::vector<int>> ints;
+    std::vector<std::vector<uint64_t>> offsets;
+    std::vector<std::string> chars;
+    size_t rows = 0;
+
+public:
+    ColumnarFileWriter(std::string file_path, std::vector<ColumnType> column_types)
+        : path(std::move(file_path)), types(std::move(column_types)),
+          ints(types.size()), offsets(types.size(), std::vector<uint64_t>{0}), chars(types.size()) {}
+
+    void addRow(const std::vector<Table::Value>& row) {
+        if (row.size() != types.size()) throw std::invalid_argument("ColumnarFileWriter: wrong number of columns");
+        for (size_t i = 0; i < types.size(); ++i) {
+            if (std::holds_alternative<std::monostate>(row[i])) {
+                throw std::invalid_argument("ColumnarFileWriter: NULL is not supported (column " + std::to_string(i) + ")");
+            }
+            if (std::holds_alternative<int>(row[i]) != (types[i] == TYPE_INT)) {
+                throw std::invalid_argument("ColumnarFileWriter: type mismatch at column " + std::to_string(i));
+            }
+            if (types[i] == TYPE_INT) {
+                ints[i].push_back(std::get<int>(row[i]));
+            } else {
+                chars[i] += std::get<std::string>(row[i]);
+                offsets[i].push_back(chars[i].size());
+            }
+        }
+        rows++;
+    }
+
+    size_t rowCount() const { return rows; }
+
+    void finish() {
+        ColumnarFileHeader header{};
+        std::memcpy(header.magic, COLUMNAR_FILE_MAGIC, sizeof(header.magic));
+        header.num_columns = static_cast<uint32_t>(types.size());
+        header.num_rows = rows;
+
+        // 每列从 8 字节边界开始
+        std::vector<ColumnarColumnEntry> dir(types.size());
+        uint64_t pos = sizeof(header) + dir.size() * sizeof(ColumnarColumnEntry);
+        for (size_t i = 0; i < types.size(); ++i) {
+            pos = (pos + 7) & ~uint64_t(7);
+            dir[i].type = types[i];
+            dir[i].offset = pos;
+            dir[i].length = types[i] == TYPE_INT ? rows * sizeof(int32_t)
+                                                 : offsets[i].size() * sizeof(uint64_t) + chars[i].size();
+            pos += dir[i].length;
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(dir.data()), dir.size() * sizeof(ColumnarColumnEntry));
+        uint64_t written = sizeof(header) + dir.size() * sizeof(ColumnarColumnEntry);
+        for (size_t i = 0; i < types.size(); ++i) {
+            static const char zeros[8] = {};
+            out.write(zeros, dir[i].offset - written);
+            if (types[i] == TYPE_INT) {
+                out.write(reinterpret_cast<const char*>(ints[i].data()), ints[i].size() * sizeof(int32_t));
+            } else {
+                out.write(reinterpret_cast<const char*>(offsets[i].data()), offsets[i].size() * sizeof(uint64_t));
+                out.write(chars[i].data(), chars[i].size());
+            }
+            written = dir[i].offset + dir[i].length;
+        }
+        if (!out) throw std::runtime_error("Failed to write columnar file: " + path);
+    }
+};
+
+class BulkLoader {
+public:
+    // CSV：每行一条记录，列的顺序和表的 Schema 一致
+    static BulkLoadStats loadCsv(Table& table, const std::string& path, const BulkLoadOptions& options = {}) {
+        BulkInputFile file(path);
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+        size_t skipped_lines = 0;
+        if (options.header && begin != end) {
+            begin = lineEnd(begin, end);
+            if (begin != end) ++begin;
+            skipped_lines = 1;
+        }
+
+        // 1. 切段
+        size_t threads = threadCount(options);
+        std::vector<const char*> cuts = splitLines(begin, end, threads * BULK_RANGES_PER_THREAD);
+        size_t parts = cuts.size() - 1;
+
+        // 2. 数行，前缀和得到每段的第一条记录写到哪一行 (空行不算)，以及它在文件里的行号 (报错用)
+        std::vector<size_t> rows(parts + 1, 0), lines(parts + 1, 0);
+        runParallel(threads, parts, [&](size_t p) { countLines(cuts[p], cuts[p + 1], rows[p + 1], lines[p + 1]); });
+        for (size_t p = 0; p < parts; ++p) {
+            rows[p + 1] += rows[p];
+            lines[p + 1] += lines[p];
+        }
+
+        // 3. 解析，直接写进预留的块
+        return loadRows(table, rows[parts], options, [&](size_t first_row) {
+            runParallel(threads, parts, [&](size_t p) {
+                CsvRangeParser parser(table, options.delimiter, skipped_lines + lines[p]);
+                parser.parse(cuts[p], cuts[p + 1], first_row + rows[p]);
+            });
+        });
+    }
+
+    // 列存文件 (格式见 ColumnarFileHeader)：按块并行拷贝
+    static BulkLoadStats loadColumnar(Table& table, const std::string& path, const BulkLoadOptions& options = {}) {
+        BulkInputFile file(path);
+        const char* base = file.data();
+        size_t size = file.size();
+
+        // 1. 校验头部和目录
+        ColumnarFileHeader header;
+        if (size < sizeof(header)) throw std::runtime_error("Corrupted columnar file: " + path);
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, COLUMNAR_FILE_MAGIC, sizeof(header.magic)) != 0) {
+            throw std::runtime_error("Not a HavanaDB columnar file: " + path);
+        }
+        if (header.num_columns != table.columnCount()) {
+            throw std::runtime_error("Columnar file has " + std::to_string(header.num_columns) + " columns, table '" +
+                                     table.name() + "' has " + std::to_string(table.columnCount()));
+        }
+        uint64_t rows = header.num_rows;
+        if (rows > MAX_CHUNKS * CHUNK_SIZE) throw std::out_of_range("Exceeded DB Max Capacity");
+        if (size < sizeof(header) + header.num_columns * sizeof(ColumnarColumnEntry)) {
+            throw std::runtime_error("Corrupted columnar file: " + path);
+        }
+        std::vector<ColumnarColumnEntry> dir(header.num_columns);
+        std::memcpy(dir.data(), base + sizeof(header), dir.size() * sizeof(ColumnarColumnEntry));
+
+        for (size_t i = 0; i < dir.size(); ++i) {
+            const ColumnarColumnEntry& e = dir[i];
+            if (e.type != static_cast<uint32_t>(table.columnType(i))) {
+                throw std::runtime_error("Columnar file type mismatch at column '" + table.columnName(i) + "'");
+            }
+            bool ok = e.offset <= size && e.length <= size - e.offset;
+            if (ok && e.type == TYPE_INT) {
+                ok = e.length == rows * sizeof(int32_t);
+            } else if (ok) {
+                uint64_t index_bytes = (rows + 1) * sizeof(uint64_t);
+                uint64_t last = 0;
+                if (e.length >= index_bytes) std::memcpy(&last, base + e.offset + rows * sizeof(uint64_t), sizeof(last));
+                ok = e.length >= index_bytes && last == e.length - index_bytes;
+            }
+            if (!ok) throw std::runtime_error("Corrupted columnar file: " + path + " (column '" + table.columnName(i) + "')");
+        }
+
+        // 2. 按块并行拷贝：预留的第一行在块边界上，文件里的第 k 块正好对应表里的一个整块
+        size_t threads = threadCount(options);
+        size_t chunks = (rows + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        return loadRows(table, rows, options, [&](size_t first_row) {
+            runParallel(threads, chunks, [&](size_t k) {
+                size_t begin = k * CHUNK_SIZE;
+                size_t end = std::min<size_t>(rows, begin + CHUNK_SIZE);
+                size_t chunk = first_row / CHUNK_SIZE + k;
+                for (size_t i = 0; i < dir.size(); ++i) {
+                    const char* data = base + dir[i].offset;
+                    if (dir[i].type == TYPE_INT) {
+                        int* out = dynamic_cast<Column<int>*>(table.mutableColumn(i))->chunkData(chunk);
+                        std::memcpy(out, data + begin * sizeof(int32_t), (end - begin) * sizeof(int32_t));
+                        continue;
+                    }
+                    std::string* out = dynamic_cast<Column<std::string>*>(table.mutableColumn(i))->chunkData(chunk);
+                    const char* text = data + (rows + 1) * sizeof(uint64_t);
+                    uint64_t text_len = dir[i].length - (rows + 1) * sizeof(uint64_t);
+                    uint64_t from;
+                    std::memcpy(&from, data + begin * sizeof(uint64_t), sizeof(from));
+                    for (size_t r = begin; r < end; ++r) {
+                        uint64_t to;
+                        std::memcpy(&to, data + (r + 1) * sizeof(uint64_t), sizeof(to));
+                        if (from > to || to > text_len) throw std::runtime_error("Corrupted columnar file: " + path);
+                        out[r - begin].assign(text + from, to - from);
+                        from = to;
+                    }
+                }
+            });
+        });
+    }
+
+private:
+    // 一段 CSV 的解析：每列缓存当前块的数组指针，跨块时才重新取
+    class CsvRangeParser {
+    private:
+        Table& table;
+        char delim;
+        size_t line_no;                      // 当前行号 (从 1 开始，含表头和空行)
+        size_t chunk = SIZE_MAX;
+        std::vector<int*> int_data;          // 按列：当前块的数组 (另一种类型的列是 nullptr)
+        std::vector<std::string*> str_data;
+        std::string unquoted;                // 带 "" 转义的字段还原到这里
+
+    public:
+        CsvRangeParser(Table& t, char delimiter, size_t lines_before)
+            : table(t), delim(delimiter), line_no(lines_before),
+              int_data(t.columnCount(), nullptr), str_data(t.columnCount(), nullptr) {}
+
+        void parse(const char* p, const char* end, size_t row) {
+            while (p < end) {
+                const char* eol = lineEnd(p, end);
+                const char* stop = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+                ++line_no;
+                if (stop > p) parseLine(p, stop, row++);
+                p = (eol == end) ? end : eol + 1;
+            }
+        }
+
+    private:
+        [[noreturn]] void fail(const std::string& msg) const {
+            throw std::runtime_error("CSV line " + std::to_string(line_no) + ": " + msg);
+        }
+
+        void parseLine(const char* p, const char* end, size_t row) {
+            size_t c = row / CHUNK_SIZE;
+            if (c != chunk) {
+                for (size_t i = 0; i < table.columnCount(); ++i) {
+                    if (table.columnType(i) == TYPE_INT) {
+                        int_data[i] = dynamic_cast<Column<int>*>(table.mutableColumn(i))->chunkData(c);
+                    } else {
+                        str_data[i] = dynamic_cast<Column<std::string>*>(table.mutableColumn(i))->chunkData(c);
+                    }
+                }
+                chunk = c;
+            }
+            size_t offset = row % CHUNK_SIZE;
+
+            size_t n = table.columnCount();
+            for (size_t i = 0; i < n; ++i) {
+                std::string_view field = nextField(p, end);
+                bool last = (i + 1 == n);
+                if (last != (p == end)) fail("expected " + std::to_string(n) + " columns");
+                if (!last) ++p; // 跳过分隔符
+
+                if (int_data[i]) {
+                    int_data[i][offset] = parseInt(field, i);
+                } else {
+                    str_data[i][offset].assign(field.data(), field.size());
+                }
+            }
+        }
+
+        // 读一个字段，p 停在后面的分隔符 (或行尾) 上
+        std::string_view nextField(const char*& p, const char* end) {
+            if (p == end || *p != '"') {
+                auto* d = static_cast<const char*>(std::memchr(p, delim, end - p));
+                const char* stop = d ? d : end;
+                std::string_view field(p, stop - p);
+                p = stop;
+                return field;
+            }
+
+            // 引号字段：没有 "" 转义时直接返回文件里的那一段
+            const char* q = p + 1;
+            bool escaped = false;
+            unquoted.clear();
+            while (true) {
+                auto* quote = static_cast<const char*>(std::memchr(q, '"', end - q));
+                if (!quote) fail("unterminated quoted field");
+                if (quote + 1 < end && quote[1] == '"') {
+                    unquoted.append(q, quote + 1 - q);
+                    escaped = true;
+                    q = quote + 2;
+                    continue;
+                }
+                std::string_view field(p + 1, quote - p - 1);
+                if (escaped) {
+                    unquoted.append(q, quote - q);
+                    field = unquoted;
+                }
+                p = quote + 1;
+                return field;
+            }
+        }
+
+        int parseInt(std::string_view field, size_t col) const {
+            while (!field.empty() && field.front() == ' ') field.remove_prefix(1);
+            while (!field.empty() && field.back() == ' ') field.remove_suffix(1);
+            int v = 0;
+            auto res = std::from_chars(field.data(), field.data() + field.size(), v);
+            if (field.empty() || res.ec != std::errc() || res.ptr != field.data() + field.size()) {
+                fail("invalid integer '" + std::string(field) + "' for column '" + table.columnName(col) + "'");
+            }
+            return v;
+        }
+    };
+
+    static size_t threadCount(const BulkLoadOptions& options) {
+        if (options.threads > 0) return options.threads;
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    static const char* lineEnd(const char* p, const char* end) {
+        auto* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        return eol ? eol : end;
+    }
+
+    // 把 [begin, end) 切成最多 parts 段，每段从行首开始；返回切点 (首尾都在里面)
+    static std::vector<const char*> splitLines(const char* begin, const char* end, size_t parts) {
+        std::vector<const char*> cuts{begin};
+        size_t size = end - begin;
+        for (size_t k = 1; k < parts; ++k) {
+            const char* pos = std::max(begin + size * k / parts, cuts.back());
+            if (pos == end) break;
+            const char* eol = lineEnd(pos, end);
+            const char* cut = (eol == end) ? end : eol + 1;
+            if (cut != cuts.back()) cuts.push_back(cut);
+        }
+        if (cuts.back() != end || cuts.size() == 1) cuts.push_back(end);
+        return cuts;
+    }
+
+    static void countLines(const char* p, const char* end, size_t& rows, size_t& lines) {
+        while (p < end) {
+            const char* eol = lineEnd(p, end);
+            const char* stop = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+            lines++;
+            rows += (stop > p);
+            p = (eol == end) ? end : eol + 1;
+        }
+    }
+
+    // fn(task)，task = 0..tasks-1 由最多 threads 个线程领
+    // 出错的线程记下异常，其他线程领完手上的就停；全部结束后重新抛出
+    template <typename Fn>
+    static void runParallel(size_t threads, size_t tasks, Fn&& fn) {
+        if (tasks == 0) return;
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        std::vector<std::exception_ptr> errors(std::min(threads, tasks));
+        auto worker = [&](size_t w) {
+            try {
+                for (size_t t = next++; t < tasks && !failed; t = next++) fn(t);
+            } catch (...) {
+                errors[w] = std::current_exception();
+                failed = true;
+            }
+        };
+        std::vector<std::thread> pool;
+        for (size_t w = 1; w < errors.size(); ++w) pool.emplace_back(worker, w);
+        worker(0);
+        for (auto& th : pool) th.join();
+        for (auto& e : errors) {
+            if (e) std::rethrow_exception(e);
+        }
+    }
+
+    // 预留 -> 填数据 -> 提交；fill(first_row) 抛异常时整段作废
+    template <typename Fill>
+    static BulkLoadStats loadRows(Table& table, size_t total, const BulkLoadOptions& options, Fill&& fill) {
+        BulkLoadStats stats;
+        if (total == 0) return stats;
+        stats.rows = total;
+        stats.chunks = (total + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+        size_t first_row = table.reserveChunks(stats.chunks) * CHUNK_SIZE;
+        size_t end_row = first_row + stats.chunks * CHUNK_SIZE;
+        try {
+            fill(first_row);
+        } catch (...) {
+            table.abortBulk(first_row, end_row);
+            throw;
+        }
+        stats.commit_ts = table.commitBulk(first_row, total, end_row);
+        if (options.checkpoint_path.empty()) table.logBulk(first_row, total, stats.commit_ts);
+
+        if (options.seal) table.sealChunks();
+        if (!options.checkpoint_path.empty()) table.saveCheckpoint(options.checkpoint_path);
+        return stats;
+    }
+};
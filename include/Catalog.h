@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Rcu.h"
+#include "Table.h"
+
+// --- 表目录 ---
+// 查表 (每条 SQL 都要查) 不加锁：读当前版本的指针，在里面查一次，只写本线程的读者槽
+// 建表是少数：写者之间用互斥锁排队，复制当前版本、加上新表、原子地换上去，旧版本等读者都离开再释放
+// 新表在写者锁里构造：两个会话同时 CREATE 同一张表，后到的不会再开一次 (清空) 同名的 WAL
+// Table 对象归目录所有，建了就不删 (没有 DROP TABLE)：查到的 Table* 在目录析构之前一直有效
+class Catalog {
+private:
+    // 一个版本：key 指向 Table 自己存的名字 (表不会删，名字一直有效)
+    using Version = std::unordered_map<std::string_view, Table*>;
+
+    std::atomic<const Version*> current;
+    std::mutex write_mtx;
+    std::vector<std::unique_ptr<Table>> owned;                  // 以下由 write_mtx 保护
+    std::vector<std::pair<uint64_t, const Version*>> retired;   // (换下来时的 epoch, 旧版本)
+
+    // 释放读者已经走光的旧版本 (持有 write_mtx)
+    void reclaimLocked() {
+        size_t keep = 0;
+        for (auto& r : retired) {
+            if (RcuDomain::quiescent(r.first)) delete r.second;
+            else retired[keep++] = r;
+        }
+        retired.resize(keep);
+    }
+
+public:
+    Catalog() : current(new Version()) {}
+
+    ~Catalog() {
+        // 析构时不能再有读者
+        for (auto& r : retired) delete r.second;
+        delete current.load();
+    }
+
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    Table* find(std::string_view name) const {
+        RcuReadGuard guard;
+        const Version* v = current.load(std::memory_order_acquire);
+        auto it = v->find(name);
+        return it == v->end() ? nullptr : it->second;
+    }
+
+    // 没有同名的表才调用 make() 建一张登记进来；已经有了返回 nullptr
+    template <typename Make>
+    Table* createIfAbsent(std::string_view name, Make&& make) {
+        std::lock_guard<std::mutex> lock(write_mtx);
+        const Version* old = current.load(std::memory_order_relaxed);
+        if (old->find(name) != old->end()) return nullptr;
+
+        std::unique_ptr<Table> t = make();
+        Table* raw = t.get();
+        auto next = std::make_unique<Version>(*old);
+        next->emplace(std::string_view(raw->name()), raw);
+        owned.push_back(std::move(t));
+
+        current.store(next.release(), std::memory_order_seq_cst);
+        retired.emplace_back(RcuDomain::advance(), old);
+        reclaimLocked();
+        return raw;
+    }
+
+    size_t size() const {
+        RcuReadGuard guard;
+        return current.load(std::memory_order_acquire)->size();
+    }
+};
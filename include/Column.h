@@ -6,24 +6,70 @@
 #include <type_traits>
 #include <atomic>
 #include <mutex>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <string_view>
+#include <cstring>
+#include "PackedChunk.h"
+#include "TableFile.h"
 
 // 定义分块大小：每块 10 万行
 constexpr size_t CHUNK_SIZE = 100000;
 // 定义最大块数：4096 块 -> 总容量约 4 亿行 (足够了)
 constexpr size_t MAX_CHUNKS = 4096;
+// 一块的空值位图有多少个 64 位字
+constexpr size_t NULL_BITMAP_WORDS = (CHUNK_SIZE + 63) / 64;
+
+// --- 空值位图 (稀疏行) ---
+// 稀疏行只带变了的列，没给出的列在这一块的位图里记一位 (1 = NULL)，值槽保持类型的零值
+// 块里一个 NULL 都没有时不分配：稠密的块不多花内存，扫描时看一眼指针是空的就跳过
+// 写在行提交 (setCreated 的 release) 之前，读者判过可见性以后读位图不用再加屏障
+struct NullBitmap {
+    std::atomic<uint64_t> words[NULL_BITMAP_WORDS];
+
+    NullBitmap() {
+        for (auto& w : words) w.store(0, std::memory_order_relaxed);
+    }
+
+    bool test(size_t offset) const {
+        return (words[offset >> 6].load(std::memory_order_relaxed) >> (offset & 63)) & 1;
+    }
+
+    // 同一个字里的行可能属于不同线程的租约，用原子或
+    void set(size_t offset) {
+        words[offset >> 6].fetch_or(uint64_t(1) << (offset & 63), std::memory_order_relaxed);
+    }
+};
 
 class AbstractColumn {
 public:
     virtual ~AbstractColumn() = default;
-    virtual void printValue(size_t row_idx) const = 0;
 
     // --- 新接口：按需扩容 ---
     // 告诉列："我要写第 row_idx 行，你看看内存够不够，不够就申请"
     virtual void ensureChunk(size_t chunk_idx) = 0;
 
+    // 把整块摘下来，返回真正释放内存的函数 (由 GC 在旧读者退出后调用)
+    virtual std::function<void()> detachChunk(size_t chunk_idx) = 0;
+
+    // 封存：块写满且全部提交后不会再变，换成压缩编码
+    // 返回释放原始块的函数；块不存在或已封存时返回空函数
+    virtual std::function<void()> sealChunk(size_t chunk_idx) = 0;
+
+    // 表文件：把一块写成一个 Region / 把映射进来的 Region 挂成封存块
+    virtual void saveChunk(size_t chunk_idx, TableFileWriter& writer, uint32_t col_id) const = 0;
+    virtual void mapChunk(size_t chunk_idx, const RegionEntry& entry, const char* file_base) = 0;
+
+    // 当前占用的内存 (字节，估算)
+    virtual size_t memoryBytes() const = 0;
+
     // 随机写 (逻辑不变)
     virtual void set(size_t row_idx, int val) { throw std::runtime_error("Type Err"); }
     virtual void set(size_t row_idx, const std::string& val) { throw std::runtime_error("Type Err"); }
+
+    // 这一行没有这一列的值 (稀疏行)
+    virtual void setNull(size_t row_idx) = 0;
 };
 
 template <typename T>
@@ -32,6 +78,13 @@ private:
     // 二级指针数组：chunks[i] 指向第 i 个数据块
     // 使用 atomic 指针，方便无锁检查
     std::atomic<std::vector<T>*> chunks[MAX_CHUNKS];
+
+    // 封存后的压缩块 (int: FOR/RLE/DICT；string: offsets + 字符数据)，可能指向映射的表文件
+    // 封存时先挂上压缩块再摘掉原始块，读者先看原始块、没有再看压缩块，不会两头落空
+    std::atomic<const PackedChunk<T>*> packed[MAX_CHUNKS];
+
+    // 空值位图，块里有 NULL 时才分配；封存不动它 (封存块的 NULL 槽就是压缩进去的零值)
+    std::atomic<NullBitmap*> nulls[MAX_CHUNKS];
     
     // 这是一个很小的锁，只在申请新块的那一瞬间（每10万行一次）使用
     // 相比每行都锁，这个开销可以忽略不计
@@ -41,6 +94,8 @@ public:
     Column() {
         // 初始化所有指针为空
         for (auto& ptr : chunks) ptr.store(nullptr);
+        for (auto& ptr : packed) ptr.store(nullptr);
+        for (auto& ptr : nulls) ptr.store(nullptr);
     }
 
     ~Column() {
@@ -49,6 +104,8 @@ public:
             auto* p = ptr.load();
             if (p) delete p;
         }
+        for (auto& ptr : packed) delete ptr.load();
+        for (auto& ptr : nulls) delete ptr.load();
     }
 
     // --- 核心：按需分配 ---
@@ -61,8 +118,9 @@ public:
         // 2. 加锁分配
         std::lock_guard<std::mutex> lock(alloc_mutex);
         
-        // 3. 再次检查 (防止别人刚才分配了)
-        if (chunks[chunk_idx].load(std::memory_order_relaxed) == nullptr) {
+        // 3. 再次检查 (防止别人刚才分配了；已封存的块也不再分配)
+        if (chunks[chunk_idx].load(std::memory_order_relaxed) == nullptr &&
+            packed[chunk_idx].load(std::memory_order_relaxed) == nullptr) {
             auto* new_chunk = new std::vector<T>(CHUNK_SIZE);
             // 这里可以做一些默认值初始化，比如 int=0, string=""
             // 存回去
@@ -73,6 +131,133 @@ public:
         }
     }
 
+    std::function<void()> detachChunk(size_t chunk_idx) override {
+        auto* p = chunks[chunk_idx].exchange(nullptr, std::memory_order_acq_rel);
+        auto* pc = packed[chunk_idx].exchange(nullptr, std::memory_order_acq_rel);
+        auto* nb = nulls[chunk_idx].exchange(nullptr, std::memory_order_acq_rel);
+        return [p, pc, nb] {
+            delete p;
+            delete pc;
+            delete nb;
+        };
+    }
+
+    std::function<void()> sealChunk(size_t chunk_idx) override {
+        auto* raw = chunks[chunk_idx].load(std::memory_order_acquire);
+        if (!raw || packed[chunk_idx].load(std::memory_order_relaxed)) return {};
+
+        // 1. 先挂压缩块，2. 再摘原始块 (读者可能还在读原始块，释放交给调用方)
+        // 挂压缩块用 CAS：万一两个封存同时走到这里，输的一方扔掉自己编的块，原始块只由赢的一方释放
+        auto* pc = PackedChunk<T>::encode(raw->data(), raw->size());
+        const PackedChunk<T>* expected = nullptr;
+        if (!packed[chunk_idx].compare_exchange_strong(expected, pc, std::memory_order_acq_rel)) {
+            delete pc;
+            return {};
+        }
+        chunks[chunk_idx].store(nullptr, std::memory_order_release);
+        return [raw] { delete raw; };
+    }
+
+    // 没封存的块临时编码一份再写，文件里的块总是封存格式；有空值位图时紧跟着写一个位图 Region
+    void saveChunk(size_t chunk_idx, TableFileWriter& writer, uint32_t col_id) const override {
+        const PackedChunk<T>* pc = packed[chunk_idx].load(std::memory_order_acquire);
+        std::unique_ptr<PackedChunk<T>> tmp;
+        if (!pc) {
+            auto* raw = chunks[chunk_idx].load(std::memory_order_acquire);
+            if (!raw) return;
+            tmp.reset(PackedChunk<T>::encode(raw->data(), raw->size()));
+            pc = tmp.get();
+        }
+
+        RegionEntry entry{};
+        entry.kind = std::is_same_v<T, int> ? REGION_INT_CHUNK : REGION_STR_CHUNK;
+        entry.column = col_id;
+        entry.chunk = static_cast<uint32_t>(chunk_idx);
+        entry.encoding = pc->encoding();
+        entry.bits = pc->bitCount();
+        entry.base = pc->baseValue();
+        entry.num_values = pc->numValues();
+        entry.count = static_cast<uint32_t>(pc->size());
+        writer.writeRegion(entry, pc->data(), pc->dataBytes());
+
+        if (const NullBitmap* nb = nulls[chunk_idx].load(std::memory_order_acquire)) {
+            std::vector<uint64_t> words(NULL_BITMAP_WORDS);
+            uint32_t count = 0;
+            for (size_t w = 0; w < NULL_BITMAP_WORDS; ++w) {
+                words[w] = nb->words[w].load(std::memory_order_relaxed);
+                count += static_cast<uint32_t>(__builtin_popcountll(words[w]));
+            }
+            RegionEntry bits{};
+            bits.kind = REGION_NULL_BITMAP;
+            bits.column = col_id;
+            bits.chunk = static_cast<uint32_t>(chunk_idx);
+            bits.num_values = count;
+            bits.count = static_cast<uint32_t>(CHUNK_SIZE);
+            writer.writeRegion(bits, words.data(), words.size() * sizeof(uint64_t));
+        }
+    }
+
+    // 空值位图只有 12KB，拷进内存 (数据块留在映射里)
+    void mapChunk(size_t chunk_idx, const RegionEntry& entry, const char* file_base) override {
+        if (chunk_idx >= MAX_CHUNKS) throw std::out_of_range("Exceeded DB Max Capacity");
+        const char* data = file_base + entry.offset;
+        if (entry.kind == REGION_NULL_BITMAP) {
+            if (entry.length != NULL_BITMAP_WORDS * sizeof(uint64_t)) {
+                throw std::runtime_error("Null bitmap region has the wrong size");
+            }
+            auto* nb = new NullBitmap();
+            for (size_t w = 0; w < NULL_BITMAP_WORDS; ++w) {
+                uint64_t v;
+                std::memcpy(&v, data + w * sizeof(uint64_t), sizeof(v));
+                nb->words[w].store(v, std::memory_order_relaxed);
+            }
+            delete nulls[chunk_idx].exchange(nb, std::memory_order_acq_rel);
+            return;
+        }
+        PackedChunk<T>* pc;
+        if constexpr (std::is_same_v<T, int>) {
+            pc = PackedChunk<int>::wrap(static_cast<ChunkEncoding>(entry.encoding), entry.bits, entry.count,
+                                        entry.base, entry.num_values, data, entry.length);
+        } else {
+            pc = PackedChunk<std::string>::wrap(entry.count, data, entry.length);
+        }
+
+        std::lock_guard<std::mutex> lock(alloc_mutex);
+        if (chunks[chunk_idx].load(std::memory_order_relaxed) || packed[chunk_idx].load(std::memory_order_relaxed)) {
+            delete pc;
+            throw std::runtime_error("Chunk already in memory, cannot map table file over it");
+        }
+        packed[chunk_idx].store(pc, std::memory_order_release);
+    }
+
+    // 批量导入：直接写原始块的数组 (块已经 ensureChunk 过，这些行还没提交，没有读者)
+    // 块不在内存 (没分配 / 已封存) 时返回 nullptr
+    T* chunkData(size_t chunk_idx) {
+        auto* chunk = chunks[chunk_idx].load(std::memory_order_acquire);
+        return chunk ? chunk->data() : nullptr;
+    }
+
+    bool isSealed(size_t chunk_idx) const {
+        return packed[chunk_idx].load(std::memory_order_acquire) != nullptr;
+    }
+
+    size_t memoryBytes() const override {
+        size_t total = 0;
+        for (size_t c = 0; c < MAX_CHUNKS; ++c) {
+            if (auto* p = chunks[c].load(std::memory_order_relaxed)) {
+                total += p->capacity() * sizeof(T);
+                if constexpr (std::is_same_v<T, std::string>) {
+                    for (const auto& v : *p) {
+                        if (v.capacity() > 15) total += v.capacity(); // 超出 SSO 的部分在堆上
+                    }
+                }
+            }
+            if (auto* pc = packed[c].load(std::memory_order_relaxed)) total += pc->memoryBytes();
+            if (nulls[c].load(std::memory_order_relaxed)) total += sizeof(NullBitmap);
+        }
+        return total;
+    }
+
     void set(size_t row_idx, int val) override {
         if constexpr (std::is_same_v<T, int>) {
             // 计算位置
@@ -99,17 +284,88 @@ public:
         }
     }
 
-    // 读取 (Getter)
+    // 第一次在一块里写 NULL 时分配这一块的位图
+    void setNull(size_t row_idx) override {
+        size_t c_idx = row_idx / CHUNK_SIZE;
+        NullBitmap* nb = nulls[c_idx].load(std::memory_order_acquire);
+        if (!nb) {
+            std::lock_guard<std::mutex> lock(alloc_mutex);
+            nb = nulls[c_idx].load(std::memory_order_relaxed);
+            if (!nb) {
+                nb = new NullBitmap();
+                nulls[c_idx].store(nb, std::memory_order_release);
+            }
+        }
+        nb->set(row_idx % CHUNK_SIZE);
+    }
+
+    bool isNull(size_t row_idx) const {
+        const NullBitmap* nb = nulls[row_idx / CHUNK_SIZE].load(std::memory_order_acquire);
+        return nb && nb->test(row_idx % CHUNK_SIZE);
+    }
+
+    // 这一块的空值位图；块里没有 NULL 时返回 nullptr (批量算子据此整块跳过空值检查)
+    const NullBitmap* nullBitmap(size_t chunk_idx) const {
+        return nulls[chunk_idx].load(std::memory_order_acquire);
+    }
+
+    // 预取一行的值槽和空值位图 (批量点查先发预取，轮到这一行时再读)
+    // 封存块不预取：解码要看块头和字典，不是一次访存能覆盖的
+    void prefetch(size_t row_idx) const {
+        size_t c_idx = row_idx / CHUNK_SIZE;
+        size_t offset = row_idx % CHUNK_SIZE;
+        if (auto* chunk = chunks[c_idx].load(std::memory_order_acquire)) __builtin_prefetch(chunk->data() + offset);
+        if (auto* nb = nulls[c_idx].load(std::memory_order_acquire)) __builtin_prefetch(&nb->words[offset >> 6]);
+    }
+
+    // 读取 (Getter)；NULL 槽读出来是类型的零值
     T get(size_t row_idx) const {
         size_t c_idx = row_idx / CHUNK_SIZE;
         size_t offset = row_idx % CHUNK_SIZE;
-        auto* chunk = chunks[c_idx].load(std::memory_order_relaxed);
-        // 如果读到了还没分配的块，说明逻辑错了或者越界
-        if (!chunk) return T{}; 
-        return (*chunk)[offset];
+        auto* chunk = chunks[c_idx].load(std::memory_order_acquire);
+        if (chunk) return (*chunk)[offset];
+
+        if (auto* pc = packed[c_idx].load(std::memory_order_acquire)) return pc->get(offset);
+        // 如果读到了还没分配 (或已回收) 的块，说明逻辑错了或者越界
+        return T{};
+    }
+
+    // --- 扫描/聚合 Kernel：封存块直接在压缩数据上做，不还原成数组 ---
+    // 顺序扫描整块：fn(offset, value)；封存的 string 块传 std::string_view
+    template <typename Fn>
+    void scanChunk(size_t chunk_idx, Fn&& fn) const {
+        if (auto* chunk = chunks[chunk_idx].load(std::memory_order_acquire)) {
+            for (size_t i = 0; i < chunk->size(); ++i) fn(i, (*chunk)[i]);
+            return;
+        }
+        if (auto* pc = packed[chunk_idx].load(std::memory_order_acquire)) pc->scan(fn);
+    }
+
+    // 查询算子批量取值用的类型：int 列是 int，string 列是指向块内数据的 string_view
+    using ScanValue = std::conditional_t<std::is_same_v<T, std::string>, std::string_view, T>;
+
+    // 按块内偏移 (升序) 批量取值；string_view 在块被回收前有效 (查询期间持有快照即可)
+    void gatherChunk(size_t chunk_idx, const uint32_t* offs, size_t n, ScanValue* out) const {
+        if (auto* chunk = chunks[chunk_idx].load(std::memory_order_acquire)) {
+            for (size_t i = 0; i < n; ++i) out[i] = (*chunk)[offs[i]];
+            return;
+        }
+        if (auto* pc = packed[chunk_idx].load(std::memory_order_acquire)) {
+            pc->gather(offs, n, out);
+            return;
+        }
+        std::fill(out, out + n, ScanValue{}); // 块已被回收：这些行对快照本来就不可见
     }
 
-    void printValue(size_t row_idx) const override {
-        std::cout << get(row_idx);
+    // 整块求和 (只对 int 列有意义)
+    int64_t sumChunk(size_t chunk_idx) const {
+        static_assert(std::is_same_v<T, int>, "sumChunk requires Column<int>");
+        if (auto* chunk = chunks[chunk_idx].load(std::memory_order_acquire)) {
+            int64_t total = 0;
+            for (int v : *chunk) total += v;
+            return total;
+        }
+        if (auto* pc = packed[chunk_idx].load(std::memory_order_acquire)) return pc->sum();
+        return 0;
     }
 };
\ No newline at end of file
@@ -1,149 +1,750 @@
 #pragma once
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <iostream>
-#include <sstream>
 #include <vector>
+#include <limits>
+#include <algorithm>
+#include <variant>
 #include "Table.h"
+#include "Catalog.h"
+#include "SqlTokenizer.h"
+#include "Query.h"
+#include "HashJoin.h"
+#include "BulkLoader.h"
+#include "ResultCursor.h"
 
+// 预编译语句：SQL 只解析一次，执行计划和解析好的 Table* 缓存起来，之后每次只代入 ? 参数
+// 内部复用行缓冲：同一个语句对象不要在多个线程里同时 execute (不同的语句对象可以)
+// 持有 Table 的裸指针，不能比 Database 活得久
+class PreparedStatement {
+public:
+    // 执行一次：params 依次代入 ?；返回插入的行数
+    size_t execute(const std::vector<Table::Value>& params = {}) {
+        if (params.size() != param_count) {
+            throw SqlError("Error: Expected " + std::to_string(param_count) + " parameters, got " +
+                           std::to_string(params.size()));
+        }
+
+        size_t rows = slots.size() / num_cols;
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t c = 0; c < num_cols; ++c) {
+                const Slot& slot = slots[r * num_cols + c];
+                if (slot.param < 0) {
+                    row[c] = slot.constant;
+                    continue;
+                }
+                const Table::Value& v = params[slot.param];
+                checkType(c, v);
+                row[c] = v;
+            }
+            table->insertRow(row);
+        }
+        return rows;
+    }
+
+    size_t paramCount() const { return param_count; }
+
+    // 语句结束：把本线程在目标表上没用完的行号租约交还给表 (见 Table::parkRowLease)
+    void endStatement() { table->parkRowLease(); }
+
+private:
+    friend class Database;
+
+    // 一个值槽：常量，或者第 param 个 ? 参数
+    struct Slot {
+        int param = -1;
+        Table::Value constant;
+    };
+
+    Table* table = nullptr;
+    size_t num_cols = 0;
+    std::vector<Slot> slots;        // 行数 * 列数，按行排 (多行 INSERT)
+    size_t param_count = 0;
+    std::vector<Table::Value> row;  // 复用的行缓冲
+
+    // NULL 可以写进任何列
+    void checkType(size_t col, const Table::Value& v) const {
+        if (std::holds_alternative<std::monostate>(v)) return;
+        bool is_int = std::holds_alternative<int>(v);
+        if (is_int != (table->columnType(col) == TYPE_INT)) {
+            throw SqlError("Error: Type mismatch for column '" + table->columnName(col) + "'");
+        }
+    }
+};
+
+// 语句结束 (出错也一样) 时交还行号租约：执行 SQL 的线程 (服务端的工作线程) 一般不退出，
+// 不交还的话这些行号一直没提交，所在的块封存不了
+struct StatementLease {
+    PreparedStatement& stmt;
+    ~StatementLease() { stmt.endStatement(); }
+};
+
+// 会话：PREPARE name AS ... 注册的语句是会话自己的 (shell 用；C++ 调用方直接用 prepare())
+// 一个会话同一时刻只能在一个线程里执行；不同会话可以并发执行，表目录是共享的
+// 会话不占着行号租约：每条 INSERT / EXECUTE 结束时都已经交还给表 (见 Table::parkRowLease)
+struct Session {
+    std::unordered_map<std::string, std::unique_ptr<PreparedStatement>> prepared;
+};
+
+// 多个会话并发执行时：查表不加锁 (Catalog)，不同表上的语句互不阻塞，同一张表靠表自己的并发控制
 class Database {
 private:
-    std::unordered_map<std::string, std::unique_ptr<Table>> tables;
+    Catalog catalog;
+    Session shell_session; // executeSQL 不指定会话时用的
+    bool verbose = true;   // false = 成功时不打印 (批量导入)
 
 public:
-    // 获取表对象
-    Table* getTable(const std::string& name) {
-        if (tables.find(name) == tables.end()) return nullptr;
-        return tables[name].get();
+    // 获取表对象 (不加锁，可以和建表并发)
+    Table* getTable(std::string_view name) const { return catalog.find(name); }
+
+    void setVerbose(bool on) { verbose = on; }
+
+    // 预编译：目前支持 INSERT INTO t VALUES (?, ...), (...)
+    // 出错抛 SqlError
+    std::unique_ptr<PreparedStatement> prepare(std::string_view sql) {
+        SqlTokenizer tok(sql);
+        if (!tok.next().is("INSERT")) throw SqlError("Error: Only INSERT statements can be prepared");
+        return parseInsert(tok);
+    }
+
+    // 执行一条 SELECT，结果按列返回 (不打印)；出错抛 SqlError
+    // profile 非空时同时填上每一级的行数和耗时 (和 EXPLAIN ANALYZE 打印的是同一棵树)
+    QueryResult query(std::string_view sql, QueryProfile* profile = nullptr) {
+        SqlTokenizer tok(sql);
+        if (!tok.next().is("SELECT")) throw SqlError("Error: query() expects a SELECT statement");
+        return runSelect(parseSelect(tok), profile);
+    }
+
+    // 执行一条 SELECT，结果按批流式读出 (普通查询边扫边交，内存不随结果变大)；出错抛 SqlError
+    // 游标持有表的快照，必须在 Database 析构之前销毁
+    std::unique_ptr<ResultCursor> openCursor(std::string_view sql) {
+        SqlTokenizer tok(sql);
+        if (!tok.next().is("SELECT")) throw SqlError("Error: openCursor() expects a SELECT statement");
+        return openSelect(parseSelect(tok));
     }
 
     // --- SQL 解析与执行核心 ---
-    // 这是一个非常简化的 Parser，靠空格分割字符串
-    void executeSQL(const std::string& sql) {
-        std::stringstream ss(sql);
-        std::string cmd;
-        ss >> cmd;
-
-        if (cmd == "CREATE") {
-            handleCreate(ss);
-        } else if (cmd == "INSERT") {
-            handleInsert(ss);
-        } else if (cmd == "SELECT") {
-            handleSelect(ss);
-        } else {
-            std::cout << "Error: Unknown command '" << cmd << "'" << std::endl;
+    // 零拷贝词法分析 (string_view)，每条语句只扫一遍
+    void executeSQL(std::string_view sql) { executeSQL(sql, std::cout, shell_session); }
+
+    bool executeSQL(std::string_view sql, std::ostream& out) { return executeSQL(sql, out, shell_session); }
+
+    // 结果和提示信息写进 out (服务端每个请求一个缓冲)；出错时错误信息也写进 out，返回 false
+    // 不同的会话可以在不同线程里同时执行
+    bool executeSQL(std::string_view sql, std::ostream& out, Session& session) {
+        try {
+            SqlTokenizer tok(sql);
+            Token cmd = tok.next();
+            if (cmd.type == TOK_END) return true;
+
+            if (cmd.is("CREATE")) {
+                handleCreate(tok, out);
+            } else if (cmd.is("INSERT")) {
+                handleInsert(tok, out);
+            } else if (cmd.is("SELECT")) {
+                handleSelect(tok, out);
+            } else if (cmd.is("PREPARE")) {
+                handlePrepare(tok, out, session);
+            } else if (cmd.is("EXECUTE")) {
+                handleExecute(tok, out, session);
+            } else if (cmd.is("COPY")) {
+                handleCopy(tok, out);
+            } else if (cmd.is("SHOW")) {
+                handleShow(tok, out);
+            } else if (cmd.is("EXPLAIN")) {
+                handleExplain(tok, out);
+            } else {
+                out << "Error: Unknown command '" << cmd.text << "'" << std::endl;
+                return false;
+            }
+        } catch (const SqlError& e) {
+            out << e.what() << std::endl;
+            return false;
+        } catch (const std::exception& e) {
+            out << "Error: " << e.what() << std::endl;
+            return false;
         }
+        return true;
     }
 
 private:
-    // 处理: CREATE TABLE table_name (col1 INT, col2 STRING)
-void handleCreate(std::stringstream& ss) {
-        std::string table_keyword, table_name;
-        ss >> table_keyword >> table_name;
+    // 处理: CREATE TABLE table_name (col1 INT, col2 STRING INDEX, col3 INT SUM)
+    // 列修饰：INDEX (建哈希索引，仅 STRING 列)，SUM (累积列)
+    void handleCreate(SqlTokenizer& tok, std::ostream& out) {
+        if (tok.accept("INDEX")) {
+            handleCreateIndex(tok, out);
+            return;
+        }
+        tok.expect("TABLE");
+        std::string table_name(tok.expectIdent());
+        if (getTable(table_name)) throw SqlError("Error: Table '" + table_name + "' already exists.");
+
+        struct ColDef {
+            std::string name;
+            ColumnType type;
+            AggType agg;
+            bool index;
+        };
+        std::vector<ColDef> cols;
 
-        if (table_keyword != "TABLE") {
-            std::cout << "Syntax Error: Expected CREATE TABLE" << std::endl;
+        // 先把列定义全部解析完，语法错了不会留下半张表
+        tok.expect("(");
+        do {
+            ColDef def{std::string(tok.expectIdent()), TYPE_STRING, AGG_LAST, false};
+            Token type_tok = tok.next();
+            if (type_tok.type != TOK_IDENT) throw SqlError("Syntax Error: expected a column type near '" + std::string(type_tok.text) + "'");
+            def.type = type_tok.is("INT") ? TYPE_INT : TYPE_STRING;
+            while (true) {
+                if (tok.accept("INDEX") || tok.accept("KEY")) {
+                    def.index = true;
+                } else if (tok.accept("SUM")) {
+                    def.agg = AGG_SUM;
+                } else if (tok.accept("LAST")) {
+                    def.agg = AGG_LAST;
+                } else {
+                    break;
+                }
+            }
+            cols.push_back(std::move(def));
+        } while (tok.accept(","));
+        tok.expect(")");
+        if (!tok.atEnd()) throw SqlError("Syntax Error: unexpected tokens after CREATE TABLE");
+
+        // 另一个会话可能刚刚建了同名的表：以目录里的检查为准
+        Table* created = catalog.createIfAbsent(table_name, [&] {
+            auto t = std::make_unique<Table>(table_name);
+            for (const auto& def : cols) t->createColumn(def.name, def.type, def.agg, def.index);
+            return t;
+        });
+        if (!created) throw SqlError("Error: Table '" + table_name + "' already exists.");
+        if (verbose) out << "Table '" << table_name << "' created." << std::endl;
+    }
+
+    // 处理: CREATE INDEX [index_name] ON table_name (col)
+    // 在线建索引：已有的数据按块并行登记，期间写入和查询照常进行 (索引名只是占位，索引按列名找)
+    void handleCreateIndex(SqlTokenizer& tok, std::ostream& out) {
+        if (!tok.accept("ON")) {
+            tok.expectIdent();
+            tok.expect("ON");
+        }
+        std::string table_name(tok.expectIdent());
+        tok.expect("(");
+        std::string col_name(tok.expectIdent());
+        tok.expect(")");
+        if (!tok.atEnd()) throw SqlError("Syntax Error: unexpected tokens after CREATE INDEX");
+
+        Table* t = getTable(table_name);
+        if (!t) throw SqlError("Error: Table '" + table_name + "' not found.");
+        int col = t->columnIndex(col_name);
+        if (col < 0) throw SqlError("Error: Column '" + col_name + "' not found in table '" + table_name + "'");
+        if (t->columnType(col) != TYPE_STRING) throw SqlError("Error: Only STRING columns can be indexed");
+        if (t->hasIndex(col_name)) throw SqlError("Error: Column '" + col_name + "' is already indexed");
+
+        t->createIndex(col_name); // 另一个会话抢先建了同一列的索引时抛异常
+        if (verbose) out << "Index on " << table_name << "(" << col_name << ") created." << std::endl;
+    }
+
+    // 处理: INSERT INTO table_name VALUES (1, "Alice"), (2, "Bob")
+    //       INSERT INTO table_name (c1, c3) VALUES (1, 5)   没列出的列是 NULL (稀疏行)
+    void handleInsert(SqlTokenizer& tok, std::ostream& out) {
+        auto stmt = parseInsert(tok);
+        if (stmt->paramCount() > 0) throw SqlError("Error: '?' parameters are only allowed in PREPARE");
+        StatementLease lease{*stmt};
+        size_t n = stmt->execute();
+        if (verbose) out << n << (n == 1 ? " row" : " rows") << " inserted." << std::endl;
+    }
+
+    // 处理: SELECT cols FROM t [AS OF ts] [WHERE c op v [AND ...]] [GROUP BY cols]
+    //       SELECT cols FROM a [x] [INNER] JOIN b [y] ON x.k = y.k [WHERE ...]
+    // 聚合：COUNT / SUM / MIN / MAX / LAST (提交时间最新的那一行，即 AGG_LAST 语义)
+    // 结果经游标按批写进 stdout 的缓冲序列化器：表头一行，之后每行一条，列之间用 tab 分隔
+    void handleSelect(SqlTokenizer& tok, std::ostream& out) {
+        auto cursor = openSelect(parseSelect(tok));
+        TextResultWriter writer(out);
+        size_t rows = writer.drain(*cursor);
+        out << "(" << rows << (rows == 1 ? " row)" : " rows)") << std::endl;
+    }
+
+    // 处理: SHOW METRICS (引擎指标，Prometheus 文本格式)
+    //       SHOW TIMESTAMP t (表的当前提交时间戳和最早还能 AS OF 读的时间戳)
+    void handleShow(SqlTokenizer& tok, std::ostream& out) {
+        if (tok.accept("TIMESTAMP")) {
+            std::string_view name = tok.expectIdent();
+            Table* t = getTable(name);
+            if (!t) throw SqlError("Error: Table '" + std::string(name) + "' not found.");
+            if (!tok.atEnd()) throw SqlError("Syntax Error: unexpected '" + std::string(tok.next().text) + "' after SHOW TIMESTAMP");
+            out << "Timestamp: " << t->currentTimestamp() << " (history from " << t->historyFloor() << ")" << std::endl;
             return;
         }
+        tok.expect("METRICS");
+        if (!tok.atEnd()) throw SqlError("Syntax Error: unexpected '" + std::string(tok.next().text) + "' after SHOW METRICS");
+        out << Metrics::dump() << std::flush;
+    }
 
-        tables[table_name] = std::make_unique<Table>(table_name);
-        Table* t = tables[table_name].get();
+    // 处理: EXPLAIN [ANALYZE] SELECT ...
+    // EXPLAIN 只打印计划树；ANALYZE 真的执行一遍 (结果丢掉)，每个节点带上输出行数、独占耗时和扫描计数
+    void handleExplain(SqlTokenizer& tok, std::ostream& out) {
+        bool analyze = tok.accept("ANALYZE");
+        tok.expect("SELECT");
+        SelectStatement stmt = parseSelect(tok);
+        QueryProfile profile;
+        if (analyze) {
+            runSelect(stmt, &profile);
+        } else if (const JoinPlan* join = std::get_if<JoinPlan>(&stmt)) {
+            profile = HashJoinExecutor::explain(*join);
+        } else {
+            profile = QueryExecutor::explain(std::get<SelectPlan>(stmt));
+        }
+        out << profile.text() << std::flush;
+    }
 
-        std::string token;
-        // 循环读取 token
-        while (ss >> token) {
-            // --- 修复逻辑：跳过独立的括号和逗号 ---
-            if (token == "(" || token == "," || token == ")") continue;
-            
-            // 如果不是符号，那它就是列名
-            std::string col_name = token;
-            
-            // 紧接着读取下一个 token 作为类型
-            std::string type_str;
-            if (!(ss >> type_str)) break; // 防止读没了
+    // 处理: PREPARE name AS INSERT INTO t VALUES (?, ?)
+    void handlePrepare(SqlTokenizer& tok, std::ostream& out, Session& session) {
+        std::string name(tok.expectIdent());
+        tok.expect("AS");
+        session.prepared[name] = prepare(tok.rest());
+        if (verbose) out << "Statement '" << name << "' prepared." << std::endl;
+    }
 
-            // 清理可能粘在单词上的标点 (例如 "INT," -> "INT")
-            // 简单的清理逻辑
-            if (col_name.front() == '(') col_name.erase(0, 1);
-            if (type_str.back() == ',' || type_str.back() == ')') type_str.pop_back();
+    // 处理: EXECUTE name (1, "a") [, (2, "b") ...]   每组参数执行一次
+    void handleExecute(SqlTokenizer& tok, std::ostream& out, Session& session) {
+        std::string name(tok.expectIdent());
+        auto it = session.prepared.find(name);
+        if (it == session.prepared.end()) throw SqlError("Error: Prepared statement '" + name + "' not found.");
+        PreparedStatement& stmt = *it->second;
+        StatementLease lease{stmt};
 
-            ColumnType type = (type_str == "INT") ? TYPE_INT : TYPE_STRING;
-            t->createColumn(col_name, type, AGG_LAST);
+        size_t n = 0;
+        std::vector<Table::Value> params;
+        if (tok.atEnd()) {
+            n += stmt.execute(params);
+        } else {
+            do {
+                params.clear();
+                tok.expect("(");
+                if (!tok.accept(")")) {
+                    do {
+                        params.push_back(parseLiteral(tok));
+                    } while (tok.accept(","));
+                    tok.expect(")");
+                }
+                n += stmt.execute(params);
+            } while (tok.accept(","));
+            if (!tok.atEnd()) throw SqlError("Syntax Error: unexpected tokens after EXECUTE");
         }
-        std::cout << "Table '" << table_name << "' created." << std::endl;
+        if (verbose) out << n << (n == 1 ? " row" : " rows") << " inserted." << std::endl;
     }
 
-    // 处理: INSERT INTO table_name VALUES (1, "Alice")
-    void handleInsert(std::stringstream& ss) {
-        std::string into_kw, table_name, values_kw;
-        ss >> into_kw >> table_name >> values_kw;
+    // 处理: COPY t FROM 'file' [HEADER] [DELIMITER ';'] [COLUMNAR]
+    // 走 BulkLoader：并行解析、直接写块、一次提交 (提交后把导入的行补写进 WAL)
+    void handleCopy(SqlTokenizer& tok, std::ostream& out) {
+        std::string_view table_name = tok.expectIdent();
+        Table* t = getTable(table_name);
+        if (!t) throw SqlError("Error: Table '" + std::string(table_name) + "' not found.");
+        tok.expect("FROM");
+        Token file = tok.next();
+        if (file.type != TOK_STRING) throw SqlError("Syntax Error: expected a file name near '" + std::string(file.text) + "'");
+
+        BulkLoadOptions options;
+        bool columnar = false;
+        while (!tok.atEnd()) {
+            if (tok.accept("HEADER")) {
+                options.header = true;
+            } else if (tok.accept("COLUMNAR")) {
+                columnar = true;
+            } else if (tok.accept("DELIMITER")) {
+                Token d = tok.next();
+                if (d.type != TOK_STRING || d.text.size() != 1) throw SqlError("Syntax Error: DELIMITER expects a single character");
+                options.delimiter = d.text[0];
+            } else {
+                throw SqlError("Syntax Error: unexpected '" + std::string(tok.next().text) + "' in COPY");
+            }
+        }
+
+        std::string path(file.text);
+        BulkLoadStats stats = columnar ? BulkLoader::loadColumnar(*t, path, options) : BulkLoader::loadCsv(*t, path, options);
+        if (verbose) out << stats.rows << (stats.rows == 1 ? " row" : " rows") << " loaded." << std::endl;
+    }
 
+    // INSERT INTO t [(列, ...)] VALUES (...), (...) -> 执行计划 (调用方已经吃掉 INSERT)
+    // 写了列名时每行只给这些列的值，其余列的槽是常量 NULL
+    std::unique_ptr<PreparedStatement> parseInsert(SqlTokenizer& tok) {
+        tok.expect("INTO");
+        std::string_view table_name = tok.expectIdent();
         Table* t = getTable(table_name);
-        if (!t) {
-            std::cout << "Error: Table '" << table_name << "' not found." << std::endl;
-            return;
+        if (!t) throw SqlError("Error: Table '" + std::string(table_name) + "' not found.");
+
+        // VALUES 里第 i 个值写到哪一列
+        std::vector<size_t> targets;
+        bool listed = tok.accept("(");
+        if (listed) {
+            std::vector<char> seen(t->columnCount(), 0);
+            do {
+                std::string_view name = tok.expectIdent();
+                int col = t->columnIndex(name);
+                if (col < 0) throw SqlError("Error: Column '" + std::string(name) + "' not found in table '" + t->name() + "'");
+                if (seen[col]) throw SqlError("Error: Column '" + std::string(name) + "' is listed more than once");
+                seen[col] = 1;
+                targets.push_back(static_cast<size_t>(col));
+            } while (tok.accept(","));
+            tok.expect(")");
+        } else {
+            for (size_t c = 0; c < t->columnCount(); ++c) targets.push_back(c);
         }
+        tok.expect("VALUES");
+
+        auto stmt = std::make_unique<PreparedStatement>();
+        stmt->table = t;
+        stmt->num_cols = t->columnCount();
+        stmt->row.resize(stmt->num_cols);
 
-        std::string val_str;
-        std::vector<Table::Value> row;
-        
-        while (ss >> val_str) {
-            // --- 修复逻辑：跳过独立的括号和逗号 ---
-            // 如果遇到 "(", ",", ")" 这种单独的符号，直接跳过
-            if (val_str == "(" || val_str == "," || val_str == ")") continue;
-
-            // 清理粘连的符号 (如 "1," -> "1")
-            size_t start = val_str.find_first_not_of("(),");
-            size_t end = val_str.find_last_not_of("(),");
-            
-            // 如果全是符号（比如 "),"），清理后是空的，跳过
-            if (start == std::string::npos) continue;
-            
-            std::string clean = val_str.substr(start, end - start + 1);
-
-            if (clean.front() == '"') {
-                // 字符串
-                if (clean.back() == '"') {
-                    row.push_back(clean.substr(1, clean.size() - 2));
+        PreparedStatement::Slot null_slot;
+        null_slot.constant = std::monostate{};
+        do {
+            tok.expect("(");
+            size_t row_start = stmt->slots.size();
+            stmt->slots.resize(row_start + stmt->num_cols, null_slot);
+            for (size_t i = 0; i < targets.size(); ++i) {
+                if (i > 0) tok.expect(",");
+                PreparedStatement::Slot& slot = stmt->slots[row_start + targets[i]];
+                if (tok.peek().type == TOK_PARAM) {
+                    tok.next();
+                    slot.param = static_cast<int>(stmt->param_count++);
                 } else {
-                    row.push_back(clean.substr(1)); // 容错
+                    slot.constant = parseLiteral(tok);
+                    stmt->checkType(targets[i], slot.constant);
                 }
-            } else {
-                // 数字
-                try {
-                    row.push_back(std::stoi(clean));
-                } catch (...) {
-                    std::cout << "Error: Invalid number format '" << clean << "'" << std::endl;
-                    return;
+            }
+            if (!tok.accept(")")) {
+                if (listed) throw SqlError("Error: Expected " + std::to_string(targets.size()) + " values");
+                throw SqlError("Error: Table '" + t->name() + "' has " + std::to_string(stmt->num_cols) + " columns");
+            }
+        } while (tok.accept(","));
+
+        if (!tok.atEnd()) throw SqlError("Syntax Error: unexpected tokens after VALUES");
+        return stmt;
+    }
+
+    // FROM 后面的一张表：表名 [[AS] 别名] [AS OF 时间戳]，没写别名就用表名
+    struct TableRef {
+        Table* table = nullptr;
+        std::string_view alias;
+        uint64_t as_of = INF_TS;
+    };
+
+    // 列引用：[表名或别名.]列名
+    struct ColumnName {
+        std::string_view qualifier; // 空 = 没写
+        std::string_view name;
+
+        std::string text() const {
+            if (qualifier.empty()) return std::string(name);
+            return std::string(qualifier) + "." + std::string(name);
+        }
+    };
+
+    // 选择列表里的一项：FROM 在后面，先记下名字，拿到表以后再解析
+    struct RawItem {
+        AggFunc fn;
+        ColumnName col; // col.name 空 = *
+    };
+
+    using SelectStatement = std::variant<SelectPlan, JoinPlan>;
+
+    // 单表走 QueryExecutor，JOIN 走 HashJoinExecutor (两边各开自己的快照)
+    static QueryResult runSelect(const SelectStatement& stmt, QueryProfile* profile = nullptr) {
+        if (const JoinPlan* join = std::get_if<JoinPlan>(&stmt)) {
+            Snapshot left = join->left.scan.table->openSnapshotAt(join->left.scan.as_of);
+            Snapshot right = join->right.scan.table->openSnapshotAt(join->right.scan.as_of);
+            return HashJoinExecutor::run(*join, left, right, 0, profile);
+        }
+        const SelectPlan& plan = std::get<SelectPlan>(stmt);
+        Snapshot snap = plan.table->openSnapshotAt(plan.as_of);
+        return QueryExecutor::run(plan, snap, 0, profile);
+    }
+
+    // 普通查询用 ScanCursor 边扫边交；聚合和 JOIN 先算完，再按批交出
+    static std::unique_ptr<ResultCursor> openSelect(const SelectStatement& stmt) {
+        const SelectPlan* plan = std::get_if<SelectPlan>(&stmt);
+        if (plan && !plan->isAggregate()) return std::make_unique<ScanCursor>(*plan);
+        return std::make_unique<MaterializedCursor>(runSelect(stmt));
+    }
+
+    // SELECT 列表 / FROM [JOIN] / WHERE / GROUP BY -> 执行计划 (调用方已经吃掉 SELECT)
+    SelectStatement parseSelect(SqlTokenizer& tok) {
+        // 1. 选择列表
+        std::vector<RawItem> raw;
+        bool star = tok.accept("*");
+        if (!star) {
+            do {
+                std::string_view name = tok.expectIdent();
+                if (!tok.accept("(")) {
+                    raw.push_back({FN_NONE, finishColumnName(tok, name)});
+                    continue;
                 }
+                Token fn_tok{TOK_IDENT, name, 0};
+                AggFunc fn = fn_tok.is("COUNT") ? FN_COUNT : fn_tok.is("SUM") ? FN_SUM
+                           : fn_tok.is("MIN") ? FN_MIN : fn_tok.is("MAX") ? FN_MAX
+                           : fn_tok.is("LAST") ? FN_LAST : FN_NONE;
+                if (fn == FN_NONE) throw SqlError("Error: Unknown function '" + std::string(name) + "'");
+                ColumnName arg;
+                if (!(fn == FN_COUNT && tok.accept("*"))) arg = finishColumnName(tok, tok.expectIdent());
+                tok.expect(")");
+                raw.push_back({fn, arg});
+            } while (tok.accept(","));
+        }
+
+        tok.expect("FROM");
+        TableRef from = parseTableRef(tok);
+        bool join = tok.accept("JOIN");
+        if (!join && tok.accept("INNER")) {
+            tok.expect("JOIN");
+            join = true;
+        }
+        if (join) return parseJoin(tok, from, raw, star);
+
+        SelectPlan plan;
+        plan.table = from.table;
+        plan.as_of = from.as_of;
+        Table& t = *plan.table;
+        auto resolve = [&](const ColumnName& c) { return resolveColumn(from, c); };
+
+        if (star) {
+            for (size_t c = 0; c < t.columnCount(); ++c) plan.items.push_back({FN_NONE, static_cast<int>(c), t.columnName(c)});
+        }
+        for (const auto& r : raw) {
+            SelectItem item{r.fn, r.col.name.empty() ? -1 : resolve(r.col), r.col.text()};
+            if (r.fn == FN_SUM && t.columnType(item.col) != TYPE_INT) {
+                throw SqlError("Error: SUM requires an INT column, '" + item.label + "' is STRING");
             }
+            if (r.fn != FN_NONE) {
+                static const char* const fn_names[] = {"", "COUNT", "SUM", "MIN", "MAX", "LAST"};
+                item.label = std::string(fn_names[r.fn]) + "(" + (r.col.name.empty() ? "*" : item.label) + ")";
+            }
+            plan.items.push_back(std::move(item));
         }
-        
-        try {
-            t->insertRow(row);
-            std::cout << "1 row inserted." << std::endl;
-        } catch (std::exception& e) {
-            std::cout << "Insert Error: " << e.what() << std::endl;
+
+        // 2. WHERE：AND 连接的 列 op 常量
+        if (tok.accept("WHERE")) {
+            do {
+                size_t col = static_cast<size_t>(resolve(parseColumnName(tok)));
+                plan.where.push_back(parseComparison(tok, t, col));
+            } while (tok.accept("AND"));
+        }
+
+        // 3. GROUP BY
+        if (tok.accept("GROUP")) {
+            tok.expect("BY");
+            do {
+                plan.group_by.push_back(static_cast<size_t>(resolve(parseColumnName(tok))));
+            } while (tok.accept(","));
+        }
+        if (!tok.atEnd()) throw SqlError("Syntax Error: unexpected tokens after SELECT");
+
+        // 4. 聚合查询里的普通列必须出现在 GROUP BY 里
+        if (plan.isAggregate()) {
+            for (const auto& item : plan.items) {
+                if (item.fn != FN_NONE) continue;
+                if (std::find(plan.group_by.begin(), plan.group_by.end(), static_cast<size_t>(item.col)) == plan.group_by.end()) {
+                    throw SqlError("Error: Column '" + item.label + "' must appear in GROUP BY or inside an aggregate");
+                }
+            }
         }
+
+        chooseIndex(plan);
+        return plan;
     }
 
-    // 处理: SELECT * FROM table_name
-    void handleSelect(std::stringstream& ss) {
-        std::string cols, from_kw, table_name;
-        ss >> cols >> from_kw >> table_name;
+    // ... FROM a [x] [INNER] JOIN b [y] ON x.k = y.k [WHERE ...] (调用方已经吃掉 JOIN)
+    // 输出：列投影 (* = 左表所有列 + 右表所有列)，或者只数行数 COUNT(*)
+    // WHERE 条件按所属的表下推到那一边的扫描
+    JoinPlan parseJoin(SqlTokenizer& tok, const TableRef& left, const std::vector<RawItem>& raw, bool star) {
+        // 1. 右表；两边要能用名字区分开 (自连接必须起别名)
+        TableRef right = parseTableRef(tok);
+        if (left.alias == right.alias) {
+            throw SqlError("Error: Both sides of JOIN are named '" + std::string(left.alias) + "', use an alias");
+        }
+        const TableRef refs[2] = {left, right};
 
-        Table* t = getTable(table_name);
-        if (!t) {
-            std::cout << "Error: Table '" << table_name << "' not found." << std::endl;
-            return;
+        // 列引用 -> (哪一边, 第几列)；没写限定名时两边都有这一列就是歧义
+        auto resolve = [&](const ColumnName& c) -> std::pair<int, size_t> {
+            if (!c.qualifier.empty()) {
+                for (int side = 0; side < 2; ++side) {
+                    if (c.qualifier == refs[side].alias) return {side, static_cast<size_t>(resolveColumn(refs[side], c))};
+                }
+                throw SqlError("Error: Unknown table '" + std::string(c.qualifier) + "'");
+            }
+            int l = left.table->columnIndex(c.name);
+            int r = right.table->columnIndex(c.name);
+            if (l >= 0 && r >= 0) throw SqlError("Error: Column '" + c.text() + "' is ambiguous");
+            if (l >= 0) return {0, static_cast<size_t>(l)};
+            if (r >= 0) return {1, static_cast<size_t>(r)};
+            throw SqlError("Error: Column '" + c.text() + "' not found");
+        };
+
+        JoinPlan plan;
+        plan.left.scan.table = left.table;
+        plan.right.scan.table = right.table;
+        plan.left.scan.as_of = left.as_of;
+        plan.right.scan.as_of = right.as_of;
+
+        // 2. ON：两边各一列的等值条件
+        tok.expect("ON");
+        auto a = resolve(parseColumnName(tok));
+        tok.expect("=");
+        auto b = resolve(parseColumnName(tok));
+        if (a.first == b.first) throw SqlError("Error: JOIN condition must compare a column from each table");
+        if (a.first == 1) std::swap(a, b);
+        plan.left.key_col = a.second;
+        plan.right.key_col = b.second;
+        if (left.table->columnType(a.second) != right.table->columnType(b.second)) {
+            throw SqlError("Error: JOIN keys '" + left.table->columnName(a.second) + "' and '" +
+                           right.table->columnName(b.second) + "' have different types");
         }
 
-        if (cols == "*") {
-            t->printAll();
+        // 3. WHERE
+        if (tok.accept("WHERE")) {
+            do {
+                auto [side, col] = resolve(parseColumnName(tok));
+                SelectPlan& scan = side == 0 ? plan.left.scan : plan.right.scan;
+                scan.where.push_back(parseComparison(tok, *scan.table, col));
+            } while (tok.accept("AND"));
+        }
+        if (tok.peek().is("GROUP")) throw SqlError("Error: GROUP BY is not supported with JOIN");
+        if (!tok.atEnd()) throw SqlError("Syntax Error: unexpected tokens after SELECT");
+
+        // 4. 输出列
+        if (star) {
+            for (int side = 0; side < 2; ++side) {
+                const Table& t = *refs[side].table;
+                for (size_t c = 0; c < t.columnCount(); ++c) {
+                    plan.items.push_back({side, c, std::string(refs[side].alias) + "." + t.columnName(c)});
+                }
+            }
+        }
+        for (const auto& r : raw) {
+            if (r.fn != FN_NONE) {
+                if (r.fn != FN_COUNT || !r.col.name.empty() || raw.size() != 1) {
+                    throw SqlError("Error: Only SELECT COUNT(*) is supported as an aggregate over JOIN");
+                }
+                plan.count_only = true;
+                continue;
+            }
+            auto [side, col] = resolve(r.col);
+            plan.items.push_back({side, col, r.col.text()});
+        }
+
+        chooseIndex(plan.left.scan);
+        chooseIndex(plan.right.scan);
+        return plan;
+    }
+
+    TableRef parseTableRef(SqlTokenizer& tok) {
+        std::string_view name = tok.expectIdent();
+        TableRef ref{getTable(name), name};
+        if (!ref.table) throw SqlError("Error: Table '" + std::string(name) + "' not found.");
+
+        // AS 后面是 OF 就是历史查询，不是别名
+        if (tok.accept("AS")) {
+            if (tok.accept("OF")) {
+                ref.as_of = parseTimestamp(tok);
+                return ref;
+            }
+            ref.alias = tok.expectIdent();
         } else {
-            // 暂时只支持 *
-            std::cout << "Feature not implemented: Column selection" << std::endl;
+            const Token& next = tok.peek();
+            if (next.type == TOK_IDENT && !next.is("JOIN") && !next.is("INNER") && !next.is("ON") &&
+                !next.is("WHERE") && !next.is("GROUP")) {
+                ref.alias = tok.next().text;
+            }
+        }
+        if (tok.accept("AS")) {
+            tok.expect("OF");
+            ref.as_of = parseTimestamp(tok);
+        }
+        return ref;
+    }
+
+    // AS OF 后面的时间戳 (SHOW TIMESTAMP 看到的值)
+    static uint64_t parseTimestamp(SqlTokenizer& tok) {
+        Token v = tok.next();
+        if (v.type != TOK_NUMBER) throw SqlError("Syntax Error: expected a timestamp after AS OF near '" + std::string(v.text) + "'");
+        return static_cast<uint64_t>(v.number);
+    }
+
+    static ColumnName parseColumnName(SqlTokenizer& tok) {
+        return finishColumnName(tok, tok.expectIdent());
+    }
+
+    // 已经读了第一个名字：后面跟着 '.' 的话它是表名
+    static ColumnName finishColumnName(SqlTokenizer& tok, std::string_view first) {
+        if (!tok.accept(".")) return {{}, first};
+        return {first, tok.expectIdent()};
+    }
+
+    // 单表里解析一个列引用；写了限定名就必须是这张表 (或它的别名)
+    static int resolveColumn(const TableRef& ref, const ColumnName& c) {
+        const Table& t = *ref.table;
+        if (!c.qualifier.empty() && c.qualifier != ref.alias) {
+            throw SqlError("Error: Unknown table '" + std::string(c.qualifier) + "'");
+        }
+        int col = t.columnIndex(c.name);
+        if (col < 0) throw SqlError("Error: Column '" + std::string(c.name) + "' not found in table '" + t.name() + "'");
+        return col;
+    }
+
+    // WHERE 里的一个条件 (列已经解析好)：op 常量
+    static Predicate parseComparison(SqlTokenizer& tok, const Table& t, size_t col) {
+        Predicate pred;
+        pred.col = col;
+        Token op = tok.next();
+        if (op.is("=")) pred.op = CMP_EQ;
+        else if (op.is("!=") || op.is("<>")) pred.op = CMP_NE;
+        else if (op.is("<")) pred.op = CMP_LT;
+        else if (op.is("<=")) pred.op = CMP_LE;
+        else if (op.is(">")) pred.op = CMP_GT;
+        else if (op.is(">=")) pred.op = CMP_GE;
+        else throw SqlError("Syntax Error: expected a comparison near '" + std::string(op.text) + "'");
+
+        Table::Value v = parseLiteral(tok);
+        if (std::holds_alternative<std::monostate>(v)) {
+            throw SqlError("Error: Comparison with NULL is never true for column '" + t.columnName(pred.col) + "'");
+        }
+        if (std::holds_alternative<int>(v) != (t.columnType(pred.col) == TYPE_INT)) {
+            throw SqlError("Error: Type mismatch for column '" + t.columnName(pred.col) + "'");
+        }
+        if (std::holds_alternative<int>(v)) pred.int_value = std::get<int>(v);
+        else pred.str_value = std::get<std::string>(v);
+        return pred;
+    }
+
+    // 索引下推：第一个落在有索引列上的等值条件
+    static void chooseIndex(SelectPlan& plan) {
+        const Table& t = *plan.table;
+        for (size_t i = 0; i < plan.where.size(); ++i) {
+            const Predicate& pred = plan.where[i];
+            if (pred.op == CMP_EQ && t.columnType(pred.col) == TYPE_STRING && t.hasIndex(t.columnName(pred.col))) {
+                plan.index_pred = static_cast<int>(i);
+                break;
+            }
+        }
+    }
+
+    // 字面量：整数 (可带负号)、字符串或 NULL
+    static Table::Value parseLiteral(SqlTokenizer& tok) {
+        if (tok.accept("NULL")) return std::monostate{};
+        bool negative = tok.accept("-");
+        Token v = tok.next();
+        if (v.type == TOK_STRING && !negative) return std::string(v.text);
+        if (v.type != TOK_NUMBER) throw SqlError("Syntax Error: expected a value near '" + std::string(v.text) + "'");
+
+        int64_t n = negative ? -v.number : v.number;
+        if (n < std::numeric_limits<int>::min() || n > std::numeric_limits<int>::max()) {
+            throw SqlError("Error: Integer out of range '" + std::string(v.text) + "'");
         }
+        return static_cast<int>(n);
     }
-};
\ No newline at end of file
+};
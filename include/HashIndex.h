@@ -4,60 +4,320 @@
 #include <unordered_map>
 #include <atomic> // 必须引入
 #include <thread>
+#include <algorithm>
+#include <string_view>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include "Column.h"
+#include "Metrics.h"
 
 constexpr size_t INDEX_SHARDS = 1024;
+// 版本链的结尾
+constexpr uint32_t NO_VERSION = UINT32_MAX;
 
+static_assert(MAX_CHUNKS * CHUNK_SIZE < NO_VERSION, "row ids must fit in 32 bits");
+
+// 批量登记的一项：key -> 行号，ts 是这一行的提交时间戳
+struct IndexEntry {
+    std::string_view key;
+    size_t row;
+    uint64_t ts;
+};
+
+// --- 哈希索引 + 版本链 ---
+// 索引里每个 key 只存最新版本的行号 (链表头)；每一行记着同一个 key 的上一个 (更旧的) 版本
+// 链按 (提交时间戳, 行号) 从新到旧排：点查从表头往下走，拿到要的值就能停，不用看完所有版本
+// 链的指针按行分块存 (和列一样 CHUNK_SIZE 行一块)，块里第一次有行进索引时才分配
+//
+// 并发：改链 (挂新版本、GC 摘旧版本) 都在分片锁里；走链只在锁里读表头，之后不加锁
+//   挂新版本先写好节点再发布 (release)，摘版本只改前驱的指针，被摘的节点自己的指针不动
+//   所以走到一半的读者总能走完剩下的链；块被 GC 摘掉以后读到的是链尾 (读者靠 Table 的顺序锁重来)
 class HashIndex {
 private:
+    // 一块行的链节点
+    struct VersionChunk {
+        std::atomic<uint32_t> prev[CHUNK_SIZE]; // 同一个 key 的上一个版本，NO_VERSION = 最旧
+        uint64_t ts[CHUNK_SIZE];                // 这一行的提交时间戳 (挂上链以后不变)
+    };
+
+    // 一个 key：最新版本的行号 + 链上的版本数
+    struct Head {
+        uint32_t row = NO_VERSION;
+        uint32_t versions = 0;
+    };
+
     struct Shard {
         // 替换 mutex 为 atomic_flag (轻量级自旋锁)
         std::atomic_flag lock = ATOMIC_FLAG_INIT;
-        std::unordered_map<std::string, std::vector<size_t>> map;
+        std::unordered_map<std::string, Head> map;
     };
 
     std::vector<Shard> shards;
+    std::atomic<VersionChunk*> chains[MAX_CHUNKS];
 
-public:
-    HashIndex() : shards(INDEX_SHARDS) {}
+    static void lockShard(Shard& shard) {
+        while (shard.lock.test_and_set(std::memory_order_acquire)) {
+            Metrics::add(METRIC_INDEX_SPIN_WAITS); // 只在抢不到时记，无竞争时没有开销
+            std::this_thread::yield();
+        }
+    }
 
-    void insert(const std::string& key, size_t row_id) {
-        size_t hash_val = std::hash<std::string>{}(key);
-        size_t shard_idx = hash_val % INDEX_SHARDS;
+    static void unlockShard(Shard& shard) {
+        shard.lock.clear(std::memory_order_release);
+    }
 
-        Shard& shard = shards[shard_idx];
-        
-        // --- 自旋锁逻辑 Start ---
-        // test_and_set 返回 true 表示锁被占用了，那就一直 while 循环等待
-        while (shard.lock.test_and_set(std::memory_order_acquire)) {
-            // 提示 CPU 我在忙等，稍微休息下避免发热，但别睡觉
-            std::this_thread::yield(); 
+    Shard& shardFor(std::string_view key) {
+        return shards[std::hash<std::string_view>{}(key) % INDEX_SHARDS];
+    }
+
+    // 在已经算好的桶里找 key (持有分片锁)：std::unordered_map 没有带哈希的 find，find 会再算一遍哈希
+    // 桶号 = 哈希 % 桶数 (libstdc++ 和 libc++ 都是这样，和 bucket() 一致)；节点里缓存了哈希，走桶不再算
+    static const Head* findInBucket(const std::unordered_map<std::string, Head>& map, size_t bucket, const std::string& key) {
+        for (auto it = map.begin(bucket); it != map.end(bucket); ++it) {
+            if (it->first == key) return &it->second;
         }
-        // --- 临界区 ---
+        return nullptr;
+    }
 
-        shard.map[key].push_back(row_id);
+    // 行所在的链块，没有就分配 (只在分片锁里调用；不同分片可能同时分配同一块，CAS 决出一个)
+    VersionChunk& chunkFor(size_t row) {
+        std::atomic<VersionChunk*>& slot = chains[row / CHUNK_SIZE];
+        VersionChunk* vc = slot.load(std::memory_order_acquire);
+        if (vc) return *vc;
+        auto* fresh = new VersionChunk; // 不清零：节点挂上链之前一定先写
+        if (slot.compare_exchange_strong(vc, fresh, std::memory_order_acq_rel)) return *fresh;
+        delete fresh;
+        return *vc;
+    }
 
-        // --- 解锁 ---
-        shard.lock.clear(std::memory_order_release);
+    std::atomic<uint32_t>& prevOf(uint32_t row) const {
+        return chains[row / CHUNK_SIZE].load(std::memory_order_acquire)->prev[row % CHUNK_SIZE];
     }
 
-    std::vector<size_t> get(const std::string& key) {
-        size_t hash_val = std::hash<std::string>{}(key);
-        size_t shard_idx = hash_val % INDEX_SHARDS;
+    uint64_t tsOf(uint32_t row) const {
+        return chains[row / CHUNK_SIZE].load(std::memory_order_acquire)->ts[row % CHUNK_SIZE];
+    }
 
-        Shard& shard = shards[shard_idx];
-        
-        // 读的时候也要加锁
-        while (shard.lock.test_and_set(std::memory_order_acquire)) {
-            std::this_thread::yield();
+    // (ts, row) 比 (other_ts, other) 新：时间戳相同 (批量导入是一个时间戳) 时行号大的新
+    static bool newer(uint64_t ts, uint32_t row, uint64_t other_ts, uint32_t other) {
+        return ts > other_ts || (ts == other_ts && row > other);
+    }
+
+    // 把 row 挂到 key 的链上 (持有分片锁)
+    // 一般比表头新，直接放最前面；并发写同一个 key 时时间戳小的可能后到，往下找到位置插进去
+    // 已经在链上的行不再挂 (在线建索引时扫描和写入可能各登记一次同一行)
+    void linkLocked(Head& head, uint32_t row, uint64_t ts) {
+        if (head.row == row) return;
+        VersionChunk& vc = chunkFor(row);
+        if (head.row == NO_VERSION || newer(ts, row, tsOf(head.row), head.row)) {
+            vc.ts[row % CHUNK_SIZE] = ts;
+            vc.prev[row % CHUNK_SIZE].store(head.row, std::memory_order_relaxed);
+            head.row = row; // 读者在锁里读表头
+            head.versions++;
+            return;
+        }
+        // 链按 (ts, row) 严格有序：这一行要是已经在链上，一定正好在它该插的位置
+        uint32_t p = head.row;
+        while (true) {
+            uint32_t q = prevOf(p).load(std::memory_order_relaxed);
+            if (q == row) return;
+            if (q == NO_VERSION || newer(ts, row, tsOf(q), q)) break;
+            p = q;
         }
+        vc.ts[row % CHUNK_SIZE] = ts;
+        vc.prev[row % CHUNK_SIZE].store(prevOf(p).load(std::memory_order_relaxed), std::memory_order_relaxed);
+        prevOf(p).store(row, std::memory_order_release); // 不加锁走链的读者可能正经过 p
+        head.versions++;
+    }
+
+public:
+    HashIndex() : shards(INDEX_SHARDS) {
+        for (auto& c : chains) c.store(nullptr);
+    }
+
+    ~HashIndex() {
+        for (auto& c : chains) delete c.load();
+    }
+
+    HashIndex(const HashIndex&) = delete;
+    HashIndex& operator=(const HashIndex&) = delete;
+
+    // ts：这一行的提交时间戳 (行可以还没提交，时间戳已经领好)
+    void insert(const std::string& key, size_t row_id, uint64_t ts) {
+        Shard& shard = shardFor(key);
+
+        // 自旋锁 (抢不到就 yield，次数记进 METRIC_INDEX_SPIN_WAITS)
+        lockShard(shard);
+        linkLocked(shard.map[key], static_cast<uint32_t>(row_id), ts);
+        unlockShard(shard);
+    }
+
+    // key 的所有版本 (从新到旧)
+    std::vector<size_t> get(const std::string& key) {
+        Shard& shard = shardFor(key);
+
+        // 读的时候也要加锁 (GC 摘版本也在锁里，拿到的是一条完整的链)
+        lockShard(shard);
 
         std::vector<size_t> result;
         auto it = shard.map.find(key);
         if (it != shard.map.end()) {
-            result = it->second;
+            result.reserve(it->second.versions);
+            for (uint32_t r = it->second.row; r != NO_VERSION; r = prevOf(r).load(std::memory_order_relaxed)) {
+                result.push_back(r);
+            }
         }
 
-        shard.lock.clear(std::memory_order_release);
+        unlockShard(shard);
         return result;
     }
-};
\ No newline at end of file
+
+    // key 的最新版本 (版本链的表头)，没有这个 key 返回 NO_VERSION
+    size_t newest(const std::string& key) {
+        Shard& shard = shardFor(key);
+        lockShard(shard);
+        auto it = shard.map.find(key);
+        uint32_t row = it == shard.map.end() ? NO_VERSION : it->second.row;
+        unlockShard(shard);
+        return row;
+    }
+
+    // 批量取表头 (multiGet 用)：out[i] = keys[i] 的最新版本，没有这个 key 是 NO_VERSION
+    // 单个 find 要连着走 桶 -> 前一个节点 -> 节点 几次缓存未命中，一个一个查时全是串行的；这里分几轮做：
+    //   1. 每个 key 只算一次哈希，预取分片 (锁和 map 的表头)，按分片号排好
+    //   2. 涉及的分片从小到大一次锁上 (别的操作同时只拿一个分片锁，两个批量查询也都按同一顺序拿，不会死锁)
+    //   3. 用同一个哈希算出桶号，再一轮只读桶里第一个节点的位置并预取它：各个 key 的访存互不依赖，未命中可以重叠
+    //   4. 在桶里按 key 比较 (findInBucket)，这时节点已经在缓存里，也不再算哈希
+    void newestBatch(const std::string* keys, size_t n, std::vector<size_t>& out) {
+        out.assign(n, NO_VERSION);
+        struct Probe {
+            uint32_t shard;
+            uint32_t key;    // keys 的下标
+            size_t hash;
+            size_t bucket;
+        };
+        std::vector<Probe> probes(n);
+        for (size_t i = 0; i < n; ++i) {
+            size_t h = std::hash<std::string>{}(keys[i]);
+            uint32_t s = static_cast<uint32_t>(h % INDEX_SHARDS);
+            __builtin_prefetch(&shards[s]);
+            probes[i] = {s, static_cast<uint32_t>(i), h, 0};
+        }
+        std::sort(probes.begin(), probes.end(),
+                  [](const Probe& a, const Probe& b) { return a.shard < b.shard || (a.shard == b.shard && a.key < b.key); });
+
+        auto firstOfShard = [&](size_t i) { return i == 0 || probes[i].shard != probes[i - 1].shard; };
+        for (size_t i = 0; i < n; ++i) {
+            if (firstOfShard(i)) lockShard(shards[probes[i].shard]);
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            const auto& map = shards[probes[i].shard].map;
+            probes[i].bucket = probes[i].hash % map.bucket_count();
+            auto it = map.begin(probes[i].bucket);
+            if (it != map.end(probes[i].bucket)) __builtin_prefetch(&*it);
+        }
+        for (const Probe& p : probes) {
+            if (const Head* head = findInBucket(shards[p.shard].map, p.bucket, keys[p.key])) out[p.key] = head->row;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            if (firstOfShard(i)) unlockShard(shards[probes[i].shard]);
+        }
+    }
+
+    // 预取一行的链节点 (批量点查走到这一行之前先发出去)
+    void prefetch(size_t row) const {
+        if (VersionChunk* vc = chains[row / CHUNK_SIZE].load(std::memory_order_acquire)) {
+            __builtin_prefetch(&vc->prev[row % CHUNK_SIZE]);
+        }
+    }
+
+    // 同一个 key 的上一个版本，不加锁 (点查从 newest() 开始往下走，拿到要的值就停)
+    // 块已被 GC 摘下时返回 NO_VERSION：调用方在 Table 的顺序锁里，会整个重来
+    size_t older(size_t row) const {
+        VersionChunk* vc = chains[row / CHUNK_SIZE].load(std::memory_order_acquire);
+        if (!vc) return NO_VERSION;
+        return vc->prev[row % CHUNK_SIZE].load(std::memory_order_acquire);
+    }
+
+    // 批量登记 (建索引 / 批量导入用)：先按分片排好，每个分片只加一次锁
+    // 查 key 用复用的缓冲，只有新 key 才真正分配字符串
+    void insertBatch(const std::vector<IndexEntry>& entries) {
+        // 1. 按分片做计数排序
+        std::vector<uint32_t> shard_of(entries.size());
+        std::vector<size_t> start(INDEX_SHARDS + 1, 0);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            shard_of[i] = static_cast<uint32_t>(std::hash<std::string_view>{}(entries[i].key) % INDEX_SHARDS);
+            start[shard_of[i] + 1]++;
+        }
+        for (size_t s = 0; s < INDEX_SHARDS; ++s) start[s + 1] += start[s];
+        std::vector<uint32_t> order(entries.size());
+        std::vector<size_t> pos(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < entries.size(); ++i) order[pos[shard_of[i]]++] = static_cast<uint32_t>(i);
+
+        // 2. 逐分片写入 (std::hash<std::string_view> 和 std::hash<std::string> 对同样的字符结果相同)
+        std::string key;
+        for (size_t s = 0; s < INDEX_SHARDS; ++s) {
+            if (start[s] == start[s + 1]) continue;
+            Shard& shard = shards[s];
+            lockShard(shard);
+            for (size_t k = start[s]; k < start[s + 1]; ++k) {
+                const IndexEntry& e = entries[order[k]];
+                key.assign(e.key.data(), e.key.size());
+                auto it = shard.map.find(key);
+                if (it == shard.map.end()) it = shard.map.emplace(key, Head()).first;
+                linkLocked(it->second, static_cast<uint32_t>(e.row), e.ts);
+            }
+            unlockShard(shard);
+        }
+    }
+
+    // 从 key 的版本链上摘掉一批行 (GC 折叠旧版本后调用)
+    // 只改前驱的指针：正走到被摘节点上的读者还能顺着它走下去
+    void erase(const std::string& key, std::vector<size_t> rows) {
+        std::sort(rows.begin(), rows.end());
+        Shard& shard = shardFor(key);
+        lockShard(shard);
+
+        auto it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            Head& head = it->second;
+            uint32_t pred = NO_VERSION;
+            for (uint32_t cur = head.row; cur != NO_VERSION;) {
+                uint32_t next = prevOf(cur).load(std::memory_order_relaxed);
+                if (std::binary_search(rows.begin(), rows.end(), static_cast<size_t>(cur))) {
+                    if (pred == NO_VERSION) head.row = next;
+                    else prevOf(pred).store(next, std::memory_order_release);
+                    head.versions--;
+                } else {
+                    pred = cur;
+                }
+                cur = next;
+            }
+            if (head.versions == 0) shard.map.erase(it);
+        }
+
+        unlockShard(shard);
+    }
+
+    // 收集版本数 >= min_rows 的所有 key (GC 找多版本 key 用)
+    std::vector<std::string> keysWithRows(size_t min_rows) {
+        std::vector<std::string> keys;
+        for (auto& shard : shards) {
+            lockShard(shard);
+            for (const auto& kv : shard.map) {
+                if (kv.second.versions >= min_rows) keys.push_back(kv.first);
+            }
+            unlockShard(shard);
+        }
+        return keys;
+    }
+
+    // 把一块行的链节点摘下来，返回真正释放的函数 (块里的行已经都不在链上，GC 等旧读者退出后调用)
+    std::function<void()> detachChunk(size_t chunk_idx) {
+        VersionChunk* vc = chains[chunk_idx].exchange(nullptr, std::memory_order_acq_rel);
+        return [vc] { delete vc; };
+    }
+};
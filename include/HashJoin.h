@@ -0,0 +1,366 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <stdexcept>
+#include "Query.h"
+
+// --- 两表等值连接：基数分区哈希连接 (radix hash join) ---
+// 1. 收集：两边各自按块并行扫描 (带这一边的 WHERE 和这张表自己的 MVCC 快照)，取出 (hash, 行号, key)
+// 2. 分区：按 hash 高位分成 2^bits 个分区，让每个分区 build 那一边的元组 + 桶数组能放进 L2
+//    每个线程先数自己的直方图，前缀和算出写入位置，再各自并行搬运，不用锁
+// 3. 连接：分区之间互不相干，线程领分区，小的一边建链式哈希表 (桶用 hash 低位)，另一边探测
+// 4. 输出：只数行数 (COUNT(*))，或者按行号取出输出列
+// STRING key 存 string_view，指向列块里的数据：调用方持有两边的快照期间有效 (块不会被释放)
+// 传入 QueryProfile 时记下每一步的行数和耗时 (EXPLAIN ANALYZE)
+
+// 每个分区 build 一侧的目标大小
+constexpr size_t JOIN_PARTITION_BYTES = 256 * 1024;
+// 一趟分区最多 4096 个分区 (再多 TLB 就扛不住了)
+constexpr size_t JOIN_MAX_RADIX_BITS = 12;
+
+// 连接的一边：表 + 这一边的 WHERE 条件 (可以下推索引)，items 不用
+struct JoinInput {
+    SelectPlan scan;
+    size_t key_col = 0;
+};
+
+// 输出列：side 0 = 左表，1 = 右表
+struct JoinOutput {
+    int side = 0;
+    size_t col = 0;
+    std::string label;
+};
+
+struct JoinPlan {
+    JoinInput left;
+    JoinInput right;
+    std::vector<JoinOutput> items;
+    bool count_only = false; // SELECT COUNT(*)：只数匹配的行数，不取列
+};
+
+inline uint64_t joinHash(int key) {
+    // murmur3 fmix64：相邻的整数 key 也能打散到各个分区
+    uint64_t h = static_cast<uint32_t>(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t joinHash(std::string_view key) {
+    return std::hash<std::string_view>{}(key);
+}
+
+// 行号用 32 位 (最多 MAX_CHUNKS * CHUNK_SIZE 行)：INT key 的元组只有 16 字节
+static_assert(MAX_CHUNKS * CHUNK_SIZE <= UINT32_MAX, "row ids must fit in 32 bits");
+
+template <typename K>
+struct JoinTuple {
+    uint64_t hash;
+    uint32_t row; // 全局行号
+    K key;
+};
+
+// 收集 (sink)：把选中行的 key 取出来，连同 hash 和行号追加到本线程的元组数组
+template <typename K>
+class JoinCollectOperator : public BatchOperator {
+private:
+    ColumnRef ref;
+    std::vector<JoinTuple<K>>& out;
+    std::vector<K> buf;
+
+public:
+    JoinCollectOperator(ColumnRef r, std::vector<JoinTuple<K>>& o) : ref(r), out(o) {}
+
+    void push(size_t chunk, std::vector<uint32_t>& sel) override {
+        // NULL key 和谁都连不上
+        if (const NullBitmap* nulls = ref.nulls(chunk)) dropNulls(sel, *nulls);
+        buf.resize(sel.size());
+        if constexpr (std::is_same_v<K, int>) {
+            ref.ints->gatherChunk(chunk, sel.data(), sel.size(), buf.data());
+        } else {
+            ref.strs->gatherChunk(chunk, sel.data(), sel.size(), buf.data());
+        }
+        size_t base = chunk * CHUNK_SIZE;
+        for (size_t i = 0; i < sel.size(); ++i) out.push_back({joinHash(buf[i]), static_cast<uint32_t>(base + sel[i]), buf[i]});
+    }
+};
+
+class HashJoinExecutor {
+public:
+    // 左右两边各用自己的快照；threads = 0：用 hardware_concurrency 个线程
+    static QueryResult run(const JoinPlan& plan, const Snapshot& left_snap, const Snapshot& right_snap, size_t threads = 0,
+                           QueryProfile* profile = nullptr) {
+        const Table& lt = *plan.left.scan.table;
+        const Table& rt = *plan.right.scan.table;
+        if (lt.columnType(plan.left.key_col) != rt.columnType(plan.right.key_col)) {
+            throw std::runtime_error("JOIN keys must have the same type");
+        }
+        if (threads == 0) threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+        if (lt.columnType(plan.left.key_col) == TYPE_INT) {
+            return runTyped<int>(plan, left_snap.timestamp(), right_snap.timestamp(), threads, profile);
+        }
+        return runTyped<std::string_view>(plan, left_snap.timestamp(), right_snap.timestamp(), threads, profile);
+    }
+
+    // 只出计划 (EXPLAIN)：不执行
+    static QueryProfile explain(const JoinPlan& plan) {
+        QueryProfile profile;
+        profile.root = planTree(plan, nullptr, nullptr);
+        return profile;
+    }
+
+private:
+    // 各步骤的计数，只在剖析时填
+    struct JoinStats {
+        PipelineStats left, right;
+        uint64_t left_rows = 0, right_rows = 0;
+        bool build_left = true;
+        size_t bits = 0;
+        uint64_t matches = 0;
+        uint64_t partition_ns = 0, join_ns = 0, output_ns = 0;
+    };
+
+    static std::string keyText(const JoinInput& input) {
+        return input.scan.table->name() + "." + input.scan.table->columnName(input.key_col);
+    }
+
+    // 输出 -> 连接 -> 分区 -> 两边的收集流水线；st 为空时只有标签
+    static ProfileNode planTree(const JoinPlan& plan, const JoinStats* st, const QueryResult* result) {
+        auto side = [&](const JoinInput& input, const PipelineStats* ps, uint64_t rows) {
+            return pipelineProfile(*input.scan.table, input.scan, "Collect: " + keyText(input), ps, rows);
+        };
+        ProfileNode part("Radix Partition");
+        part.children.push_back(side(plan.left, st ? &st->left : nullptr, st ? st->left_rows : 0));
+        part.children.push_back(side(plan.right, st ? &st->right : nullptr, st ? st->right_rows : 0));
+
+        ProfileNode join("Hash Join: " + keyText(plan.left) + " = " + keyText(plan.right));
+        ProfileNode out(plan.count_only ? std::string("Count: COUNT(*)") : "Output: " + [&] {
+            std::string labels;
+            for (const auto& item : plan.items) labels += (labels.empty() ? "" : ", ") + item.label;
+            return labels;
+        }());
+        if (st) {
+            part.rows = st->left_rows + st->right_rows;
+            part.time_ns = st->partition_ns;
+            part.count("partitions", uint64_t(1) << st->bits);
+            join.rows = st->matches;
+            join.time_ns = st->join_ns;
+            join.count(st->build_left ? "build_left" : "build_right", st->build_left ? st->left_rows : st->right_rows);
+            out.rows = result->rowCount();
+            out.time_ns = st->output_ns;
+        }
+        join.children.push_back(std::move(part));
+        out.children.push_back(std::move(join));
+        return out;
+    }
+
+    using Match = std::pair<uint32_t, uint32_t>; // (左表行号, 右表行号)
+
+    static size_t partitionOf(uint64_t hash, size_t bits) {
+        return bits == 0 ? 0 : static_cast<size_t>(hash >> (64 - bits));
+    }
+
+    // build 一侧总共 build_bytes，分到每个分区不超过 JOIN_PARTITION_BYTES
+    static size_t radixBits(size_t build_bytes) {
+        size_t bits = 0;
+        while (bits < JOIN_MAX_RADIX_BITS && (build_bytes >> bits) > JOIN_PARTITION_BYTES) ++bits;
+        return bits;
+    }
+
+    // 1. 收集一边：返回每个线程一个元组数组
+    template <typename K>
+    static std::vector<std::vector<JoinTuple<K>>> collect(const JoinInput& input, uint64_t ts, size_t threads,
+                                                         PipelineStats* stats = nullptr) {
+        Table& table = *input.scan.table;
+        ColumnRef key = ColumnRef::of(table, input.key_col);
+
+        return table.readConsistent([&] {
+            size_t workers = input.scan.index_pred >= 0 ? 1 : std::max<size_t>(1, std::min(threads, table.chunkCount()));
+            std::vector<std::vector<JoinTuple<K>>> out(workers);
+            if (input.scan.where.empty() && input.scan.index_pred < 0) {
+                // 没有过滤条件：差不多每块都是满的，先按平均分到的块数预留，省掉扩容时的整体搬运
+                for (auto& v : out) v.reserve((table.chunkCount() / workers + 1) * CHUNK_SIZE);
+            }
+            std::vector<PipelineStats> local(stats ? workers : 0);
+            std::atomic<size_t> next_chunk{0};
+            QueryExecutor::parallelFor(workers, [&](size_t w) {
+                PipelineStats* st = stats ? &local[w] : nullptr;
+                JoinCollectOperator<K> sink(key, out[w]);
+                OperatorChain ops;
+                BatchOperator* head = QueryExecutor::buildFilters(table, input.scan, &sink, ops, st);
+                if (input.scan.index_pred >= 0) {
+                    QueryExecutor::scanIndex(table, input.scan.where[input.scan.index_pred], ts, *head, st);
+                } else {
+                    QueryExecutor::scanTable(table, ts, *head, next_chunk, st);
+                }
+            });
+            if (stats) {
+                // readConsistent 重试时从头再数
+                *stats = PipelineStats();
+                for (const auto& st : local) stats->merge(st);
+            }
+            return out;
+        });
+    }
+
+    // 2. 分区：out 里分区 p 占 [offsets[p], offsets[p + 1])，分区内先放 0 号线程的元组，再放 1 号的 ...
+    template <typename K>
+    static void partition(std::vector<std::vector<JoinTuple<K>>>& in, size_t bits,
+                          std::vector<JoinTuple<K>>& out, std::vector<size_t>& offsets) {
+        size_t parts = size_t(1) << bits;
+        std::vector<std::vector<size_t>> cursor(in.size(), std::vector<size_t>(parts, 0));
+        QueryExecutor::parallelFor(in.size(), [&](size_t w) {
+            for (const auto& t : in[w]) cursor[w][partitionOf(t.hash, bits)]++;
+        });
+
+        offsets.assign(parts + 1, 0);
+        size_t pos = 0;
+        for (size_t p = 0; p < parts; ++p) {
+            offsets[p] = pos;
+            for (auto& c : cursor) {
+                size_t n = c[p];
+                c[p] = pos;
+                pos += n;
+            }
+        }
+        offsets[parts] = pos;
+
+        out.resize(pos);
+        QueryExecutor::parallelFor(in.size(), [&](size_t w) {
+            std::vector<size_t>& c = cursor[w];
+            for (const auto& t : in[w]) out[c[partitionOf(t.hash, bits)]++] = t;
+            std::vector<JoinTuple<K>>().swap(in[w]); // 搬完就释放
+        });
+    }
+
+    template <typename K>
+    static QueryResult runTyped(const JoinPlan& plan, uint64_t left_ts, uint64_t right_ts, size_t threads,
+                                QueryProfile* profile) {
+        JoinStats stats;
+        JoinStats* st = profile ? &stats : nullptr;
+        uint64_t start = profile ? profileClock() : 0;
+        uint64_t t0 = start;
+        // 记一步的耗时：从上一步结束到现在
+        auto lap = [&](uint64_t& ns) {
+            if (!st) return;
+            uint64_t now = profileClock();
+            ns = now - t0;
+            t0 = now;
+        };
+
+        // 1. 收集，行数少的一边做 build
+        auto left = collect<K>(plan.left, left_ts, threads, st ? &st->left : nullptr);
+        auto right = collect<K>(plan.right, right_ts, threads, st ? &st->right : nullptr);
+        auto total = [](const std::vector<std::vector<JoinTuple<K>>>& v) {
+            size_t n = 0;
+            for (const auto& part : v) n += part.size();
+            return n;
+        };
+        bool build_left = total(left) <= total(right);
+        if (st) {
+            st->left_rows = total(left);
+            st->right_rows = total(right);
+            st->build_left = build_left;
+            t0 = profileClock();
+        }
+
+        // 2. 两边用同样的分区数
+        size_t bits = radixBits(std::min(total(left), total(right)) * sizeof(JoinTuple<K>));
+        std::vector<JoinTuple<K>> build, probe;
+        std::vector<size_t> build_off, probe_off;
+        partition(build_left ? left : right, bits, build, build_off);
+        partition(build_left ? right : left, bits, probe, probe_off);
+        if (st) st->bits = bits;
+        lap(stats.partition_ns);
+
+        // 3. 逐分区建表、探测
+        size_t parts = size_t(1) << bits;
+        std::vector<std::vector<Match>> matches(threads);
+        std::vector<size_t> counts(threads, 0);
+        std::atomic<size_t> next_part{0};
+        QueryExecutor::parallelFor(threads, [&](size_t w) {
+            constexpr uint32_t NONE = UINT32_MAX;
+            std::vector<uint32_t> heads, chain;
+            for (size_t p = next_part++; p < parts; p = next_part++) {
+                size_t b0 = build_off[p], nb = build_off[p + 1] - b0;
+                size_t p0 = probe_off[p], p1 = probe_off[p + 1];
+                if (nb == 0 || p0 == p1) continue;
+
+                size_t cap = 1;
+                while (cap < nb * 2) cap <<= 1;
+                size_t mask = cap - 1;
+                heads.assign(cap, NONE);
+                chain.resize(nb);
+                for (size_t i = 0; i < nb; ++i) {
+                    size_t slot = build[b0 + i].hash & mask;
+                    chain[i] = heads[slot];
+                    heads[slot] = static_cast<uint32_t>(i);
+                }
+
+                for (size_t j = p0; j < p1; ++j) {
+                    const JoinTuple<K>& t = probe[j];
+                    for (uint32_t i = heads[t.hash & mask]; i != NONE; i = chain[i]) {
+                        const JoinTuple<K>& b = build[b0 + i];
+                        if (b.hash != t.hash || b.key != t.key) continue;
+                        if (plan.count_only) counts[w]++;
+                        else matches[w].push_back(build_left ? Match{b.row, t.row} : Match{t.row, b.row});
+                    }
+                }
+            }
+        });
+
+        if (st) {
+            for (size_t c : counts) st->matches += c;
+            for (const auto& m : matches) st->matches += m.size();
+        }
+        lap(stats.join_ns);
+
+        // 4. 输出
+        QueryResult result;
+        auto finish = [&]() -> QueryResult {
+            if (profile) {
+                lap(stats.output_ns);
+                profile->analyzed = true;
+                profile->root = planTree(plan, st, &result);
+                profile->threads = threads;
+                profile->total_ns = profileClock() - start;
+            }
+            return std::move(result);
+        };
+        if (plan.count_only) {
+            int64_t n = 0;
+            for (size_t c : counts) n += c;
+            result.columns.push_back({"COUNT(*)", TYPE_INT, {n}, {}});
+            return finish();
+        }
+        for (const auto& item : plan.items) {
+            Table& t = item.side == 0 ? *plan.left.scan.table : *plan.right.scan.table;
+            ColumnRef ref = ColumnRef::of(t, item.col);
+            ResultColumn col{item.label, t.columnType(item.col), {}, {}};
+            // 和扫描一样在这张表的一致性读里取值 (GC 切换版本时重来)
+            t.readConsistent([&] {
+                col.ints.clear();
+                col.strings.clear();
+                for (const auto& part : matches) {
+                    for (const Match& m : part) {
+                        size_t row = item.side == 0 ? m.first : m.second;
+                        if (ref.ints) col.ints.push_back(ref.ints->get(row));
+                        else col.strings.push_back(ref.strs->get(row));
+                    }
+                }
+                return 0;
+            });
+            result.columns.push_back(std::move(col));
+        }
+        return finish();
+    }
+};
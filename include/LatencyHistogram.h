@@ -0,0 +1,93 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// --- 延迟直方图 (对数-线性分桶，HdrHistogram 的简化版) ---
+// 每个 2 的幂区间再等分成 2^LATENCY_SUB_BITS 个桶，相对误差不超过 1/2^LATENCY_SUB_BITS (约 3%)
+// 小于 2^(LATENCY_SUB_BITS + 1) 的值一个值一个桶，是精确的
+// 记录只有一次加法，不加锁：每个线程记自己的直方图，最后 merge
+// 单位由调用方决定 (benchmark 用纳秒)
+
+constexpr unsigned LATENCY_SUB_BITS = 5;
+constexpr size_t LATENCY_SUB_BUCKETS = size_t(1) << LATENCY_SUB_BITS;
+// 最高位是 63 时 e = 63 - LATENCY_SUB_BITS，桶号最大 e * SUB + 2 * SUB - 1
+constexpr size_t LATENCY_BUCKETS = (64 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS;
+
+class LatencyHistogram {
+private:
+    std::array<uint64_t, LATENCY_BUCKETS> buckets{};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t min_value = UINT64_MAX;
+    uint64_t max_value = 0;
+
+public:
+    static size_t bucketOf(uint64_t v) {
+        if (v < 2 * LATENCY_SUB_BUCKETS) return static_cast<size_t>(v);
+        unsigned e = 63 - __builtin_clzll(v) - LATENCY_SUB_BITS;
+        return e * LATENCY_SUB_BUCKETS + static_cast<size_t>(v >> e);
+    }
+
+    // 桶的下界和宽度
+    static uint64_t bucketLow(size_t b) {
+        if (b < 2 * LATENCY_SUB_BUCKETS) return b;
+        unsigned e = static_cast<unsigned>(b / LATENCY_SUB_BUCKETS - 1);
+        return static_cast<uint64_t>(b - e * LATENCY_SUB_BUCKETS) << e;
+    }
+
+    static uint64_t bucketWidth(size_t b) {
+        if (b < 2 * LATENCY_SUB_BUCKETS) return 1;
+        return uint64_t(1) << (b / LATENCY_SUB_BUCKETS - 1);
+    }
+
+    void record(uint64_t v) {
+        buckets[bucketOf(v)]++;
+        total++;
+        sum += v;
+        min_value = std::min(min_value, v);
+        max_value = std::max(max_value, v);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t b = 0; b < LATENCY_BUCKETS; ++b) buckets[b] += other.buckets[b];
+        total += other.total;
+        sum += other.sum;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    // 导入别处按同样分桶数好的计数 (Metrics 的原子直方图)；最小值取第一个非空桶的下界
+    void addBucket(size_t b, uint64_t n) {
+        if (n == 0) return;
+        buckets[b] += n;
+        total += n;
+        min_value = std::min(min_value, bucketLow(b));
+    }
+
+    void addSummary(uint64_t value_sum, uint64_t value_max) {
+        sum += value_sum;
+        max_value = std::max(max_value, value_max);
+    }
+
+    void reset() { *this = LatencyHistogram(); }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+    uint64_t valueSum() const { return sum; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0.0; }
+
+    // q 分位 (0 < q <= 1)：第 ceil(q * count) 个值所在桶的中点，不超过实际最大值
+    uint64_t percentile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(total))));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < LATENCY_BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen >= rank) return std::min(max_value, bucketLow(b) + (bucketWidth(b) - 1) / 2);
+        }
+        return max_value;
+    }
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "LatencyHistogram.h"
+
+// --- 引擎内部指标 ---
+// 每个线程一份计数分片 (按缓存行对齐)，只有本线程写：一次 relaxed load + store，没有 lock 前缀指令，也没有伪共享
+// 读的时候 (snapshot) 把所有分片加起来，线程退出后分片留给下一个线程接着用，累计值不丢
+// 全进程一份 (不分表)；计时只放在低频路径上 (租约补货、WAL 刷盘)，热路径只有计数
+// 文本格式按 Prometheus exposition 输出，可以直接被抓取
+
+enum MetricCounter {
+    METRIC_INSERTS,            // insertRow 写入的行数
+    METRIC_CHUNK_ALLOCS,       // 新分配的块数 (MVCC 时间戳块，每块一次)
+    METRIC_INDEX_SPIN_WAITS,   // HashIndex 分片自旋锁没抢到、让出 CPU 的次数
+    METRIC_WAL_FLUSHES,        // WAL 写盘次数 (有数据的批)
+    METRIC_POINT_QUERIES,      // querySnapshot 点查次数
+    METRIC_COUNTER_COUNT
+};
+
+enum MetricHistogram {
+    METRIC_ENSURE_CHUNK_NS,    // 补一次行号租约时分配块 (ensureChunk) 花的时间
+    METRIC_WAL_FLUSH_BYTES,    // 每次写盘的字节数 (编码后、压缩前)
+    METRIC_WAL_FLUSH_NS,       // 每次写盘 (含 fdatasync) 的时间
+    METRIC_VERSIONS_PER_KEY,   // 点查一个 key 扫过的候选版本数
+    METRIC_HISTOGRAM_COUNT
+};
+
+inline const char* metricCounterName(MetricCounter c) {
+    static const char* const names[METRIC_COUNTER_COUNT] = {
+        "havana_inserts_total", "havana_chunk_allocations_total", "havana_index_spin_waits_total",
+        "havana_wal_flushes_total", "havana_point_queries_total"};
+    return names[c];
+}
+
+inline const char* metricHistogramName(MetricHistogram h) {
+    static const char* const names[METRIC_HISTOGRAM_COUNT] = {
+        "havana_ensure_chunk_ns", "havana_wal_flush_bytes", "havana_wal_flush_ns", "havana_query_versions_per_key"};
+    return names[h];
+}
+
+// 一个线程的分片：只有所属线程写，别的线程只读
+struct alignas(64) MetricsShard {
+    std::array<std::atomic<uint64_t>, METRIC_COUNTER_COUNT> counters{};
+
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> buckets{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+    std::array<Histogram, METRIC_HISTOGRAM_COUNT> histograms{};
+
+    // 单写者：不需要原子的读改写
+    static void bump(std::atomic<uint64_t>& a, uint64_t n) {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void add(MetricCounter c, uint64_t n) { bump(counters[c], n); }
+
+    void record(MetricHistogram h, uint64_t v) {
+        Histogram& hist = histograms[h];
+        bump(hist.buckets[LatencyHistogram::bucketOf(v)], 1);
+        bump(hist.sum, v);
+        if (v > hist.max.load(std::memory_order_relaxed)) hist.max.store(v, std::memory_order_relaxed);
+    }
+};
+
+// 某一时刻所有分片的合计
+struct MetricsSnapshot {
+    std::array<uint64_t, METRIC_COUNTER_COUNT> counters{};
+    std::vector<LatencyHistogram> histograms = std::vector<LatencyHistogram>(METRIC_HISTOGRAM_COUNT);
+
+    uint64_t counter(MetricCounter c) const { return counters[c]; }
+    const LatencyHistogram& histogram(MetricHistogram h) const { return histograms[h]; }
+
+    // Prometheus 文本格式：计数器一行，直方图按 summary 输出分位数、_sum、_count，最大值另作一个 gauge
+    std::string text() const {
+        std::string out;
+        for (int c = 0; c < METRIC_COUNTER_COUNT; ++c) {
+            const char* name = metricCounterName(static_cast<MetricCounter>(c));
+            out += std::string("# TYPE ") + name + " counter\n";
+            out += std::string(name) + " " + std::to_string(counters[c]) + "\n";
+        }
+        static const std::pair<const char*, double> quantiles[] = {{"0.5", 0.5}, {"0.9", 0.9}, {"0.99", 0.99}, {"0.999", 0.999}};
+        for (int h = 0; h < METRIC_HISTOGRAM_COUNT; ++h) {
+            const char* name = metricHistogramName(static_cast<MetricHistogram>(h));
+            const LatencyHistogram& hist = histograms[h];
+            out += std::string("# TYPE ") + name + " summary\n";
+            for (const auto& q : quantiles) {
+                out += std::string(name) + "{quantile=\"" + q.first + "\"} " + std::to_string(hist.percentile(q.second)) + "\n";
+            }
+            out += std::string(name) + "_sum " + std::to_string(hist.valueSum()) + "\n";
+            out += std::string(name) + "_count " + std::to_string(hist.count()) + "\n";
+            out += std::string("# TYPE ") + name + "_max gauge\n";
+            out += std::string(name) + "_max " + std::to_string(hist.max()) + "\n";
+        }
+        return out;
+    }
+};
+
+class Metrics {
+private:
+    std::mutex mtx;
+    std::vector<std::unique_ptr<MetricsShard>> shards;  // 只增不减，snapshot 要读到所有线程的累计值
+    std::vector<MetricsShard*> free_shards;             // 线程退出后空出来的分片
+
+    static Metrics& instance() {
+        static Metrics m;
+        return m;
+    }
+
+    MetricsShard* acquire() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!free_shards.empty()) {
+            MetricsShard* s = free_shards.back();
+            free_shards.pop_back();
+            return s;
+        }
+        shards.push_back(std::make_unique<MetricsShard>());
+        return shards.back().get();
+    }
+
+    void release(MetricsShard* s) {
+        std::lock_guard<std::mutex> lock(mtx);
+        free_shards.push_back(s);
+    }
+
+    // 线程第一次记指标时领一个分片，线程退出时归还
+    struct LocalHandle {
+        Metrics& owner;
+        MetricsShard* shard;
+        LocalHandle() : owner(instance()), shard(owner.acquire()) {}
+        ~LocalHandle() { owner.release(shard); }
+    };
+
+    static MetricsShard& local() {
+        thread_local LocalHandle handle;
+        return *handle.shard;
+    }
+
+public:
+    static void add(MetricCounter c, uint64_t n = 1) { local().add(c, n); }
+
+    static void record(MetricHistogram h, uint64_t v) { local().record(h, v); }
+
+    // 所有分片的合计 (和写线程并发，各个计数各自是某一刻的值)
+    static MetricsSnapshot snapshot() {
+        Metrics& m = instance();
+        MetricsSnapshot snap;
+        std::lock_guard<std::mutex> lock(m.mtx);
+        for (const auto& s : m.shards) {
+            for (int c = 0; c < METRIC_COUNTER_COUNT; ++c) snap.counters[c] += s->counters[c].load(std::memory_order_relaxed);
+            for (int h = 0; h < METRIC_HISTOGRAM_COUNT; ++h) {
+                const MetricsShard::Histogram& src = s->histograms[h];
+                LatencyHistogram& dst = snap.histograms[h];
+                for (size_t b = 0; b < LATENCY_BUCKETS; ++b) dst.addBucket(b, src.buckets[b].load(std::memory_order_relaxed));
+                dst.addSummary(src.sum.load(std::memory_order_relaxed), src.max.load(std::memory_order_relaxed));
+            }
+        }
+        return snap;
+    }
+
+    static std::string dump() { return snapshot().text(); }
+};
+
+// 作用域计时：析构时把经过的纳秒数记进直方图
+class MetricTimer {
+private:
+    MetricHistogram hist;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit MetricTimer(MetricHistogram h) : hist(h), start(std::chrono::steady_clock::now()) {}
+    ~MetricTimer() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        Metrics::record(hist, static_cast<uint64_t>(ns));
+    }
+};
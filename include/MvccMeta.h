@@ -2,64 +2,235 @@
 #include <vector>
 #include <cstdint>
 #include <limits>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include "Column.h"
+#include "Metrics.h"
 
 const uint64_t INF_TS = std::numeric_limits<uint64_t>::max();
+// 租约归还后永远不会被写入的空洞行：已"决议"但永远不可见
+const uint64_t DEAD_TS = INF_TS - 1;
+
+// 提交时间戳摘要的粒度：一块切成若干段，每段记一个值
+constexpr size_t BORN_SPAN = 1024;
+constexpr size_t BORN_SPANS = (CHUNK_SIZE + BORN_SPAN - 1) / BORN_SPAN;
+
+// 一块行的提交时间戳范围 (块里每行都有结论之后才建，之后不再变)，历史查询 (AS OF) 用它跳过整块或块尾
+// 行号大致按提交顺序分配，但租约和 GC 折叠行 (时间戳是被折叠的版本的) 让块内不严格有序；
+// suffix_min[s] 是第 s 段到块尾最早的提交时间戳，单调不减，可以二分
+struct BornRange {
+    uint64_t min_ts = INF_TS;  // 不算空洞；整块都是空洞时是 INF_TS
+    uint64_t max_ts = 0;
+    uint64_t suffix_min[BORN_SPANS];
+
+    // 块内偏移 >= 返回值的行在 ts 时都还没提交 (按段对齐，0 = 整块都还没有)
+    size_t bornEnd(uint64_t ts) const {
+        const uint64_t* it = std::upper_bound(suffix_min, suffix_min + BORN_SPANS, ts);
+        return std::min(CHUNK_SIZE, static_cast<size_t>(it - suffix_min) * BORN_SPAN);
+    }
+};
 
 class MvccMeta {
 private:
-    std::atomic<std::vector<uint64_t>*> chunks_created[MAX_CHUNKS];
-    std::atomic<std::vector<uint64_t>*> chunks_invalidated[MAX_CHUNKS]; // 仅用于 AGG_LAST 模式
+    // 每块 CHUNK_SIZE 个时间戳；可能是堆内存，也可能指向 mmap 进来的表文件
+    std::atomic<uint64_t*> chunks_created[MAX_CHUNKS];
+    std::atomic<uint64_t*> chunks_invalidated[MAX_CHUNKS]; // 仅用于 AGG_LAST 模式
+    bool mapped[MAX_CHUNKS];                               // true = 内存属于映射文件，不能 delete
+    // 每块里对所有快照都已经死掉的行数 (空洞 + 被 GC 折叠掉的旧版本)
+    std::atomic<uint32_t> dead_rows[MAX_CHUNKS];
+    // 每块的提交时间戳范围，块里每行都有结论 (封存) 之后才有
+    std::atomic<BornRange*> born_ranges[MAX_CHUNKS];
     std::mutex alloc_mutex;
 
 public:
     MvccMeta() {
         for (auto& p : chunks_created) p.store(nullptr);
         for (auto& p : chunks_invalidated) p.store(nullptr);
+        for (auto& d : dead_rows) d.store(0);
+        for (auto& r : born_ranges) r.store(nullptr);
+        for (auto& m : mapped) m = false;
+    }
+
+    ~MvccMeta() {
+        for (size_t c = 0; c < MAX_CHUNKS; ++c) {
+            delete born_ranges[c].load();
+            if (mapped[c]) continue;
+            delete[] chunks_created[c].load();
+            delete[] chunks_invalidated[c].load();
+        }
     }
-    // 析构函数略 (记得 delete)...
 
     void ensureChunk(size_t chunk_idx) {
+        if (chunk_idx >= MAX_CHUNKS) throw std::out_of_range("Exceeded DB Max Capacity");
         if (chunks_created[chunk_idx].load(std::memory_order_acquire)) return;
-        
+
         std::lock_guard<std::mutex> lock(alloc_mutex);
         if (!chunks_created[chunk_idx].load(std::memory_order_relaxed)) {
             // 初始化为 INF_TS
-            auto* c1 = new std::vector<uint64_t>(CHUNK_SIZE, INF_TS);
-            auto* c2 = new std::vector<uint64_t>(CHUNK_SIZE, INF_TS);
-            chunks_created[chunk_idx].store(c1, std::memory_order_release);
+            auto* c1 = new uint64_t[CHUNK_SIZE];
+            auto* c2 = new uint64_t[CHUNK_SIZE];
+            std::fill(c1, c1 + CHUNK_SIZE, INF_TS);
+            std::fill(c2, c2 + CHUNK_SIZE, INF_TS);
             chunks_invalidated[chunk_idx].store(c2, std::memory_order_release);
+            chunks_created[chunk_idx].store(c1, std::memory_order_release);
+            Metrics::add(METRIC_CHUNK_ALLOCS);
         }
     }
 
     void setCreated(size_t row_idx, uint64_t ts) {
         size_t c_idx = row_idx / CHUNK_SIZE;
         size_t offset = row_idx % CHUNK_SIZE;
-        (*chunks_created[c_idx].load(std::memory_order_relaxed))[offset] = ts;
+        chunks_created[c_idx].load(std::memory_order_relaxed)[offset] = ts;
+    }
+
+    // [begin, end) 一起提交 (批量导入)，块已经分配好
+    void setCreatedRange(size_t begin, size_t end, uint64_t ts) {
+        while (begin < end) {
+            size_t c_idx = begin / CHUNK_SIZE;
+            size_t stop = std::min(end, (c_idx + 1) * CHUNK_SIZE);
+            uint64_t* chunk = chunks_created[c_idx].load(std::memory_order_relaxed);
+            std::fill(chunk + begin % CHUNK_SIZE, chunk + (stop - c_idx * CHUNK_SIZE), ts);
+            begin = stop;
+        }
+    }
+
+    // 空洞行：永远不可见，计入死亡行数
+    void markDead(size_t row_idx) {
+        setCreated(row_idx, DEAD_TS);
+        dead_rows[row_idx / CHUNK_SIZE].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 从 ts 起这行不再可见 (被新版本取代)
+    // 调用方保证 ts 不晚于低水位，也就是说这行对所有快照都已经死了
+    void setInvalidated(size_t row_idx, uint64_t ts) {
+        size_t c_idx = row_idx / CHUNK_SIZE;
+        size_t offset = row_idx % CHUNK_SIZE;
+        chunks_invalidated[c_idx].load(std::memory_order_relaxed)[offset] = ts;
+        dead_rows[c_idx].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 按保留策略截断：从 ts 起这行不再可见，但不算进死亡行数 (GC 不会因此回收这块，由截断等低水位越过 ts 再摘)
+    // ts 是截断新领的、还没提交的时间戳，比它早的快照照样看得到这行
+    void setDropped(size_t row_idx, uint64_t ts) {
+        chunks_invalidated[row_idx / CHUNK_SIZE].load(std::memory_order_relaxed)[row_idx % CHUNK_SIZE] = ts;
     }
 
     bool isVisible(size_t row_idx, uint64_t query_ts) const {
         size_t c_idx = row_idx / CHUNK_SIZE;
         size_t offset = row_idx % CHUNK_SIZE;
-        
-        auto* c_ptr = chunks_created[c_idx].load(std::memory_order_relaxed);
-        if (!c_ptr) return false; // 还没分配，肯定不可见
-        
-        uint64_t born = (*c_ptr)[offset];
-        if (born == INF_TS || born > query_ts) return false;
-        
-        // 既然是 Hybrid 架构，我们主要看出生时间。
-        // 如果要看死亡时间，逻辑同理
-        return true; 
+
+        auto* c_ptr = chunks_created[c_idx].load(std::memory_order_acquire);
+        if (!c_ptr) return false; // 还没分配 (或已回收)，肯定不可见
+
+        uint64_t born = c_ptr[offset];
+        if (born >= DEAD_TS || born > query_ts) return false;
+
+        // 被 GC 折叠掉的旧版本
+        auto* d_ptr = chunks_invalidated[c_idx].load(std::memory_order_relaxed);
+        if (!d_ptr) return false; // 读的过程中整块被回收了
+        return d_ptr[offset] > query_ts;
     }
+
+    // 预取一行的两个时间戳 (批量点查判可见性之前先发出去)
+    void prefetch(size_t row_idx) const {
+        size_t c_idx = row_idx / CHUNK_SIZE;
+        size_t offset = row_idx % CHUNK_SIZE;
+        if (auto* c_ptr = chunks_created[c_idx].load(std::memory_order_acquire)) __builtin_prefetch(c_ptr + offset);
+        if (auto* d_ptr = chunks_invalidated[c_idx].load(std::memory_order_relaxed)) __builtin_prefetch(d_ptr + offset);
+    }
+
     uint64_t getCreated(size_t row_idx) const {
         size_t c_idx = row_idx / CHUNK_SIZE;
         size_t offset = row_idx % CHUNK_SIZE;
-        
+
         auto* chunk = chunks_created[c_idx].load(std::memory_order_relaxed);
-        
+
         // 如果块还没分配，返回 INF_TS (表示没生出来)
-        if (!chunk) return INF_TS; 
-        
-        return (*chunk)[offset];
+        if (!chunk) return INF_TS;
+
+        return chunk[offset];
+    }
+
+    uint64_t getInvalidated(size_t row_idx) const {
+        size_t c_idx = row_idx / CHUNK_SIZE;
+        size_t offset = row_idx % CHUNK_SIZE;
+        auto* chunk = chunks_invalidated[c_idx].load(std::memory_order_relaxed);
+        if (!chunk) return INF_TS;
+        return chunk[offset];
+    }
+
+    bool hasChunk(size_t chunk_idx) const {
+        return chunks_created[chunk_idx].load(std::memory_order_acquire) != nullptr;
+    }
+
+    size_t deadRows(size_t chunk_idx) const {
+        return dead_rows[chunk_idx].load(std::memory_order_relaxed);
+    }
+
+    // 给一块算提交时间戳范围 (调用方保证块里每行都已提交或是空洞，之后 created 不会再变)
+    void summarize(size_t chunk_idx) {
+        const uint64_t* born = chunks_created[chunk_idx].load(std::memory_order_acquire);
+        if (!born || born_ranges[chunk_idx].load(std::memory_order_acquire)) return;
+
+        auto* range = new BornRange;
+        uint64_t floor = INF_TS;
+        for (size_t s = BORN_SPANS; s-- > 0;) {
+            size_t end = std::min(CHUNK_SIZE, (s + 1) * BORN_SPAN);
+            for (size_t i = s * BORN_SPAN; i < end; ++i) {
+                if (born[i] >= DEAD_TS) continue;
+                floor = std::min(floor, born[i]);
+                range->max_ts = std::max(range->max_ts, born[i]);
+            }
+            range->suffix_min[s] = floor;
+        }
+        range->min_ts = floor;
+
+        BornRange* expected = nullptr;
+        if (!born_ranges[chunk_idx].compare_exchange_strong(expected, range, std::memory_order_acq_rel)) delete range;
+    }
+
+    // 没有范围 (块还在写) 时返回 nullptr
+    const BornRange* bornRange(size_t chunk_idx) const {
+        return born_ranges[chunk_idx].load(std::memory_order_acquire);
+    }
+
+    // 块内偏移 >= 返回值的行在 ts 时都还没提交，扫描可以停在这里；还没有范围的块返回 CHUNK_SIZE
+    size_t bornEnd(size_t chunk_idx, uint64_t ts) const {
+        const BornRange* range = bornRange(chunk_idx);
+        return range ? range->bornEnd(ts) : CHUNK_SIZE;
+    }
+
+    // 把整块摘下来 (之后这块的行全部不可见)，返回真正释放内存的函数
+    // 读者可能还拿着旧指针，释放时机由调用方 (SnapshotRegistry) 决定
+    std::function<void()> detachChunk(size_t chunk_idx) {
+        auto* c1 = chunks_created[chunk_idx].exchange(nullptr, std::memory_order_acq_rel);
+        auto* c2 = chunks_invalidated[chunk_idx].exchange(nullptr, std::memory_order_acq_rel);
+        auto* range = born_ranges[chunk_idx].exchange(nullptr, std::memory_order_acq_rel);
+        if (mapped[chunk_idx]) return [range] { delete range; }; // 映射内存随文件一起释放
+        return [c1, c2, range] { delete[] c1; delete[] c2; delete range; };
+    }
+
+    // --- 表文件 (Checkpoint) ---
+    const uint64_t* createdChunk(size_t chunk_idx) const {
+        return chunks_created[chunk_idx].load(std::memory_order_acquire);
+    }
+
+    const uint64_t* invalidatedChunk(size_t chunk_idx) const {
+        return chunks_invalidated[chunk_idx].load(std::memory_order_acquire);
+    }
+
+    // 直接使用映射进来的时间戳数组 (MAP_PRIVATE，可写)
+    void mapChunk(size_t chunk_idx, uint64_t* created, uint64_t* invalidated, uint32_t dead) {
+        std::lock_guard<std::mutex> lock(alloc_mutex);
+        if (chunks_created[chunk_idx].load(std::memory_order_relaxed)) {
+            throw std::runtime_error("Chunk already in memory, cannot map table file over it");
+        }
+        mapped[chunk_idx] = true;
+        dead_rows[chunk_idx].store(dead, std::memory_order_relaxed);
+        chunks_invalidated[chunk_idx].store(invalidated, std::memory_order_release);
+        chunks_created[chunk_idx].store(created, std::memory_order_release);
     }
-};
\ No newline at end of file
+};
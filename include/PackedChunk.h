@@ -0,0 +1,360 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <string>
+#include <string_view>
+
+// 封存块的编码方式
+enum ChunkEncoding : uint8_t {
+    ENC_PLAIN = 0, // 原样 int32 数组 (压不动时的兜底)
+    ENC_FOR   = 1, // Frame-of-Reference + 位压缩：存 (v - base)，每个值 bits 位
+    ENC_RLE   = 2, // 游程编码：values[] + run_ends[] (每段结束位置，前缀和)
+    ENC_DICT  = 3  // 字典编码：dict[] + 位压缩的下标
+};
+
+// 字典编码最多允许多少个不同值 (再多就不划算了)
+constexpr size_t PACK_MAX_DICT = 1 << 16;
+
+// 封存块：不可变，只在封存时 (或映射表文件时) 构造一次
+// 数据放在一块连续的内存里：自己持有 (storage)，或者指向 mmap 进来的表文件，原样落盘/映射
+template <typename T>
+class PackedChunk;
+
+template <>
+class PackedChunk<int> {
+private:
+    ChunkEncoding enc = ENC_PLAIN;
+    uint8_t bits = 0;          // FOR / DICT 下标的位宽
+    uint32_t count = 0;        // 行数
+    int32_t base = 0;          // FOR 的基准值
+    uint32_t num_values = 0;   // RLE 段数 / DICT 字典大小
+
+    std::vector<uint64_t> storage;      // 自己持有的数据 (映射表文件时为空)
+    const uint64_t* data_ptr = nullptr; // 数据起点：storage 或者映射区
+    size_t data_bytes = 0;
+    const uint64_t* words = nullptr;    // FOR / DICT 的位压缩区
+    const int32_t* values = nullptr;    // PLAIN 的值 / RLE 的段值 / DICT 的字典
+    const uint32_t* run_ends = nullptr; // RLE 每段结束位置
+
+    static uint8_t bitWidth(uint64_t v) {
+        uint8_t b = 0;
+        while (v) { ++b; v >>= 1; }
+        return b;
+    }
+
+    static size_t packedWords(size_t n, uint8_t b) {
+        return (n * b + 63) / 64;
+    }
+
+    // 第 i 个 b 位的无符号数
+    static uint32_t unpack(const uint64_t* w, uint8_t b, size_t i) {
+        if (b == 0) return 0;
+        size_t pos = i * b;
+        size_t idx = pos >> 6;
+        size_t shift = pos & 63;
+        uint64_t v = w[idx] >> shift;
+        if (shift + b > 64) v |= w[idx + 1] << (64 - shift);
+        return static_cast<uint32_t>(v & ((uint64_t(1) << b) - 1));
+    }
+
+    static void pack(uint64_t* w, uint8_t b, size_t i, uint64_t v) {
+        if (b == 0) return;
+        size_t pos = i * b;
+        size_t idx = pos >> 6;
+        size_t shift = pos & 63;
+        w[idx] |= v << shift;
+        if (shift + b > 64) w[idx + 1] |= v >> (64 - shift);
+    }
+
+    void bind(const uint64_t* data, size_t bytes) {
+        data_ptr = data;
+        data_bytes = bytes;
+        const char* p = reinterpret_cast<const char*>(data);
+        switch (enc) {
+            case ENC_PLAIN:
+                values = reinterpret_cast<const int32_t*>(p);
+                break;
+            case ENC_FOR:
+                words = data;
+                break;
+            case ENC_RLE:
+                values = reinterpret_cast<const int32_t*>(p);
+                run_ends = reinterpret_cast<const uint32_t*>(p + num_values * sizeof(int32_t));
+                break;
+            case ENC_DICT:
+                values = reinterpret_cast<const int32_t*>(p);
+                words = data + (num_values * sizeof(int32_t) + 7) / 8;
+                break;
+        }
+    }
+
+public:
+    // 从原始数据选出最小的编码
+    static PackedChunk<int>* encode(const int* data, size_t n) {
+        auto* pc = new PackedChunk<int>();
+        pc->count = static_cast<uint32_t>(n);
+
+        // 1. 统计：最值、游程数、不同值
+        int32_t lo = n ? data[0] : 0, hi = lo;
+        size_t runs = n ? 1 : 0;
+        std::unordered_map<int32_t, uint32_t> dict;
+        bool dict_ok = true;
+        for (size_t i = 0; i < n; ++i) {
+            lo = std::min(lo, data[i]);
+            hi = std::max(hi, data[i]);
+            if (i > 0 && data[i] != data[i - 1]) ++runs;
+            if (dict_ok) {
+                dict.emplace(data[i], 0);
+                if (dict.size() > PACK_MAX_DICT) dict_ok = false;
+            }
+        }
+
+        // 2. 估算每种编码的大小 (字节)
+        uint8_t for_bits = bitWidth(static_cast<uint64_t>(int64_t(hi) - int64_t(lo)));
+        uint8_t dict_bits = dict_ok ? bitWidth(dict.size() > 1 ? dict.size() - 1 : 0) : 0;
+        size_t plain_size = n * sizeof(int32_t);
+        size_t for_size = packedWords(n, for_bits) * 8;
+        size_t rle_size = runs * (sizeof(int32_t) + sizeof(uint32_t));
+        size_t dict_size = dict_ok ? ((dict.size() * sizeof(int32_t) + 7) / 8 + packedWords(n, dict_bits)) * 8 : SIZE_MAX;
+
+        size_t best = std::min({plain_size, for_size, rle_size, dict_size});
+
+        // 3. 编码 (一样大时优先不压缩，解码最快)
+        if (best == plain_size) {
+            pc->enc = ENC_PLAIN;
+            pc->storage.assign((n * sizeof(int32_t) + 7) / 8, 0);
+            std::memcpy(pc->storage.data(), data, n * sizeof(int32_t));
+        } else if (best == for_size) {
+            pc->enc = ENC_FOR;
+            pc->bits = for_bits;
+            pc->base = lo;
+            pc->storage.assign(packedWords(n, for_bits) + 1, 0);
+            for (size_t i = 0; i < n; ++i) {
+                pack(pc->storage.data(), for_bits, i, static_cast<uint64_t>(int64_t(data[i]) - lo));
+            }
+        } else if (best == rle_size) {
+            pc->enc = ENC_RLE;
+            pc->num_values = static_cast<uint32_t>(runs);
+            pc->storage.assign((runs * 8 + 7) / 8 + 1, 0);
+            auto* vals = reinterpret_cast<int32_t*>(pc->storage.data());
+            auto* ends = reinterpret_cast<uint32_t*>(vals + runs);
+            size_t r = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (i > 0 && data[i] != data[i - 1]) ++r;
+                vals[r] = data[i];
+                ends[r] = static_cast<uint32_t>(i + 1);
+            }
+        } else if (best == dict_size) {
+            pc->enc = ENC_DICT;
+            pc->bits = dict_bits;
+            pc->num_values = static_cast<uint32_t>(dict.size());
+            size_t dict_words = (dict.size() * sizeof(int32_t) + 7) / 8;
+            pc->storage.assign(dict_words + packedWords(n, dict_bits) + 1, 0);
+            auto* vals = reinterpret_cast<int32_t*>(pc->storage.data());
+            // 字典按值排序，下标顺序和值顺序一致
+            std::vector<int32_t> sorted;
+            sorted.reserve(dict.size());
+            for (const auto& kv : dict) sorted.push_back(kv.first);
+            std::sort(sorted.begin(), sorted.end());
+            for (size_t i = 0; i < sorted.size(); ++i) {
+                vals[i] = sorted[i];
+                dict[sorted[i]] = static_cast<uint32_t>(i);
+            }
+            uint64_t* codes = pc->storage.data() + dict_words;
+            for (size_t i = 0; i < n; ++i) pack(codes, dict_bits, i, dict[data[i]]);
+        }
+        pc->bind(pc->storage.data(), pc->storage.size() * sizeof(uint64_t));
+        return pc;
+    }
+
+    // 直接引用外部内存 (mmap 的表文件)，不拷贝；data 至少 8 字节对齐
+    static PackedChunk<int>* wrap(ChunkEncoding enc, uint8_t bits, uint32_t count, int32_t base,
+                                  uint32_t num_values, const void* data, size_t bytes) {
+        auto* pc = new PackedChunk<int>();
+        pc->enc = enc;
+        pc->bits = bits;
+        pc->count = count;
+        pc->base = base;
+        pc->num_values = num_values;
+        pc->bind(static_cast<const uint64_t*>(data), bytes);
+        return pc;
+    }
+
+    ChunkEncoding encoding() const { return enc; }
+    uint8_t bitCount() const { return bits; }
+    int32_t baseValue() const { return base; }
+    uint32_t numValues() const { return num_values; }
+    const void* data() const { return data_ptr; }
+    size_t dataBytes() const { return data_bytes; }
+    size_t size() const { return count; }
+    // 只算堆内存：映射进来的数据由 page cache 承担
+    size_t memoryBytes() const { return storage.size() * sizeof(uint64_t) + sizeof(*this); }
+
+    // 随机访问 (RLE 需要二分)
+    int get(size_t offset) const {
+        switch (enc) {
+            case ENC_FOR:
+                return static_cast<int>(int64_t(base) + unpack(words, bits, offset));
+            case ENC_RLE: {
+                auto* it = std::upper_bound(run_ends, run_ends + num_values, static_cast<uint32_t>(offset));
+                return values[it - run_ends];
+            }
+            case ENC_DICT:
+                return values[unpack(words, bits, offset)];
+            default:
+                return values[offset];
+        }
+    }
+
+    // 顺序扫描：直接在压缩数据上解码，fn(offset, value)
+    template <typename Fn>
+    void scan(Fn&& fn) const {
+        switch (enc) {
+            case ENC_FOR:
+                for (size_t i = 0; i < count; ++i) fn(i, static_cast<int>(int64_t(base) + unpack(words, bits, i)));
+                break;
+            case ENC_RLE: {
+                size_t i = 0;
+                for (size_t r = 0; r < num_values; ++r) {
+                    int v = values[r];
+                    for (; i < run_ends[r]; ++i) fn(i, v);
+                }
+                break;
+            }
+            case ENC_DICT:
+                for (size_t i = 0; i < count; ++i) fn(i, values[unpack(words, bits, i)]);
+                break;
+            default:
+                for (size_t i = 0; i < count; ++i) fn(i, values[i]);
+                break;
+        }
+    }
+
+    // 按升序偏移批量取值 (查询的选择向量)：RLE 顺着段往后走，不用每个值二分
+    void gather(const uint32_t* offs, size_t n, int* out) const {
+        switch (enc) {
+            case ENC_FOR:
+                for (size_t i = 0; i < n; ++i) out[i] = static_cast<int>(int64_t(base) + unpack(words, bits, offs[i]));
+                break;
+            case ENC_RLE: {
+                size_t r = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    while (run_ends[r] <= offs[i]) ++r;
+                    out[i] = values[r];
+                }
+                break;
+            }
+            case ENC_DICT:
+                for (size_t i = 0; i < n; ++i) out[i] = values[unpack(words, bits, offs[i])];
+                break;
+            default:
+                for (size_t i = 0; i < n; ++i) out[i] = values[offs[i]];
+                break;
+        }
+    }
+
+    // 整块求和：RLE 按段乘，FOR 先加偏移再补基准值，都不用逐个还原
+    int64_t sum() const {
+        int64_t total = 0;
+        switch (enc) {
+            case ENC_FOR:
+                for (size_t i = 0; i < count; ++i) total += unpack(words, bits, i);
+                return total + int64_t(base) * count;
+            case ENC_RLE: {
+                uint32_t prev = 0;
+                for (size_t r = 0; r < num_values; ++r) {
+                    total += int64_t(values[r]) * (run_ends[r] - prev);
+                    prev = run_ends[r];
+                }
+                return total;
+            }
+            case ENC_DICT: {
+                std::vector<uint32_t> hist(num_values, 0);
+                for (size_t i = 0; i < count; ++i) hist[unpack(words, bits, i)]++;
+                for (size_t d = 0; d < num_values; ++d) total += int64_t(values[d]) * hist[d];
+                return total;
+            }
+            default:
+                for (size_t i = 0; i < count; ++i) total += values[i];
+                return total;
+        }
+    }
+};
+
+// 字符串封存块：offsets[count + 1] (uint32) + 连续的字符数据
+template <>
+class PackedChunk<std::string> {
+private:
+    uint32_t count = 0;
+    std::vector<uint64_t> storage;
+    const uint64_t* data_ptr = nullptr;
+    size_t data_bytes = 0;
+    const uint32_t* offsets = nullptr;
+    const char* chars = nullptr;
+
+    void bind(const uint64_t* data, size_t bytes) {
+        data_ptr = data;
+        data_bytes = bytes;
+        offsets = reinterpret_cast<const uint32_t*>(data);
+        chars = reinterpret_cast<const char*>(offsets + count + 1);
+    }
+
+public:
+    static PackedChunk<std::string>* encode(const std::string* data, size_t n) {
+        auto* pc = new PackedChunk<std::string>();
+        pc->count = static_cast<uint32_t>(n);
+
+        size_t total = 0;
+        for (size_t i = 0; i < n; ++i) total += data[i].size();
+        size_t bytes = (n + 1) * sizeof(uint32_t) + total;
+        pc->storage.assign((bytes + 7) / 8, 0);
+
+        auto* offs = reinterpret_cast<uint32_t*>(pc->storage.data());
+        char* out = reinterpret_cast<char*>(offs + n + 1);
+        uint32_t pos = 0;
+        for (size_t i = 0; i < n; ++i) {
+            offs[i] = pos;
+            std::memcpy(out + pos, data[i].data(), data[i].size());
+            pos += static_cast<uint32_t>(data[i].size());
+        }
+        offs[n] = pos;
+        pc->bind(pc->storage.data(), bytes);
+        return pc;
+    }
+
+    static PackedChunk<std::string>* wrap(uint32_t count, const void* data, size_t bytes) {
+        auto* pc = new PackedChunk<std::string>();
+        pc->count = count;
+        pc->bind(static_cast<const uint64_t*>(data), bytes);
+        return pc;
+    }
+
+    ChunkEncoding encoding() const { return ENC_PLAIN; }
+    uint8_t bitCount() const { return 0; }
+    int32_t baseValue() const { return 0; }
+    uint32_t numValues() const { return 0; }
+    const void* data() const { return data_ptr; }
+    size_t dataBytes() const { return data_bytes; }
+    size_t size() const { return count; }
+    size_t memoryBytes() const { return storage.size() * sizeof(uint64_t) + sizeof(*this); }
+
+    std::string_view viewAt(size_t offset) const {
+        return std::string_view(chars + offsets[offset], offsets[offset + 1] - offsets[offset]);
+    }
+
+    std::string get(size_t offset) const {
+        return std::string(viewAt(offset));
+    }
+
+    template <typename Fn>
+    void scan(Fn&& fn) const {
+        for (size_t i = 0; i < count; ++i) fn(i, viewAt(i));
+    }
+
+    void gather(const uint32_t* offs, size_t n, std::string_view* out) const {
+        for (size_t i = 0; i < n; ++i) out[i] = viewAt(offs[i]);
+    }
+};
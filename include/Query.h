@@ -0,0 +1,863 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include "Table.h"
+#include "QueryProfile.h"
+
+// --- 查询执行：批处理算子流水线 ---
+// SELECT 编译成一条推模式的流水线：扫描 -> 过滤 (每个条件一个) -> 投影 / 聚合
+// 扫描按块进行，每次向下游推一批选择向量 (块内偏移，升序，最多 QUERY_BATCH_SIZE 行)
+// 算子按列批量取值 (Column::gatherChunk，封存块直接在压缩数据上取)，一列一列地算，每批才一次虚调用
+// 等值条件落在有索引的 STRING 列上时，扫描改走 HashIndex 的候选行
+// 聚合查询多线程按块并行扫描，各线程预聚合，最后按组键 hash 分区并行合并
+// 传入 QueryProfile 时在每两级之间插一个计数算子，记下每一级的行数和耗时 (EXPLAIN ANALYZE)
+// NULL (稀疏行没给出的列)：条件永远不成立，MIN / MAX / LAST 跳过，SUM 当 0；投影和分组里是类型的零值
+// 块里没有 NULL 时列没有空值位图，算子看一眼指针就走原来的路径
+
+// 一批的行数：一列的一批值 (4KB int / 16KB string_view) 能留在 L1/L2 里
+constexpr size_t QUERY_BATCH_SIZE = 1024;
+// 分组哈希表的初始槽数 (2 的幂)
+constexpr size_t GROUP_TABLE_INITIAL_SLOTS = 1024;
+
+enum CompareOp { CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE };
+
+enum AggFunc {
+    FN_NONE,  // 普通列
+    FN_COUNT,
+    FN_SUM,
+    FN_MIN,
+    FN_MAX,
+    FN_LAST   // 提交时间戳最新的那一行的值 (AGG_LAST 语义)
+};
+
+// WHERE 里的一个条件：列 op 常量 (多个条件之间是 AND)
+struct Predicate {
+    size_t col = 0;
+    CompareOp op = CMP_EQ;
+    int int_value = 0;       // INT 列
+    std::string str_value;   // STRING 列
+};
+
+// SELECT 列表的一项：普通列 (fn = FN_NONE)，或者聚合 (COUNT(*) 的 col = -1)
+struct SelectItem {
+    AggFunc fn = FN_NONE;
+    int col = -1;
+    std::string label;       // 结果列名
+};
+
+// 编译好的查询 (Database 负责解析和校验，执行器只管跑)
+struct SelectPlan {
+    Table* table = nullptr;
+    std::vector<SelectItem> items;
+    std::vector<Predicate> where;
+    std::vector<size_t> group_by;
+    int index_pred = -1;     // 下推到索引的条件 (where 的下标)，-1 = 全表扫描
+    uint64_t as_of = INF_TS; // FROM t AS OF ts：读这一时刻的数据，INF_TS = 读最新
+
+    bool isAggregate() const {
+        if (!group_by.empty()) return true;
+        for (const auto& item : items) {
+            if (item.fn != FN_NONE) return true;
+        }
+        return false;
+    }
+};
+
+// 一列的存储，按类型只有一个指针非空
+struct ColumnRef {
+    const Column<int>* ints = nullptr;
+    const Column<std::string>* strs = nullptr;
+
+    static ColumnRef of(const Table& table, size_t col) {
+        ColumnRef ref;
+        if (table.columnType(col) == TYPE_INT) {
+            ref.ints = dynamic_cast<const Column<int>*>(table.column(col));
+        } else {
+            ref.strs = dynamic_cast<const Column<std::string>*>(table.column(col));
+        }
+        return ref;
+    }
+
+    // 这一块的空值位图 (没有 NULL 时是 nullptr)
+    const NullBitmap* nulls(size_t chunk) const {
+        if (ints) return ints->nullBitmap(chunk);
+        return strs ? strs->nullBitmap(chunk) : nullptr;
+    }
+};
+
+// 从选择向量里去掉 NULL 行 (和过滤一样无分支地压缩)
+inline void dropNulls(std::vector<uint32_t>& sel, const NullBitmap& nulls) {
+    size_t k = 0;
+    for (size_t i = 0; i < sel.size(); ++i) {
+        sel[k] = sel[i];
+        k += !nulls.test(sel[i]);
+    }
+    sel.resize(k);
+}
+
+// 流水线里的一个算子：接收一批选择向量，处理后推给下游 (sink 自己收集结果)
+class BatchOperator {
+public:
+    virtual ~BatchOperator() = default;
+    // sel：chunk 里被选中的行 (块内偏移，升序)，算子可以就地修改
+    virtual void push(size_t chunk, std::vector<uint32_t>& sel) = 0;
+};
+
+// 一条流水线上的算子 (过滤、剖析探针)，sink 不在里面
+using OperatorChain = std::vector<std::unique_ptr<BatchOperator>>;
+
+// 过滤：取出条件列的这一批值，比较后无分支地压缩选择向量
+class FilterOperator : public BatchOperator {
+private:
+    ColumnRef ref;
+    Predicate pred;
+    BatchOperator* next;
+    std::vector<int> int_buf;
+    std::vector<std::string_view> str_buf;
+
+    template <typename V, typename Cmp>
+    static void compact(std::vector<uint32_t>& sel, const V* vals, Cmp cmp) {
+        size_t k = 0;
+        for (size_t i = 0; i < sel.size(); ++i) {
+            sel[k] = sel[i];
+            k += cmp(vals[i]);
+        }
+        sel.resize(k);
+    }
+
+    template <typename V, typename C>
+    void apply(std::vector<uint32_t>& sel, const V* vals, const C& c) {
+        switch (pred.op) {
+            case CMP_EQ: compact(sel, vals, [&](const V& v) { return v == c; }); break;
+            case CMP_NE: compact(sel, vals, [&](const V& v) { return v != c; }); break;
+            case CMP_LT: compact(sel, vals, [&](const V& v) { return v < c; }); break;
+            case CMP_LE: compact(sel, vals, [&](const V& v) { return v <= c; }); break;
+            case CMP_GT: compact(sel, vals, [&](const V& v) { return v > c; }); break;
+            case CMP_GE: compact(sel, vals, [&](const V& v) { return v >= c; }); break;
+        }
+    }
+
+public:
+    FilterOperator(ColumnRef r, Predicate p, BatchOperator* n) : ref(r), pred(std::move(p)), next(n) {}
+
+    void push(size_t chunk, std::vector<uint32_t>& sel) override {
+        // NULL 和什么比都不成立，先去掉，少取一些值
+        if (const NullBitmap* nulls = ref.nulls(chunk)) {
+            dropNulls(sel, *nulls);
+            if (sel.empty()) return;
+        }
+        if (ref.ints) {
+            int_buf.resize(sel.size());
+            ref.ints->gatherChunk(chunk, sel.data(), sel.size(), int_buf.data());
+            apply(sel, int_buf.data(), pred.int_value);
+        } else {
+            str_buf.resize(sel.size());
+            ref.strs->gatherChunk(chunk, sel.data(), sel.size(), str_buf.data());
+            apply(sel, str_buf.data(), std::string_view(pred.str_value));
+        }
+        if (!sel.empty()) next->push(chunk, sel);
+    }
+};
+
+// 投影 (sink)：把选中行的输出列追加到结果
+class ProjectOperator : public BatchOperator {
+private:
+    std::vector<ColumnRef> refs;
+    QueryResult& result;
+    std::vector<int> int_buf;
+    std::vector<std::string_view> str_buf;
+
+public:
+    ProjectOperator(const Table& table, const std::vector<SelectItem>& items, QueryResult& out) : result(out) {
+        for (const auto& item : items) {
+            refs.push_back(ColumnRef::of(table, item.col));
+            result.columns.push_back({item.label, table.columnType(item.col), {}, {}});
+        }
+    }
+
+    void push(size_t chunk, std::vector<uint32_t>& sel) override {
+        for (size_t i = 0; i < refs.size(); ++i) {
+            ResultColumn& out = result.columns[i];
+            if (refs[i].ints) {
+                int_buf.resize(sel.size());
+                refs[i].ints->gatherChunk(chunk, sel.data(), sel.size(), int_buf.data());
+                out.ints.insert(out.ints.end(), int_buf.begin(), int_buf.end());
+            } else {
+                str_buf.resize(sel.size());
+                refs[i].strs->gatherChunk(chunk, sel.data(), sel.size(), str_buf.data());
+                for (auto v : str_buf) out.strings.emplace_back(v);
+            }
+        }
+    }
+};
+
+// 分组哈希表：开放寻址 + 线性探测，槽里只放 hash 和组号，组键按组号另存
+// 比 unordered_map<string, ...> 少一次节点分配，查找也不用先拼出 std::string；hash 留着给分区合并用
+class GroupTable {
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    struct Slot {
+        uint64_t hash;
+        uint32_t gid;
+    };
+    std::vector<Slot> slots;
+    size_t mask;
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2, Slot{0, EMPTY});
+        old.swap(slots);
+        mask = slots.size() - 1;
+        for (const Slot& s : old) {
+            if (s.gid == EMPTY) continue;
+            size_t i = s.hash & mask;
+            while (slots[i].gid != EMPTY) i = (i + 1) & mask;
+            slots[i] = s;
+        }
+    }
+
+public:
+    std::vector<std::string> keys;  // 组号 -> 组键编码
+    std::vector<uint64_t> hashes;   // 组号 -> hash
+
+    GroupTable() : slots(GROUP_TABLE_INITIAL_SLOTS, Slot{0, EMPTY}), mask(GROUP_TABLE_INITIAL_SLOTS - 1) {}
+
+    static uint64_t hashKey(std::string_view key) { return std::hash<std::string_view>{}(key); }
+
+    size_t size() const { return keys.size(); }
+
+    // 返回组号；没有就新建一个组 (inserted = true)
+    uint32_t findOrInsert(std::string_view key, uint64_t hash, bool& inserted) {
+        size_t i = hash & mask;
+        while (true) {
+            const Slot& s = slots[i];
+            if (s.gid == EMPTY) break;
+            if (s.hash == hash && keys[s.gid] == key) {
+                inserted = false;
+                return s.gid;
+            }
+            i = (i + 1) & mask;
+        }
+        uint32_t gid = static_cast<uint32_t>(keys.size());
+        slots[i] = Slot{hash, gid};
+        keys.emplace_back(key);
+        hashes.push_back(hash);
+        if (keys.size() * 2 > slots.size()) grow(); // 负载因子不超过 1/2
+        inserted = true;
+        return gid;
+    }
+};
+
+// 聚合 (sink)：先给这一批每行算出组号，再按聚合项一列一列地累加
+// 没有 GROUP BY 时只有一个组 (空表也输出一行，COUNT 为 0)
+// 并行执行时每个线程一个 (预聚合)，最后按组键 hash 分区，各分区并行 merge
+class AggregateOperator : public BatchOperator {
+private:
+    // 一个聚合项在所有组上的累加器
+    struct Accumulator {
+        AggFunc fn;
+        ColumnRef ref;                  // COUNT(*) 时两个指针都是空
+        std::vector<int64_t> ints;      // COUNT / SUM / INT 的 MIN MAX LAST
+        std::vector<std::string> strs;  // STRING 的 MIN MAX LAST
+        std::vector<char> has;          // MIN / MAX / LAST：这个组见过值没有
+        std::vector<uint64_t> ts;       // LAST：当前取值那一行的提交时间戳
+        std::vector<size_t> rows;       // LAST：当前取值那一行的行号 (时间戳相同时行号大的算新)
+    };
+
+    const Table& table;
+    std::vector<SelectItem> items;
+    std::vector<size_t> group_by;
+    std::vector<ColumnRef> group_refs;
+    std::vector<Accumulator> accs;      // 和 items 一一对应 (普通列的项不用)
+    bool needs_ts = false;
+
+    GroupTable groups;
+    std::vector<ResultColumn> group_vals; // 每个组的 GROUP BY 列取值
+
+    // 这一批的临时数据
+    std::vector<uint32_t> gids;
+    std::vector<std::vector<int>> group_ints;
+    std::vector<std::vector<std::string_view>> group_strs;
+    std::vector<int> int_buf;
+    std::vector<std::string_view> str_buf;
+    std::vector<uint64_t> ts_buf;
+    std::string key;
+
+    void addGroup() {
+        for (auto& acc : accs) {
+            acc.ints.push_back(0);
+            if (acc.ref.strs) acc.strs.emplace_back();
+            acc.has.push_back(0);
+            if (acc.fn == FN_LAST) {
+                acc.ts.push_back(0);
+                acc.rows.push_back(0);
+            }
+        }
+    }
+
+    // 这一批每行的组号
+    void assignGroups(size_t chunk, const std::vector<uint32_t>& sel) {
+        size_t n = sel.size();
+        gids.assign(n, 0);
+        if (group_by.empty()) return;
+
+        for (size_t g = 0; g < group_by.size(); ++g) {
+            if (group_refs[g].ints) {
+                group_ints[g].resize(n);
+                group_refs[g].ints->gatherChunk(chunk, sel.data(), n, group_ints[g].data());
+            } else {
+                group_strs[g].resize(n);
+                group_refs[g].strs->gatherChunk(chunk, sel.data(), n, group_strs[g].data());
+            }
+        }
+
+        bool single = group_by.size() == 1;
+        for (size_t r = 0; r < n; ++r) {
+            // 组键：只有一列时直接用值的字节；多列时 int 4 字节，string 长度 + 字节 (key 复用，不分配内存)
+            std::string_view k;
+            if (single) {
+                k = group_refs[0].ints ? std::string_view(reinterpret_cast<const char*>(&group_ints[0][r]), sizeof(int))
+                                       : group_strs[0][r];
+            } else {
+                key.clear();
+                for (size_t g = 0; g < group_by.size(); ++g) {
+                    if (group_refs[g].ints) {
+                        key.append(reinterpret_cast<const char*>(&group_ints[g][r]), sizeof(int));
+                    } else {
+                        uint32_t len = static_cast<uint32_t>(group_strs[g][r].size());
+                        key.append(reinterpret_cast<const char*>(&len), sizeof(len));
+                        key.append(group_strs[g][r]);
+                    }
+                }
+                k = key;
+            }
+            bool inserted;
+            uint32_t gid = groups.findOrInsert(k, GroupTable::hashKey(k), inserted);
+            if (inserted) {
+                for (size_t g = 0; g < group_by.size(); ++g) {
+                    if (group_refs[g].ints) group_vals[g].ints.push_back(group_ints[g][r]);
+                    else group_vals[g].strings.emplace_back(group_strs[g][r]);
+                }
+                addGroup();
+            }
+            gids[r] = gid;
+        }
+    }
+
+    // v 能不能替换组 g 当前的值 (MIN / MAX 比大小，LAST 比 (提交时间戳, 行号)，和 HashIndex::newer 一致)
+    template <typename V, typename Cur>
+    static bool better(const Accumulator& acc, uint32_t g, const V& v, const Cur& cur, uint64_t ts, size_t row) {
+        if (!acc.has[g]) return true;
+        switch (acc.fn) {
+            case FN_MIN: return v < cur;
+            case FN_MAX: return v > cur;
+            default: return ts > acc.ts[g] || (ts == acc.ts[g] && row > acc.rows[g]);
+        }
+    }
+
+    static void setLast(Accumulator& acc, uint32_t g, uint64_t ts, size_t row) {
+        if (acc.fn != FN_LAST) return;
+        acc.ts[g] = ts;
+        acc.rows[g] = row;
+    }
+
+    void accumulate(Accumulator& acc, size_t chunk, const std::vector<uint32_t>& sel) {
+        size_t n = sel.size();
+        // COUNT(col) / MIN / MAX / LAST 跳过 NULL；SUM 不用管 (NULL 槽是 0)
+        // COUNT(*) 没有列 (nulls 为空)，每行都算
+        const NullBitmap* nulls = acc.ref.nulls(chunk);
+        if (acc.fn == FN_COUNT) {
+            for (size_t r = 0; r < n; ++r) {
+                if (nulls && nulls->test(sel[r])) continue;
+                acc.ints[gids[r]]++;
+            }
+            return;
+        }
+
+        if (acc.ref.ints) {
+            int_buf.resize(n);
+            acc.ref.ints->gatherChunk(chunk, sel.data(), n, int_buf.data());
+            if (acc.fn == FN_SUM) {
+                for (size_t r = 0; r < n; ++r) acc.ints[gids[r]] += int_buf[r];
+                return;
+            }
+            for (size_t r = 0; r < n; ++r) {
+                if (nulls && nulls->test(sel[r])) continue;
+                uint32_t g = gids[r];
+                uint64_t ts = needs_ts ? ts_buf[r] : 0;
+                size_t row = chunk * CHUNK_SIZE + sel[r];
+                if (better(acc, g, int64_t(int_buf[r]), acc.ints[g], ts, row)) {
+                    acc.ints[g] = int_buf[r];
+                    acc.has[g] = 1;
+                    setLast(acc, g, ts, row);
+                }
+            }
+            return;
+        }
+
+        str_buf.resize(n);
+        acc.ref.strs->gatherChunk(chunk, sel.data(), n, str_buf.data());
+        for (size_t r = 0; r < n; ++r) {
+            if (nulls && nulls->test(sel[r])) continue;
+            uint32_t g = gids[r];
+            uint64_t ts = needs_ts ? ts_buf[r] : 0;
+            size_t row = chunk * CHUNK_SIZE + sel[r];
+            if (better(acc, g, str_buf[r], std::string_view(acc.strs[g]), ts, row)) {
+                acc.strs[g].assign(str_buf[r]);
+                acc.has[g] = 1;
+                setLast(acc, g, ts, row);
+            }
+        }
+    }
+
+public:
+    AggregateOperator(const Table& t, const SelectPlan& plan)
+        : table(t), items(plan.items), group_by(plan.group_by) {
+        for (size_t col : group_by) {
+            group_refs.push_back(ColumnRef::of(table, col));
+            group_vals.push_back({table.columnName(col), table.columnType(col), {}, {}});
+        }
+        group_ints.resize(group_by.size());
+        group_strs.resize(group_by.size());
+
+        for (const auto& item : items) {
+            Accumulator acc{item.fn, {}, {}, {}, {}, {}, {}};
+            if (item.fn != FN_NONE && item.col >= 0) acc.ref = ColumnRef::of(table, item.col);
+            if (item.fn == FN_LAST) needs_ts = true;
+            accs.push_back(std::move(acc));
+        }
+        if (group_by.empty()) {
+            bool inserted;
+            groups.findOrInsert({}, GroupTable::hashKey({}), inserted);
+            addGroup();
+        }
+    }
+
+    size_t groupCount() const { return groups.size(); }
+    uint64_t groupHash(uint32_t gid) const { return groups.hashes[gid]; }
+
+    void push(size_t chunk, std::vector<uint32_t>& sel) override {
+        assignGroups(chunk, sel);
+        if (needs_ts) {
+            ts_buf.resize(sel.size());
+            table.createdTimestamps(chunk, sel.data(), sel.size(), ts_buf.data());
+        }
+        for (auto& acc : accs) {
+            if (acc.fn != FN_NONE) accumulate(acc, chunk, sel);
+        }
+    }
+
+    // 把 src 的组 src_gid 并进来 (两边的 plan 相同)
+    void mergeGroup(AggregateOperator& src, uint32_t src_gid) {
+        bool inserted;
+        uint32_t g = groups.findOrInsert(src.groups.keys[src_gid], src.groups.hashes[src_gid], inserted);
+        if (inserted) {
+            for (size_t k = 0; k < group_by.size(); ++k) {
+                if (group_refs[k].ints) group_vals[k].ints.push_back(src.group_vals[k].ints[src_gid]);
+                else group_vals[k].strings.push_back(std::move(src.group_vals[k].strings[src_gid]));
+            }
+            addGroup();
+        }
+
+        for (size_t i = 0; i < accs.size(); ++i) {
+            Accumulator& acc = accs[i];
+            Accumulator& from = src.accs[i];
+            if (acc.fn == FN_NONE) continue;
+            if (acc.fn == FN_COUNT || acc.fn == FN_SUM) {
+                acc.ints[g] += from.ints[src_gid];
+                continue;
+            }
+            if (!from.has[src_gid]) continue;
+            uint64_t ts = acc.fn == FN_LAST ? from.ts[src_gid] : 0;
+            size_t row = acc.fn == FN_LAST ? from.rows[src_gid] : 0;
+            bool take = acc.ref.ints ? better(acc, g, from.ints[src_gid], acc.ints[g], ts, row)
+                                     : better(acc, g, from.strs[src_gid], acc.strs[g], ts, row);
+            if (!take) continue;
+            if (acc.ref.ints) acc.ints[g] = from.ints[src_gid];
+            else acc.strs[g] = std::move(from.strs[src_gid]);
+            acc.has[g] = 1;
+            setLast(acc, g, ts, row);
+        }
+    }
+
+    // 按 SELECT 列表的顺序，每个组一行追加到 result (result 为空时先建列)
+    void finish(QueryResult& result) {
+        bool first = result.columns.empty();
+        for (size_t i = 0; i < items.size(); ++i) {
+            const SelectItem& item = items[i];
+            Accumulator& acc = accs[i];
+            ResultColumn col;
+            if (item.fn == FN_NONE) {
+                size_t g = std::find(group_by.begin(), group_by.end(), static_cast<size_t>(item.col)) - group_by.begin();
+                col = std::move(group_vals[g]);
+            } else if (acc.ref.strs && item.fn != FN_COUNT) {
+                col = {"", TYPE_STRING, {}, std::move(acc.strs)};
+            } else {
+                col = {"", TYPE_INT, std::move(acc.ints), {}};
+            }
+            col.name = item.label;
+
+            if (first) {
+                result.columns.push_back(std::move(col));
+                continue;
+            }
+            ResultColumn& out = result.columns[i];
+            out.ints.insert(out.ints.end(), col.ints.begin(), col.ints.end());
+            out.strings.insert(out.strings.end(), std::make_move_iterator(col.strings.begin()),
+                               std::make_move_iterator(col.strings.end()));
+        }
+    }
+};
+
+// 混合语义的全表汇总：按 key_col 分组，AGG_SUM 列求和，AGG_LAST 列取最新版本
+// (和 querySnapshot 对单个 key 的结果一致，一次扫描算出所有 key)
+inline SelectPlan makeRollupPlan(Table& table, const std::string& key_col) {
+    int key = table.columnIndex(key_col);
+    if (key < 0) throw std::runtime_error("rollup: column '" + key_col + "' not found");
+
+    SelectPlan plan;
+    plan.table = &table;
+    plan.group_by.push_back(static_cast<size_t>(key));
+    for (size_t c = 0; c < table.columnCount(); ++c) {
+        if (static_cast<int>(c) == key) {
+            plan.items.push_back({FN_NONE, key, key_col});
+        } else {
+            AggFunc fn = table.columnAgg(c) == AGG_SUM && table.columnType(c) == TYPE_INT ? FN_SUM : FN_LAST;
+            plan.items.push_back({fn, static_cast<int>(c), table.columnName(c)});
+        }
+    }
+    return plan;
+}
+
+// --- 剖析计数 (EXPLAIN ANALYZE) ---
+// 扫描：每个线程一份，最后相加
+struct ScanStats {
+    uint64_t chunks = 0;     // 扫过的块
+    uint64_t examined = 0;   // 判过可见性的行 (全表扫描是块里所有行，索引扫描是候选行)
+    uint64_t pruned = 0;     // 按提交时间戳范围整块跳过的块 (历史快照)
+    uint64_t visible = 0;    // 对快照可见、推给下游的行
+    uint64_t ns = 0;         // 扫描加上整条下游的耗时
+};
+
+// 流水线的一级：进入这一级的行数，这一级加上它下游的耗时
+struct StageStats {
+    uint64_t rows = 0;
+    uint64_t ns = 0;
+};
+
+// 插在两级之间：数进入下一级的行数，给下一级 (含它的下游) 计时
+class ProfileOperator : public BatchOperator {
+private:
+    BatchOperator* next;
+    StageStats& stats;
+
+public:
+    ProfileOperator(BatchOperator* n, StageStats& s) : next(n), stats(s) {}
+
+    void push(size_t chunk, std::vector<uint32_t>& sel) override {
+        stats.rows += sel.size();
+        uint64_t t0 = profileClock();
+        next->push(chunk, sel);
+        stats.ns += profileClock() - t0;
+    }
+};
+
+// 一条流水线 (扫描 -> 过滤 ... -> sink) 的全部计数；stages 是每个过滤一级，最后一级是 sink
+struct PipelineStats {
+    ScanStats scan;
+    std::vector<StageStats> stages;
+
+    void merge(const PipelineStats& o) {
+        scan.chunks += o.scan.chunks;
+        scan.examined += o.scan.examined;
+        scan.pruned += o.scan.pruned;
+        scan.visible += o.scan.visible;
+        scan.ns += o.scan.ns;
+        if (stages.size() < o.stages.size()) stages.resize(o.stages.size());
+        for (size_t i = 0; i < o.stages.size(); ++i) {
+            stages[i].rows += o.stages[i].rows;
+            stages[i].ns += o.stages[i].ns;
+        }
+    }
+};
+
+inline const char* compareOpText(CompareOp op) {
+    switch (op) {
+        case CMP_EQ: return "=";
+        case CMP_NE: return "!=";
+        case CMP_LT: return "<";
+        case CMP_LE: return "<=";
+        case CMP_GT: return ">";
+        default: return ">=";
+    }
+}
+
+inline std::string predicateText(const Table& table, const Predicate& pred) {
+    std::string v = table.columnType(pred.col) == TYPE_INT ? std::to_string(pred.int_value) : "'" + pred.str_value + "'";
+    return table.columnName(pred.col) + " " + compareOpText(pred.op) + " " + v;
+}
+
+// 流水线的剖析树：sink 在上，过滤依次往下，扫描在最底下
+// stats 为空时只有标签 (EXPLAIN)；sink_rows 是 sink 的输出行数 (投影 = 输入行数，聚合 = 组数)
+inline ProfileNode pipelineProfile(const Table& table, const SelectPlan& plan, const std::string& sink_label,
+                                   const PipelineStats* stats, uint64_t sink_rows) {
+    size_t nf = plan.where.size();
+    std::vector<ProfileNode> levels; // levels[0] = sink，levels[1..nf] = 过滤 (从下游往上游)，最后是扫描
+    levels.emplace_back(sink_label);
+    for (size_t i = nf; i-- > 0;) levels.emplace_back("Filter: " + predicateText(table, plan.where[i]));
+    std::string as_of = plan.as_of == INF_TS ? "" : " AS OF " + std::to_string(plan.as_of);
+    if (plan.index_pred >= 0) {
+        levels.emplace_back("Index Scan on " + table.name() + as_of + " using " + predicateText(table, plan.where[plan.index_pred]));
+    } else {
+        levels.emplace_back("Seq Scan on " + table.name() + as_of);
+    }
+
+    if (stats) {
+        // sink
+        const StageStats& sink = stats->stages[nf];
+        levels[0].rows = sink_rows;
+        levels[0].time_ns = sink.ns;
+        levels[0].count("rows_in", sink.rows);
+        // 过滤 i：输入是 stages[i]，输出是 stages[i + 1]
+        for (size_t i = 0; i < nf; ++i) {
+            ProfileNode& f = levels[nf - i];
+            f.rows = stats->stages[i + 1].rows;
+            f.time_ns = stats->stages[i].ns - stats->stages[i + 1].ns;
+            f.count("removed", stats->stages[i].rows - stats->stages[i + 1].rows);
+        }
+        ProfileNode& scan = levels.back();
+        scan.rows = stats->scan.visible;
+        scan.time_ns = stats->scan.ns - stats->stages[0].ns;
+        scan.count("chunks", stats->scan.chunks);
+        scan.count("examined", stats->scan.examined);
+        scan.count("invisible", stats->scan.examined - stats->scan.visible);
+        if (plan.as_of != INF_TS) scan.count("chunks_pruned", stats->scan.pruned);
+    }
+
+    // 由下往上挂成一条链
+    ProfileNode node = std::move(levels.back());
+    for (size_t i = levels.size() - 1; i-- > 0;) {
+        levels[i].children.push_back(std::move(node));
+        node = std::move(levels[i]);
+    }
+    return node;
+}
+
+inline std::string selectItemsText(const std::vector<SelectItem>& items) {
+    std::string out;
+    for (const auto& item : items) {
+        if (!out.empty()) out += ", ";
+        out += item.label;
+    }
+    return out;
+}
+
+inline std::string sinkLabel(const Table& table, const SelectPlan& plan) {
+    if (!plan.isAggregate()) return "Project: " + selectItemsText(plan.items);
+    std::string label = "Aggregate: " + selectItemsText(plan.items);
+    if (!plan.group_by.empty()) {
+        label += " GROUP BY ";
+        for (size_t i = 0; i < plan.group_by.size(); ++i) label += (i ? ", " : "") + table.columnName(plan.group_by[i]);
+    }
+    return label;
+}
+
+class QueryExecutor {
+public:
+    // 在快照 snap 上执行 plan (plan 已经校验过)
+    // 聚合查询按块并行扫描：每个线程自己的过滤算子 + 预聚合表，最后分区合并
+    // threads = 0：用 hardware_concurrency 个线程 (不超过块数)
+    // profile 非空时记录每一级的行数和耗时 (EXPLAIN ANALYZE)
+    static QueryResult run(const SelectPlan& plan, const Snapshot& snap, size_t threads = 0, QueryProfile* profile = nullptr) {
+        Table& table = *plan.table;
+        uint64_t ts = snap.timestamp();
+        uint64_t start = profile ? profileClock() : 0;
+
+        return table.readConsistent([&] {
+            QueryResult result;
+            if (!plan.isAggregate()) {
+                PipelineStats stats;
+                PipelineStats* st = profile ? &stats : nullptr;
+                ProjectOperator project(table, plan.items, result);
+                OperatorChain ops;
+                BatchOperator* head = buildFilters(table, plan, &project, ops, st);
+                if (plan.index_pred >= 0) {
+                    scanIndex(table, plan.where[plan.index_pred], ts, *head, st);
+                } else {
+                    std::atomic<size_t> next_chunk{0};
+                    scanTable(table, ts, *head, next_chunk, st);
+                }
+                if (profile) finishProfile(*profile, pipelineProfile(table, plan, sinkLabel(table, plan), st, result.rowCount()), 1, start);
+                return result;
+            }
+
+            // 1. 各线程预聚合
+            size_t workers = 1;
+            if (plan.index_pred < 0) {
+                if (threads == 0) threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+                workers = std::max<size_t>(1, std::min(threads, table.chunkCount()));
+            }
+            std::vector<std::unique_ptr<AggregateOperator>> locals;
+            for (size_t w = 0; w < workers; ++w) locals.push_back(std::make_unique<AggregateOperator>(table, plan));
+            std::vector<PipelineStats> stats(profile ? workers : 0);
+
+            std::atomic<size_t> next_chunk{0};
+            parallelFor(workers, [&](size_t w) {
+                PipelineStats* st = profile ? &stats[w] : nullptr;
+                OperatorChain ops;
+                BatchOperator* head = buildFilters(table, plan, locals[w].get(), ops, st);
+                if (plan.index_pred >= 0) scanIndex(table, plan.where[plan.index_pred], ts, *head, st);
+                else scanTable(table, ts, *head, next_chunk, st);
+            });
+
+            // 剖析树：聚合一级的输出行数是各线程的局部组数之和，合并一级另算
+            PipelineStats total;
+            uint64_t local_groups = 0;
+            if (profile) {
+                for (const auto& st : stats) total.merge(st);
+                for (const auto& local : locals) local_groups += local->groupCount();
+            }
+            if (workers == 1) {
+                locals[0]->finish(result);
+                if (profile) finishProfile(*profile, pipelineProfile(table, plan, sinkLabel(table, plan), &total, local_groups), 1, start);
+                return result;
+            }
+            uint64_t merge_start = profile ? profileClock() : 0;
+
+            // 2. 分区合并：组按 hash 分成 workers 个分区，每个分区一个线程，互不相交
+            //    没有 GROUP BY 时只有一个组，合并成一个
+            size_t parts = plan.group_by.empty() ? 1 : workers;
+            std::vector<std::unique_ptr<AggregateOperator>> merged(parts);
+            parallelFor(parts, [&](size_t p) {
+                merged[p] = std::make_unique<AggregateOperator>(table, plan);
+                for (auto& local : locals) {
+                    for (uint32_t g = 0; g < local->groupCount(); ++g) {
+                        if ((local->groupHash(g) >> 32) % parts == p) merged[p]->mergeGroup(*local, g);
+                    }
+                }
+            });
+            for (auto& m : merged) m->finish(result);
+
+            if (profile) {
+                ProfileNode node("Merge: " + std::to_string(parts) + (parts == 1 ? " partition" : " partitions"));
+                node.rows = result.rowCount();
+                node.time_ns = profileClock() - merge_start;
+                node.children.push_back(pipelineProfile(table, plan, sinkLabel(table, plan), &total, local_groups));
+                finishProfile(*profile, std::move(node), workers, start);
+            }
+            return result;
+        });
+    }
+
+    // 只出计划 (EXPLAIN)：不执行
+    static QueryProfile explain(const SelectPlan& plan) {
+        QueryProfile profile;
+        profile.root = pipelineProfile(*plan.table, plan, sinkLabel(*plan.table, plan), nullptr, 0);
+        return profile;
+    }
+
+    static void finishProfile(QueryProfile& profile, ProfileNode root, size_t threads, uint64_t start) {
+        profile.analyzed = true;
+        profile.root = std::move(root);
+        profile.threads = threads;
+        profile.total_ns = profileClock() - start;
+    }
+
+    // --- 扫描积木 (HashJoin.h 也用) ---
+    // fn(i)，i = 0..n-1 各一个线程 (0 号在当前线程跑)
+    template <typename Fn>
+    static void parallelFor(size_t n, Fn&& fn) {
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < n; ++i) threads.emplace_back(fn, i);
+        fn(0);
+        for (auto& th : threads) th.join();
+    }
+
+    // 由下往上搭过滤算子 (每个条件一个)，返回流水线的入口；算子归 ops 所有
+    // stats 非空时每一级前面插一个 ProfileOperator
+    static BatchOperator* buildFilters(const Table& table, const SelectPlan& plan, BatchOperator* sink,
+                                       OperatorChain& ops, PipelineStats* stats = nullptr) {
+        BatchOperator* head = sink;
+        if (stats) stats->stages.resize(plan.where.size() + 1);
+        auto probe = [&](size_t stage) {
+            if (!stats) return;
+            ops.push_back(std::make_unique<ProfileOperator>(head, stats->stages[stage]));
+            head = ops.back().get();
+        };
+        probe(plan.where.size());
+        for (size_t i = plan.where.size(); i-- > 0;) {
+            const Predicate& pred = plan.where[i];
+            ops.push_back(std::make_unique<FilterOperator>(ColumnRef::of(table, pred.col), pred, head));
+            head = ops.back().get();
+            probe(i);
+        }
+        return head;
+    }
+
+    // 全表：从 next_chunk 领块 (多个线程共用一个计数器)，每块按 QUERY_BATCH_SIZE 切片
+    // MVCC 可见性直接在时间戳数组上批量判断；历史快照按块的提交时间戳范围跳过整块或块尾
+    static void scanTable(const Table& table, uint64_t ts, BatchOperator& head, std::atomic<size_t>& next_chunk,
+                          PipelineStats* stats = nullptr) {
+        uint64_t t0 = stats ? profileClock() : 0;
+        std::vector<uint32_t> sel;
+        sel.reserve(QUERY_BATCH_SIZE);
+        size_t num_chunks = table.chunkCount();
+        for (size_t c = next_chunk++; c < num_chunks; c = next_chunk++) {
+            if (!table.hasChunk(c)) continue;
+            size_t end = table.scanEnd(c, ts);
+            if (end == 0) {
+                if (stats) stats->scan.pruned++;
+                continue;
+            }
+            for (size_t begin = 0; begin < end; begin += QUERY_BATCH_SIZE) {
+                sel.clear();
+                table.visibleOffsets(c, begin, std::min(end, begin + QUERY_BATCH_SIZE), ts, sel);
+                if (stats) stats->scan.visible += sel.size();
+                if (!sel.empty()) head.push(c, sel);
+            }
+            if (stats) {
+                // 块尾还没租出去的槽位不算 (扫是扫了，但那里没有行)
+                stats->scan.chunks++;
+                stats->scan.examined += std::min(end, table.rowLimit() - std::min(table.rowLimit(), c * CHUNK_SIZE));
+            }
+        }
+        if (stats) stats->scan.ns += profileClock() - t0;
+    }
+
+    // 索引：候选行排序后按块分批，只对候选行判可见性
+    // 等值条件本身仍然留在过滤算子里再核对一遍
+    static void scanIndex(Table& table, const Predicate& pred, uint64_t ts, BatchOperator& head,
+                          PipelineStats* stats = nullptr) {
+        uint64_t t0 = stats ? profileClock() : 0;
+        std::vector<size_t> rows = table.indexLookup(table.columnName(pred.col), pred.str_value);
+        std::sort(rows.begin(), rows.end());
+
+        std::vector<uint32_t> sel;
+        size_t i = 0, last_chunk = SIZE_MAX;
+        while (i < rows.size()) {
+            size_t chunk = rows[i] / CHUNK_SIZE;
+            sel.clear();
+            for (; i < rows.size() && rows[i] / CHUNK_SIZE == chunk && sel.size() < QUERY_BATCH_SIZE; ++i) {
+                if (table.isVisible(rows[i], ts)) sel.push_back(static_cast<uint32_t>(rows[i] % CHUNK_SIZE));
+            }
+            if (stats) {
+                stats->scan.visible += sel.size();
+                if (chunk != last_chunk) stats->scan.chunks++;
+                last_chunk = chunk;
+            }
+            if (!sel.empty()) head.push(chunk, sel);
+        }
+        if (stats) {
+            stats->scan.examined += rows.size();
+            stats->scan.ns += profileClock() - t0;
+        }
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// --- 查询剖析 (EXPLAIN / EXPLAIN ANALYZE) ---
+// 按需开启：执行函数多接一个 QueryProfile*，为空时既不计时也不计数
+// 结果是一棵树：根是最后一级 (投影 / 聚合 / 连接)，子节点是它的输入，一直到扫描
+// 节点上的时间是独占时间 (不含子节点)；多线程执行时是各线程之和 (CPU 时间)，墙钟时间只在整棵树上报告
+
+struct ProfileNode {
+    std::string label;
+    uint64_t rows = 0;                                       // 这一级输出的行数
+    uint64_t time_ns = 0;                                    // 独占时间
+    std::vector<std::pair<std::string, uint64_t>> counters;  // 其他计数 (候选行、不可见行、分组数 ...)
+    std::vector<ProfileNode> children;
+
+    ProfileNode() = default;
+    explicit ProfileNode(std::string l) : label(std::move(l)) {}
+
+    void count(const std::string& name, uint64_t v) { counters.emplace_back(name, v); }
+};
+
+struct QueryProfile {
+    bool analyzed = false;   // false：只有计划 (EXPLAIN)，没有执行，树上没有数字
+    ProfileNode root;
+    uint64_t total_ns = 0;   // 执行的墙钟时间
+    size_t threads = 1;
+
+    // 缩进的树，每个节点一行：label  (rows=... time=... 其他计数)
+    std::string text() const {
+        std::string out;
+        appendNode(out, root, 0);
+        if (analyzed) {
+            out += "Threads: " + std::to_string(threads) + "\n";
+            out += "Execution Time: " + formatMs(total_ns) + "\n";
+        }
+        return out;
+    }
+
+    static std::string formatMs(uint64_t ns) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.3f ms", ns / 1e6);
+        return buf;
+    }
+
+private:
+    void appendNode(std::string& out, const ProfileNode& node, size_t depth) const {
+        if (depth > 0) out += std::string(depth * 4 - 4, ' ') + "  -> ";
+        out += node.label;
+        if (analyzed) {
+            out += "  (rows=" + std::to_string(node.rows) + " time=" + formatMs(node.time_ns);
+            for (const auto& c : node.counters) out += " " + c.first + "=" + std::to_string(c.second);
+            out += ")";
+        }
+        out += '\n';
+        for (const auto& child : node.children) appendNode(out, child, depth + 1);
+    }
+};
+
+inline uint64_t profileClock() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
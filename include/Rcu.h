@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --- 读者登记 (epoch 回收，给 RCU 式的只读结构用) ---
+// 每个线程一个读者槽 (按缓存行对齐)：进读临界区时记下全局 epoch，出来清零，只写本线程的槽
+// 写者换掉一个版本以后把全局 epoch 加一，记下加之前的值 e：
+//   所有槽都是 0 或者 > e 时，已经没有读者拿着旧版本，可以释放
+// 全进程一份，线程退出后槽留给下一个线程用 (和 Metrics 的分片一样)
+// 也用来等宽限期：Table 的写入在读临界区里读索引指针，在线建索引挂上新索引后 synchronize()，
+// 之后还没看到新索引的写入就都做完了
+
+struct alignas(64) RcuReaderSlot {
+    std::atomic<uint64_t> epoch{0}; // 0 = 不在读临界区
+    uint32_t depth = 0;             // 嵌套层数，只有所属线程碰
+};
+
+class RcuDomain {
+private:
+    std::atomic<uint64_t> global_epoch{1};
+    std::mutex mtx;
+    std::vector<std::unique_ptr<RcuReaderSlot>> slots;  // 只增不减
+    std::vector<RcuReaderSlot*> free_slots;
+
+    static RcuDomain& instance() {
+        static RcuDomain d;
+        return d;
+    }
+
+    RcuReaderSlot* acquire() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!free_slots.empty()) {
+            RcuReaderSlot* s = free_slots.back();
+            free_slots.pop_back();
+            return s;
+        }
+        slots.push_back(std::make_unique<RcuReaderSlot>());
+        return slots.back().get();
+    }
+
+    void release(RcuReaderSlot* s) {
+        std::lock_guard<std::mutex> lock(mtx);
+        free_slots.push_back(s);
+    }
+
+    struct LocalHandle {
+        RcuDomain& owner;
+        RcuReaderSlot* slot;
+        LocalHandle() : owner(instance()), slot(owner.acquire()) {}
+        ~LocalHandle() { owner.release(slot); }
+    };
+
+    static RcuReaderSlot& local() {
+        thread_local LocalHandle handle;
+        return *handle.slot;
+    }
+
+public:
+    static void readLock() {
+        RcuReaderSlot& s = local();
+        if (s.depth++ > 0) return;
+        // acquire：读到写者加过的 epoch，就一定能看到它换上去的新版本
+        s.epoch.store(instance().global_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+        // 槽的写入要在读版本指针之前被写者看到 (和 advance 之后的扫描配对)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    static void readUnlock() {
+        RcuReaderSlot& s = local();
+        if (--s.depth == 0) s.epoch.store(0, std::memory_order_release);
+    }
+
+    // 写者换完版本指针后调用，返回旧版本的 epoch
+    static uint64_t advance() {
+        return instance().global_epoch.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // 等宽限期：调用之前进了读临界区的读者全部离开 (换完指针之后调用)
+    static void synchronize() {
+        uint64_t e = advance();
+        while (!quiescent(e)) std::this_thread::yield();
+    }
+
+    // 在 epoch <= e 时进来的读者是不是都走了
+    static bool quiescent(uint64_t e) {
+        RcuDomain& d = instance();
+        std::lock_guard<std::mutex> lock(d.mtx);
+        for (const auto& s : d.slots) {
+            uint64_t v = s->epoch.load(std::memory_order_acquire);
+            if (v != 0 && v <= e) return false;
+        }
+        return true;
+    }
+};
+
+class RcuReadGuard {
+public:
+    RcuReadGuard() { RcuDomain::readLock(); }
+    ~RcuReadGuard() { RcuDomain::readUnlock(); }
+    RcuReadGuard(const RcuReadGuard&) = delete;
+    RcuReadGuard& operator=(const RcuReadGuard&) = delete;
+};
@@ -0,0 +1,418 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <ostream>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "Query.h"
+
+// --- 流式结果：游标 + 缓冲序列化 ---
+// 游标每次 next() 交出一批按列存的结果 (几千行)，批对象由调用方复用，结果再大内存也是常数
+// 1. 普通 SELECT：游标自己持有快照，按 (块, 块内位置) 记住扫到哪里，每批在 readConsistent 里接着扫
+// 2. 聚合 / JOIN：结果本身要等全部输入读完才有，执行完以后按批切给调用方
+// 序列化器把批写进自己的缓冲区，攒满 RESULT_WRITE_BUFFER 才往 ostream 写一次，不按值走 iostream
+
+// 一批的目标行数 (扫描按 QUERY_BATCH_SIZE 切片推进，一批最多多出一个切片)
+constexpr size_t CURSOR_BATCH_ROWS = 4 * QUERY_BATCH_SIZE;
+// 序列化缓冲区攒到这么大就写出去
+constexpr size_t RESULT_WRITE_BUFFER = 64 * 1024;
+// 二进制结果流的开头
+constexpr char RESULT_STREAM_MAGIC[4] = {'H', 'V', 'R', 'S'};
+
+struct ResultColumnInfo {
+    std::string name;
+    ColumnType type = TYPE_INT;
+};
+
+// 一批里的一列：INT 统一放 int64，STRING 首尾相接放在 chars 里，第 i 个值是 [offsets[i], offsets[i + 1])
+struct BatchColumn {
+    ColumnType type = TYPE_INT;
+    std::vector<int64_t> ints;
+    std::vector<uint32_t> offsets{0};
+    std::string chars;
+
+    size_t size() const { return type == TYPE_INT ? ints.size() : offsets.size() - 1; }
+
+    std::string_view str(size_t i) const {
+        return std::string_view(chars.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    void append(std::string_view v) {
+        chars.append(v.data(), v.size());
+        offsets.push_back(static_cast<uint32_t>(chars.size()));
+    }
+
+    // 清空但留着容量，下一批接着用
+    void clear() {
+        ints.clear();
+        offsets.resize(1);
+        chars.clear();
+    }
+};
+
+struct ResultBatch {
+    std::vector<BatchColumn> columns;
+
+    size_t rowCount() const { return columns.empty() ? 0 : columns[0].size(); }
+
+    void reset(const std::vector<ResultColumnInfo>& schema) {
+        columns.resize(schema.size());
+        for (size_t i = 0; i < schema.size(); ++i) {
+            columns[i].type = schema[i].type;
+            columns[i].clear();
+        }
+    }
+};
+
+class ResultCursor {
+public:
+    virtual ~ResultCursor() = default;
+
+    const std::vector<ResultColumnInfo>& columns() const { return schema; }
+
+    // 取下一批到 batch (覆盖原来的内容)；没有更多结果时返回 false
+    virtual bool next(ResultBatch& batch) = 0;
+
+protected:
+    std::vector<ResultColumnInfo> schema;
+};
+
+// 投影 (sink)：把选中行的输出列追加到当前批
+class BatchAppendOperator : public BatchOperator {
+private:
+    std::vector<ColumnRef> refs;
+    std::vector<int> int_buf;
+    std::vector<std::string_view> str_buf;
+
+public:
+    ResultBatch* out = nullptr;
+
+    BatchAppendOperator(const Table& table, const std::vector<SelectItem>& items) {
+        for (const auto& item : items) refs.push_back(ColumnRef::of(table, item.col));
+    }
+
+    void push(size_t chunk, std::vector<uint32_t>& sel) override {
+        for (size_t i = 0; i < refs.size(); ++i) {
+            BatchColumn& col = out->columns[i];
+            if (refs[i].ints) {
+                int_buf.resize(sel.size());
+                refs[i].ints->gatherChunk(chunk, sel.data(), sel.size(), int_buf.data());
+                col.ints.insert(col.ints.end(), int_buf.begin(), int_buf.end());
+            } else {
+                str_buf.resize(sel.size());
+                refs[i].strs->gatherChunk(chunk, sel.data(), sel.size(), str_buf.data());
+                for (auto v : str_buf) col.append(v);
+            }
+        }
+    }
+};
+
+// 普通 SELECT 的游标：边扫边交，单线程
+// 持有快照和 GC 暂停 (Table::holdGc)，游标销毁前表不能析构
+class ScanCursor : public ResultCursor {
+private:
+    SelectPlan plan;
+    Snapshot snap;
+    BatchAppendOperator sink;
+    OperatorChain filters;
+    BatchOperator* head = nullptr;
+    std::vector<uint32_t> sel;
+
+    // 扫到哪里了：全表扫描是 (chunk, begin)，走索引是候选行的下标 pos
+    size_t num_chunks = 0;
+    size_t chunk = 0;
+    size_t begin = 0;
+    std::vector<size_t> rows;
+    size_t pos = 0;
+
+    bool finished() const {
+        return plan.index_pred >= 0 ? pos >= rows.size() : chunk >= num_chunks;
+    }
+
+    void scanTableSlices(ResultBatch& batch, uint64_t ts) {
+        const Table& table = *plan.table;
+        while (chunk < num_chunks && batch.rowCount() < CURSOR_BATCH_ROWS) {
+            size_t end = table.hasChunk(chunk) ? table.scanEnd(chunk, ts) : 0; // 0 = 已被 GC 回收，或者历史快照时还没有
+            if (begin < end) {
+                sel.clear();
+                table.visibleOffsets(chunk, begin, std::min(end, begin + QUERY_BATCH_SIZE), ts, sel);
+                if (!sel.empty()) head->push(chunk, sel);
+                begin += QUERY_BATCH_SIZE;
+            } else {
+                begin = CHUNK_SIZE;
+            }
+            if (begin >= CHUNK_SIZE) {
+                chunk++;
+                begin = 0;
+            }
+        }
+    }
+
+    void scanIndexSlices(ResultBatch& batch, uint64_t ts) {
+        const Table& table = *plan.table;
+        while (pos < rows.size() && batch.rowCount() < CURSOR_BATCH_ROWS) {
+            size_t c = rows[pos] / CHUNK_SIZE;
+            sel.clear();
+            for (; pos < rows.size() && rows[pos] / CHUNK_SIZE == c && sel.size() < QUERY_BATCH_SIZE; ++pos) {
+                if (table.isVisible(rows[pos], ts)) sel.push_back(static_cast<uint32_t>(rows[pos] % CHUNK_SIZE));
+            }
+            if (!sel.empty()) head->push(c, sel);
+        }
+    }
+
+public:
+    // plan 必须是非聚合查询 (已经校验过)
+    explicit ScanCursor(SelectPlan p)
+        : plan(std::move(p)), snap(plan.table->openSnapshotAt(plan.as_of)), sink(*plan.table, plan.items) {
+        Table& table = *plan.table;
+        for (const auto& item : plan.items) schema.push_back({item.label, table.columnType(item.col)});
+        head = QueryExecutor::buildFilters(table, plan, &sink, filters);
+        sel.reserve(QUERY_BATCH_SIZE);
+
+        // 先暂停 GC 再查索引：否则查完到开始扫之间折叠出来的新行不在候选里
+        table.holdGc();
+        try {
+            if (plan.index_pred >= 0) {
+                const Predicate& pred = plan.where[plan.index_pred];
+                rows = table.indexLookup(table.columnName(pred.col), pred.str_value);
+                std::sort(rows.begin(), rows.end());
+            } else {
+                num_chunks = table.chunkCount(); // 快照之后取：对快照可见的行都在这之内
+            }
+        } catch (...) {
+            table.releaseGc();
+            throw;
+        }
+    }
+
+    ~ScanCursor() override { plan.table->releaseGc(); }
+
+    ScanCursor(const ScanCursor&) = delete;
+    ScanCursor& operator=(const ScanCursor&) = delete;
+
+    bool next(ResultBatch& batch) override {
+        batch.reset(schema);
+        sink.out = &batch;
+        uint64_t ts = snap.timestamp();
+        while (!finished() && batch.rowCount() == 0) {
+            // 碰上封存 / 批量导入切换时整批重读：先记住这一批的起点
+            size_t chunk0 = chunk, begin0 = begin, pos0 = pos;
+            plan.table->readConsistent([&] {
+                chunk = chunk0;
+                begin = begin0;
+                pos = pos0;
+                batch.reset(schema);
+                if (plan.index_pred >= 0) scanIndexSlices(batch, ts);
+                else scanTableSlices(batch, ts);
+                return 0;
+            });
+        }
+        return batch.rowCount() > 0;
+    }
+};
+
+// 已经算好的结果 (聚合、JOIN)：按批切给调用方
+class MaterializedCursor : public ResultCursor {
+private:
+    QueryResult result;
+    size_t pos = 0;
+
+public:
+    explicit MaterializedCursor(QueryResult r) : result(std::move(r)) {
+        for (const auto& col : result.columns) schema.push_back({col.name, col.type});
+    }
+
+    bool next(ResultBatch& batch) override {
+        batch.reset(schema);
+        size_t end = std::min(result.rowCount(), pos + CURSOR_BATCH_ROWS);
+        if (pos >= end) return false;
+        for (size_t c = 0; c < result.columns.size(); ++c) {
+            const ResultColumn& src = result.columns[c];
+            BatchColumn& dst = batch.columns[c];
+            if (src.type == TYPE_INT) {
+                dst.ints.assign(src.ints.begin() + pos, src.ints.begin() + end);
+            } else {
+                for (size_t r = pos; r < end; ++r) dst.append(src.strings[r]);
+            }
+        }
+        pos = end;
+        return true;
+    }
+};
+
+// --- 序列化 ---
+// begin -> write (每批一次) -> end；drain 把游标剩下的结果一口气写完
+class ResultWriter {
+protected:
+    std::ostream& out;
+    std::string buf;
+    size_t rows = 0;
+
+    void flushIfFull() {
+        if (buf.size() >= RESULT_WRITE_BUFFER) flush();
+    }
+
+    template <typename T>
+    void putRaw(const T& v) {
+        buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+public:
+    explicit ResultWriter(std::ostream& o) : out(o) { buf.reserve(RESULT_WRITE_BUFFER * 2); }
+    virtual ~ResultWriter() = default;
+
+    virtual void begin(const std::vector<ResultColumnInfo>& columns) = 0;
+    virtual void write(const ResultBatch& batch) = 0;
+    virtual void end() { flush(); }
+
+    void flush() {
+        if (buf.empty()) return;
+        out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.clear();
+    }
+
+    size_t rowsWritten() const { return rows; }
+
+    // 写完整个结果 (表头 + 所有批 + 结尾)，返回行数
+    size_t drain(ResultCursor& cursor) {
+        begin(cursor.columns());
+        ResultBatch batch;
+        while (cursor.next(batch)) write(batch);
+        end();
+        return rows;
+    }
+};
+
+// 文本：表头一行，之后每行一条，列之间用 tab 分隔 (shell 输出)
+class TextResultWriter : public ResultWriter {
+public:
+    using ResultWriter::ResultWriter;
+
+    void begin(const std::vector<ResultColumnInfo>& columns) override {
+        for (size_t c = 0; c < columns.size(); ++c) {
+            if (c > 0) buf += '\t';
+            buf += columns[c].name;
+        }
+        buf += '\n';
+    }
+
+    void write(const ResultBatch& batch) override {
+        size_t n = batch.rowCount();
+        char num[24];
+        for (size_t r = 0; r < n; ++r) {
+            for (size_t c = 0; c < batch.columns.size(); ++c) {
+                const BatchColumn& col = batch.columns[c];
+                if (c > 0) buf += '\t';
+                if (col.type == TYPE_INT) {
+                    auto res = std::to_chars(num, num + sizeof(num), col.ints[r]);
+                    buf.append(num, res.ptr - num);
+                } else {
+                    buf += col.str(r);
+                }
+            }
+            buf += '\n';
+            flushIfFull();
+        }
+        rows += n;
+    }
+};
+
+// 二进制 (本机字节序)：
+//   开头  "HVRS" | u32 列数 | 每列 (u8 类型, u32 名字长度, 名字)
+//   每批  u32 行数 | 每列：INT 是 int64[行数]，STRING 是 u32 偏移[行数 + 1] + 字符
+//   结尾  u32 0
+class BinaryResultWriter : public ResultWriter {
+public:
+    using ResultWriter::ResultWriter;
+
+    void begin(const std::vector<ResultColumnInfo>& columns) override {
+        buf.append(RESULT_STREAM_MAGIC, sizeof(RESULT_STREAM_MAGIC));
+        putRaw(static_cast<uint32_t>(columns.size()));
+        for (const auto& col : columns) {
+            putRaw(static_cast<uint8_t>(col.type));
+            putRaw(static_cast<uint32_t>(col.name.size()));
+            buf += col.name;
+        }
+    }
+
+    void write(const ResultBatch& batch) override {
+        size_t n = batch.rowCount();
+        if (n == 0) return; // 0 行留给结尾标记
+        putRaw(static_cast<uint32_t>(n));
+        for (const auto& col : batch.columns) {
+            if (col.type == TYPE_INT) {
+                buf.append(reinterpret_cast<const char*>(col.ints.data()), n * sizeof(int64_t));
+            } else {
+                buf.append(reinterpret_cast<const char*>(col.offsets.data()), (n + 1) * sizeof(uint32_t));
+                buf += col.chars;
+            }
+        }
+        rows += n;
+        flushIfFull();
+    }
+
+    void end() override {
+        putRaw(static_cast<uint32_t>(0));
+        flush();
+    }
+};
+
+// 二进制结果流 -> QueryResult (客户端用)；格式不对抛 runtime_error
+class BinaryResultReader {
+private:
+    std::string_view in;
+    size_t pos = 0;
+
+    const char* take(size_t n) {
+        if (in.size() - pos < n) throw std::runtime_error("Truncated result stream");
+        const char* p = in.data() + pos;
+        pos += n;
+        return p;
+    }
+
+    template <typename T>
+    T getRaw() {
+        T v;
+        std::memcpy(&v, take(sizeof(T)), sizeof(T));
+        return v;
+    }
+
+public:
+    explicit BinaryResultReader(std::string_view data) : in(data) {}
+
+    QueryResult read() {
+        if (std::memcmp(take(sizeof(RESULT_STREAM_MAGIC)), RESULT_STREAM_MAGIC, sizeof(RESULT_STREAM_MAGIC)) != 0) {
+            throw std::runtime_error("Not a result stream");
+        }
+        QueryResult result;
+        uint32_t ncols = getRaw<uint32_t>();
+        for (uint32_t c = 0; c < ncols; ++c) {
+            ResultColumn col;
+            col.type = static_cast<ColumnType>(getRaw<uint8_t>());
+            uint32_t len = getRaw<uint32_t>();
+            col.name.assign(take(len), len);
+            result.columns.push_back(std::move(col));
+        }
+
+        // 每批：行数，然后逐列的数据；行数 0 是结尾
+        for (uint32_t n = getRaw<uint32_t>(); n != 0; n = getRaw<uint32_t>()) {
+            for (auto& col : result.columns) {
+                if (col.type == TYPE_INT) {
+                    size_t base = col.ints.size();
+                    col.ints.resize(base + n);
+                    std::memcpy(col.ints.data() + base, take(n * sizeof(int64_t)), n * sizeof(int64_t));
+                    continue;
+                }
+                std::vector<uint32_t> offsets(n + 1);
+                std::memcpy(offsets.data(), take((n + 1) * sizeof(uint32_t)), (n + 1) * sizeof(uint32_t));
+                const char* chars = take(offsets[n]);
+                for (uint32_t i = 0; i < n; ++i) col.strings.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+            }
+        }
+        return result;
+    }
+};
@@ -0,0 +1,560 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "Database.h"
+#include "WireProtocol.h"
+
+// --- 多客户端服务端 ---
+// 一个 epoll 事件循环线程负责 accept、读、拆帧；拆好的请求挂到连接上，连接交给工作线程池执行
+// 同一个连接同一时刻只有一个工作线程在处理 (busy)，所以它的请求按顺序执行、响应按顺序写回，流水线不会乱序
+// 不同连接在不同工作线程上并行：插入走表自己的并发路径，查询各开各的快照
+// 响应先试着直接写；写不完剩下的挂 EPOLLOUT，由事件循环接着写
+// 背压：一个连接积压的请求太多或者没写出去的响应太多，就先不读它 (去掉 EPOLLIN)，等工作线程追上来
+// 查询结果按批流式写回：每批一帧，没写出去的超过 SERVER_MAX_OUTPUT 时工作线程等事件循环写掉一些再接着读游标
+// 客户端不读流式结果、超过 SERVER_STALL_TIMEOUT 一个字节都没写出去，就断开它：游标占着的快照会挡住 GC 和过期截断
+// 对端只关了写 (half-close)：不再读，但已经收到的请求照样执行完、响应写完再关
+// 每个连接一个会话 (Session)：PREPARE name 注册的语句归连接自己；查表走无锁的目录，建表不挡其他连接
+
+// 一个连接最多积压这么多个没执行的请求，再多就先不读
+constexpr size_t SERVER_MAX_PIPELINE = 1024;
+// 没写出去的响应超过这么多字节也先不读
+constexpr size_t SERVER_MAX_OUTPUT = 16u << 20;
+// 流式查询等客户端读走结果最多等这么久 (期间一点进展都没有)，超时就断开连接、放掉游标
+constexpr auto SERVER_STALL_TIMEOUT = std::chrono::seconds(30);
+// 每次 recv 的大小
+constexpr size_t SERVER_READ_CHUNK = 64 * 1024;
+
+struct ServerOptions {
+    std::vector<WireAddress> listen;
+    size_t workers = 0; // 0 = hardware_concurrency
+};
+
+class Server {
+private:
+    struct Connection {
+        int fd;
+
+        // 只有事件循环线程碰
+        std::string in;
+        size_t in_pos = 0;
+
+        // 下面这些由 mtx 保护
+        std::mutex mtx;
+        std::deque<WireFrame> pending;  // 拆好了、还没执行的请求
+        bool busy = false;              // 有工作线程在处理这个连接
+        bool closed = false;
+        bool read_eof = false;          // 对端关了写：不再读，活干完、响应写完就关
+        std::string out;                // 还没写出去的响应
+        size_t out_pos = 0;
+        uint32_t events = 0;            // 当前在 epoll 上登记的事件
+        std::condition_variable drained; // 事件循环写掉了一些 (或者连接关了)：流式查询在等它
+
+        // 只有持有 busy 的工作线程碰
+        Session session;
+        std::unordered_map<uint32_t, std::unique_ptr<PreparedStatement>> statements;
+        uint32_t next_stmt = 1;
+
+        explicit Connection(int f) : fd(f) {}
+        ~Connection() { ::close(fd); }
+    };
+    using ConnPtr = std::shared_ptr<Connection>;
+
+    Database& db;
+    ServerOptions opts;
+
+    int epfd = -1;
+    int wake_fd = -1;
+    std::vector<int> listen_fds;
+    std::unordered_map<int, ConnPtr> conns; // 只有事件循环线程碰
+
+    std::mutex queue_mtx;
+    std::condition_variable queue_cv;
+    std::deque<ConnPtr> ready;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{false};
+
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> accepted{0};
+
+public:
+    Server(Database& database, ServerOptions options) : db(database), opts(std::move(options)) {}
+
+    ~Server() {
+        shutdown();
+        for (int fd : listen_fds) ::close(fd);
+        if (wake_fd >= 0) ::close(wake_fd);
+        if (epfd >= 0) ::close(epfd);
+        for (const auto& addr : opts.listen) {
+            if (addr.is_unix) ::unlink(addr.path.c_str());
+        }
+    }
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // 1. 绑定所有监听地址  2. 起工作线程；出错抛 runtime_error
+    void start() {
+        epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0) throw std::runtime_error(socketError("epoll_create1"));
+        wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd < 0) throw std::runtime_error(socketError("eventfd"));
+        addFd(wake_fd, EPOLLIN);
+
+        if (opts.listen.empty()) throw std::runtime_error("No listen address");
+        for (const auto& addr : opts.listen) {
+            int fd = bindListener(addr);
+            listen_fds.push_back(fd);
+            addFd(fd, EPOLLIN);
+        }
+
+        size_t n = opts.workers ? opts.workers : std::max<size_t>(1, std::thread::hardware_concurrency());
+        running = true;
+        for (size_t i = 0; i < n; ++i) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    // 事件循环，在调用线程里跑到 requestStop()
+    void run() {
+        epoll_event events[64];
+        while (running.load(std::memory_order_relaxed)) {
+            int n = ::epoll_wait(epfd, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(socketError("epoll_wait"));
+            }
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wake_fd) {
+                    uint64_t v;
+                    while (::read(wake_fd, &v, sizeof(v)) > 0) {}
+                } else if (isListener(fd)) {
+                    acceptAll(fd);
+                } else {
+                    auto it = conns.find(fd);
+                    if (it != conns.end()) onEvent(it->second, events[i].events);
+                }
+            }
+        }
+    }
+
+    // 可以在信号处理函数里调用 (只有原子写和 write)
+    void requestStop() {
+        running.store(false, std::memory_order_relaxed);
+        uint64_t one = 1;
+        ssize_t r = ::write(wake_fd, &one, sizeof(one));
+        (void)r;
+    }
+
+    // 停掉工作线程，断开所有连接 (run() 返回之后调用)
+    // 先关连接：事件循环已经停了，等着写出流式结果的工作线程要靠它醒过来
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx);
+            stopping = true;
+        }
+        queue_cv.notify_all();
+        for (auto& kv : conns) closeConn(kv.second, false);
+        for (auto& t : workers) t.join();
+        workers.clear();
+        conns.clear();
+    }
+
+    uint64_t requestCount() const { return requests.load(); }
+    uint64_t connectionCount() const { return accepted.load(); }
+
+private:
+    // --- 监听与 epoll ---
+    void addFd(int fd, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) throw std::runtime_error(socketError("epoll_ctl"));
+    }
+
+    bool isListener(int fd) const {
+        for (int l : listen_fds) {
+            if (l == fd) return true;
+        }
+        return false;
+    }
+
+    static int bindListener(const WireAddress& addr) {
+        int fd;
+        if (addr.is_unix) {
+            fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) throw std::runtime_error(socketError("socket"));
+            sockaddr_un sa{};
+            sa.sun_family = AF_UNIX;
+            if (addr.path.size() >= sizeof(sa.sun_path)) throw std::runtime_error("Socket path too long: " + addr.path);
+            std::memcpy(sa.sun_path, addr.path.c_str(), addr.path.size() + 1);
+            ::unlink(addr.path.c_str()); // 上次没清掉的 socket 文件
+            if (::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) < 0) {
+                std::string err = socketError("bind " + addr.text());
+                ::close(fd);
+                throw std::runtime_error(err);
+            }
+        } else {
+            fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) throw std::runtime_error(socketError("socket"));
+            int one = 1;
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in sa{};
+            sa.sin_family = AF_INET;
+            sa.sin_port = htons(addr.port);
+            if (::inet_pton(AF_INET, addr.host.c_str(), &sa.sin_addr) != 1) {
+                ::close(fd);
+                throw std::runtime_error("Bad IPv4 address: " + addr.host);
+            }
+            if (::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) < 0) {
+                std::string err = socketError("bind " + addr.text());
+                ::close(fd);
+                throw std::runtime_error(err);
+            }
+        }
+        if (::listen(fd, SOMAXCONN) < 0) {
+            std::string err = socketError("listen " + addr.text());
+            ::close(fd);
+            throw std::runtime_error(err);
+        }
+        return fd;
+    }
+
+    void acceptAll(int listen_fd) {
+        while (true) {
+            int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return; // EAGAIN：这一轮接完了 (其他错误下一轮再说)
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Unix socket 上会失败，无所谓
+            auto conn = std::make_shared<Connection>(fd);
+            conn->events = EPOLLIN;
+            addFd(fd, conn->events);
+            conns.emplace(fd, std::move(conn));
+            accepted++;
+        }
+    }
+
+    // 对端关了写，请求都执行完了，响应也都写出去了：可以关了 (持有 conn.mtx)
+    static bool finishedLocked(const Connection& conn) {
+        return conn.read_eof && !conn.busy && conn.pending.empty() && conn.out_pos == conn.out.size();
+    }
+
+    // 按连接当前的状态重新登记事件 (持有 conn.mtx)：积压太多或者读到头了就不读，有没写完的响应就等可写
+    // 可以关了也登记 EPOLLOUT：工作线程不能自己摘连接，让事件循环醒过来关
+    void rearmLocked(Connection& conn) {
+        if (conn.closed) return;
+        bool backlog = conn.read_eof || conn.pending.size() >= SERVER_MAX_PIPELINE || conn.out.size() - conn.out_pos > SERVER_MAX_OUTPUT;
+        bool writable = conn.out_pos < conn.out.size() || finishedLocked(conn);
+        uint32_t events = (backlog ? 0 : uint32_t(EPOLLIN)) | (writable ? uint32_t(EPOLLOUT) : 0);
+        if (events == conn.events) return;
+        conn.events = events;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = conn.fd;
+        ::epoll_ctl(epfd, EPOLL_CTL_MOD, conn.fd, &ev);
+    }
+
+    // 非阻塞地尽量写 (持有 conn.mtx)；对端已经断开就丢掉剩下的
+    static void writeLocked(Connection& conn) {
+        while (conn.out_pos < conn.out.size()) {
+            ssize_t n = ::send(conn.fd, conn.out.data() + conn.out_pos, conn.out.size() - conn.out_pos, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+                conn.out_pos = conn.out.size(); // EPIPE / ECONNRESET
+                break;
+            }
+            conn.out_pos += static_cast<size_t>(n);
+        }
+        conn.out.clear();
+        conn.out_pos = 0;
+    }
+
+    void closeConn(const ConnPtr& conn, bool erase = true) {
+        {
+            std::lock_guard<std::mutex> lock(conn->mtx);
+            conn->closed = true;
+            conn->pending.clear();
+        }
+        conn->drained.notify_all();
+        ::epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, nullptr);
+        // fd 在最后一个 shared_ptr 放手时才关：正在处理它的工作线程不会写到一个被复用的 fd 上
+        if (erase) conns.erase(conn->fd);
+    }
+
+    // --- 事件循环：读、拆帧、派给工作线程 ---
+    void onEvent(ConnPtr conn, uint32_t events) {
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lock(conn->mtx);
+            done = conn->closed; // 工作线程放弃了这个连接 (abortLocked)
+        }
+        if (!done && (events & EPOLLOUT)) {
+            {
+                std::lock_guard<std::mutex> lock(conn->mtx);
+                writeLocked(*conn);
+                done = finishedLocked(*conn);
+                rearmLocked(*conn);
+            }
+            conn->drained.notify_all();
+        }
+        if (done) {
+            closeConn(conn);
+            return;
+        }
+        if (events & EPOLLIN) {
+            if (!readConn(conn)) {
+                closeConn(conn);
+                return;
+            }
+        }
+        // 对端只关了写 (half-close) 时 readConn 只是停止读，之前发来的请求照样执行完、响应写完再关
+        // 整个断开 / 出错时不用再读了：积压的请求丢掉，响应反正也写不出去
+        if ((events & (EPOLLHUP | EPOLLERR)) && !(events & EPOLLIN)) closeConn(conn);
+    }
+
+    // 读一次，拆出完整的帧挂到连接上；连接该关了返回 false
+    bool readConn(const ConnPtr& conn) {
+        size_t base = conn->in.size();
+        conn->in.resize(base + SERVER_READ_CHUNK);
+        ssize_t n = ::recv(conn->fd, &conn->in[base], SERVER_READ_CHUNK, 0);
+        if (n < 0) {
+            conn->in.resize(base);
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; // 其他错误：断开
+        }
+        if (n == 0) {
+            // 对端关了写：不完整的半帧丢掉，不再读；没干完的活干完、响应写完再关
+            conn->in.resize(base);
+            std::lock_guard<std::mutex> lock(conn->mtx);
+            conn->read_eof = true;
+            if (finishedLocked(*conn)) return false;
+            rearmLocked(*conn);
+            return true;
+        }
+        conn->in.resize(base + static_cast<size_t>(n));
+
+        std::vector<WireFrame> frames;
+        try {
+            WireFrame frame;
+            while (parseFrame(conn->in, conn->in_pos, frame)) frames.push_back(std::move(frame));
+        } catch (const std::exception&) {
+            return false; // 帧长度非法：协议已经乱了，只能断开
+        }
+        if (conn->in_pos == conn->in.size()) {
+            conn->in.clear();
+            conn->in_pos = 0;
+        } else if (conn->in_pos > SERVER_READ_CHUNK) {
+            conn->in.erase(0, conn->in_pos);
+            conn->in_pos = 0;
+        }
+        if (frames.empty()) return true;
+
+        bool schedule = false;
+        {
+            std::lock_guard<std::mutex> lock(conn->mtx);
+            for (auto& f : frames) conn->pending.push_back(std::move(f));
+            if (!conn->busy) {
+                conn->busy = true;
+                schedule = true;
+            }
+            rearmLocked(*conn);
+        }
+        if (schedule) {
+            {
+                std::lock_guard<std::mutex> lock(queue_mtx);
+                ready.push_back(conn);
+            }
+            queue_cv.notify_one();
+        }
+        return true;
+    }
+
+    // --- 工作线程 ---
+    void workerLoop() {
+        while (true) {
+            ConnPtr conn;
+            {
+                std::unique_lock<std::mutex> lock(queue_mtx);
+                queue_cv.wait(lock, [&] { return stopping || !ready.empty(); });
+                if (ready.empty()) return;
+                conn = std::move(ready.front());
+                ready.pop_front();
+            }
+            serve(*conn);
+        }
+    }
+
+    // 把连接上积压的请求全部执行完；执行期间事件循环可以继续往 pending 里追加
+    void serve(Connection& conn) {
+        std::deque<WireFrame> batch;
+        std::string responses;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(conn.mtx);
+                if (conn.pending.empty() || conn.closed) {
+                    conn.busy = false;
+                    rearmLocked(conn); // 积压清掉了，恢复读
+                    return;
+                }
+                batch.swap(conn.pending);
+                rearmLocked(conn);
+            }
+
+            responses.clear();
+            for (const auto& req : batch) {
+                handle(conn, req, responses);
+                requests.fetch_add(1, std::memory_order_relaxed);
+            }
+            batch.clear();
+
+            std::lock_guard<std::mutex> lock(conn.mtx);
+            if (conn.closed) continue;
+            conn.out += responses;
+            writeLocked(conn);
+            rearmLocked(conn);
+        }
+    }
+
+    // 有结果写进 responses；流式查询会在中途把 responses (连同前面请求的响应) 交给连接写出去
+    void handle(Connection& conn, const WireFrame& req, std::string& responses) {
+        WireWriter w(responses);
+        try {
+            switch (req.code) {
+                case WIRE_PING:
+                    w.frame(WIRE_OK, req.id, {});
+                    break;
+                case WIRE_SQL: {
+                    std::ostringstream out;
+                    bool ok = db.executeSQL(req.payload, out, conn.session);
+                    w.frame(ok ? WIRE_OK : WIRE_ERROR, req.id, out.str());
+                    break;
+                }
+                case WIRE_QUERY:
+                    streamQuery(conn, req, responses);
+                    break;
+                case WIRE_PREPARE: {
+                    std::unique_ptr<PreparedStatement> stmt = db.prepare(req.payload);
+                    uint32_t id = conn.next_stmt++;
+                    conn.statements[id] = std::move(stmt);
+                    w.beginFrame(WIRE_OK, req.id);
+                    w.put(id);
+                    w.endFrame();
+                    break;
+                }
+                case WIRE_INSERT_BATCH: {
+                    uint64_t n = insertBatch(conn, req.payload);
+                    w.beginFrame(WIRE_OK, req.id);
+                    w.put(n);
+                    w.endFrame();
+                    break;
+                }
+                default:
+                    w.frame(WIRE_ERROR, req.id, "Error: Unknown request type " + std::to_string(req.code));
+            }
+        } catch (const SqlError& e) {
+            w.frame(WIRE_ERROR, req.id, e.what());
+        } catch (const std::exception& e) {
+            w.frame(WIRE_ERROR, req.id, std::string("Error: ") + e.what());
+        }
+    }
+
+    // 结果流每批一帧 WIRE_MORE，最后一帧 WIRE_OK 带结尾标记；客户端按顺序把负载拼起来就是完整的结果流
+    // 中途出错时由 handle 补一帧 WIRE_ERROR，前面收到的部分作废
+    void streamQuery(Connection& conn, const WireFrame& req, std::string& responses) {
+        auto cursor = db.openCursor(req.payload);
+        std::ostringstream piece;
+        BinaryResultWriter writer(piece);
+        WireWriter w(responses);
+
+        writer.begin(cursor->columns());
+        ResultBatch batch;
+        while (cursor->next(batch)) {
+            writer.write(batch);
+            writer.flush();
+            if (piece.tellp() <= 0) continue;
+            w.frame(WIRE_MORE, req.id, piece.str());
+            piece.str("");
+            if (!pushOutput(conn, responses)) return; // 连接已经断了，剩下的不用读了
+        }
+        writer.end();
+        w.frame(WIRE_OK, req.id, piece.str());
+    }
+
+    // 把攒好的响应交给连接写出去；没写出去的超过 SERVER_MAX_OUTPUT 就等事件循环写掉一些 (背压)
+    // SERVER_STALL_TIMEOUT 内一点都没写出去就放弃这个连接；连接已经关了返回 false
+    bool pushOutput(Connection& conn, std::string& responses) {
+        std::unique_lock<std::mutex> lock(conn.mtx);
+        if (!conn.closed) {
+            conn.out += responses;
+            writeLocked(conn);
+            rearmLocked(conn);
+        }
+        responses.clear();
+
+        // 只有这个工作线程往 out 里追加，所以等待期间剩下的字节数只减不增
+        size_t left = conn.out.size() - conn.out_pos;
+        auto deadline = std::chrono::steady_clock::now() + SERVER_STALL_TIMEOUT;
+        while (!conn.closed && left > SERVER_MAX_OUTPUT) {
+            bool timed_out = conn.drained.wait_until(lock, deadline) == std::cv_status::timeout;
+            size_t now_left = conn.out.size() - conn.out_pos;
+            if (now_left < left) {
+                left = now_left;
+                deadline = std::chrono::steady_clock::now() + SERVER_STALL_TIMEOUT;
+            } else if (timed_out) {
+                abortLocked(conn);
+            }
+        }
+        return !conn.closed;
+    }
+
+    // 工作线程放弃一个连接 (持有 conn.mtx)：连接只能由事件循环摘掉，这里把 socket 两个方向都关了
+    // 让事件循环收到 EPOLLHUP 来摘
+    static void abortLocked(Connection& conn) {
+        conn.closed = true;
+        conn.pending.clear();
+        conn.out.clear();
+        conn.out_pos = 0;
+        ::shutdown(conn.fd, SHUT_RDWR);
+    }
+
+    // 一批行代入同一个预编译语句；中途出错时前面的行已经写进去了
+    uint64_t insertBatch(Connection& conn, const std::string& payload) {
+        WireReader r(payload);
+        uint32_t stmt_id = r.get<uint32_t>();
+        uint32_t rows = r.get<uint32_t>();
+        auto it = conn.statements.find(stmt_id);
+        if (it == conn.statements.end()) throw SqlError("Error: Unknown prepared statement " + std::to_string(stmt_id));
+        PreparedStatement& stmt = *it->second;
+        StatementLease lease{stmt};
+
+        std::vector<Table::Value> params(stmt.paramCount());
+        uint64_t inserted = 0;
+        for (uint32_t i = 0; i < rows; ++i) {
+            for (auto& p : params) r.getValue(p);
+            inserted += stmt.execute(params);
+        }
+        if (!r.atEnd()) throw std::runtime_error("Malformed request: trailing bytes after " + std::to_string(rows) + " rows");
+        return inserted;
+    }
+};
@@ -0,0 +1,223 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// 提交水位最多跟踪多少个在途 (已领时间戳、还没提交) 的写入，再多的写入提交时等水位追上来
+constexpr size_t COMMIT_CLOCK_SLOTS = 4096;
+
+// --- 提交水位 ---
+// 写入先领时间戳 (issue)，写完数据、setCreated 之后才算提交 (finish)：领号和提交之间有空档，
+// 号小的可能比号大的晚提交。快照要是直接钉最新发出去的号，打开以后还会冒出 ts <= 快照的行，
+// 同一个快照读两遍结果不一样，走版本链的点查也可能跳过还没提交的表头、读到旧值
+// 所以快照钉的是提交水位：这个时间戳及以前发出去的号都已经提交 (或作废)
+// 完成的号记在环形数组里 (槽里存号本身，不用清)，谁完成谁顺手把水位往前推
+class CommitClock {
+private:
+    std::atomic<uint64_t> issued{0};
+    std::atomic<uint64_t> committed{0};
+    std::atomic<uint64_t> done[COMMIT_CLOCK_SLOTS];
+
+    void advance() {
+        uint64_t w = committed.load();
+        // done 和 committed 都用 seq_cst：两个写入同时完成时，至少有一个能看到对方的号，水位不会卡住
+        while (done[(w + 1) % COMMIT_CLOCK_SLOTS].load() == w + 1) {
+            if (committed.compare_exchange_weak(w, w + 1)) ++w; // 失败时 w 是别人推到的新水位
+        }
+    }
+
+public:
+    CommitClock() {
+        for (auto& d : done) d.store(0, std::memory_order_relaxed);
+    }
+
+    // 领一个提交时间戳；领了就必须 finish (写入失败也要)，否则水位停在它前面
+    uint64_t issue() { return ++issued; }
+
+    // ts 的数据已经全部写好 (或者作废了)
+    void finish(uint64_t ts) {
+        // 槽里上一轮的号 (ts - SLOTS) 还没被水位越过：在途的写入太多，等一等
+        while (ts - committed.load() > COMMIT_CLOCK_SLOTS) std::this_thread::yield();
+        done[ts % COMMIT_CLOCK_SLOTS].store(ts);
+        advance();
+    }
+
+    // 提交水位 (快照和 GC 低水位都按它算)
+    const std::atomic<uint64_t>& committedClock() const { return committed; }
+    uint64_t committedTimestamp() const { return committed.load(); }
+
+    // 发出去的最大时间戳 (含还没提交的)
+    uint64_t issuedTimestamp() const { return issued.load(); }
+
+    // 从表文件恢复：时钟接上保存时的时间戳 (调用方保证没有在途的写入)
+    void advanceTo(uint64_t ts) {
+        if (issued.load() >= ts) return;
+        issued.store(ts);
+        committed.store(ts);
+    }
+};
+
+// 快照登记簿：记录所有活跃快照的时间戳 (低水位) 和登记序号 (epoch)
+// - 低水位：GC 只能回收所有活跃快照都看不到的版本
+// - epoch：被摘下来的块要等摘块之前登记的快照全部结束才能真正 delete (读者手里可能还有指针)
+class SnapshotRegistry {
+private:
+    std::mutex mtx;
+    std::map<uint64_t, uint64_t> active;   // epoch -> ts
+    std::multiset<uint64_t> active_ts;      // 用于 O(1) 取最小 ts
+    uint64_t next_epoch = 0;
+    uint64_t history_floor = 0;             // 发出去过的最大低水位：更早的历史可能已经被 GC 折叠
+
+    struct Retired {
+        uint64_t epoch;                     // 摘块时的 next_epoch
+        std::function<void()> deleter;
+    };
+    std::vector<Retired> retired;
+
+public:
+    ~SnapshotRegistry() {
+        // 析构时不会再有读者
+        for (auto& r : retired) r.deleter();
+    }
+
+    // 钉住一个读时间戳
+    // 必须在锁内读时钟：保证登记之后算出的低水位不会超过这个快照
+    uint64_t pin(const std::atomic<uint64_t>& clock, uint64_t& out_epoch) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint64_t ts = clock.load();
+        out_epoch = next_epoch++;
+        active.emplace(out_epoch, ts);
+        active_ts.insert(ts);
+        return ts;
+    }
+
+    // 钉住一个历史时间戳 (AS OF)：晚于当前时钟的按当前时钟算
+    // 比 history_floor 早的版本可能已经被折叠，读出来的不是当时的数据，直接拒绝
+    uint64_t pinAt(const std::atomic<uint64_t>& clock, uint64_t as_of, uint64_t& out_epoch) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint64_t ts = std::min(as_of, clock.load());
+        if (ts < history_floor) {
+            throw std::runtime_error("AS OF " + std::to_string(ts) + " is older than the retained history (oldest readable timestamp is " +
+                                     std::to_string(history_floor) + ")");
+        }
+        out_epoch = next_epoch++;
+        active.emplace(out_epoch, ts);
+        active_ts.insert(ts);
+        return ts;
+    }
+
+    void unpin(uint64_t epoch) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = active.find(epoch);
+        if (it == active.end()) return;
+        active_ts.erase(active_ts.find(it->second));
+        active.erase(it);
+    }
+
+    // 低水位：最老的活跃快照；没有活跃快照时就是当前时钟
+    // retain > 0 时再往前留 retain 个时间戳的历史 (AS OF 查询能回到多早)
+    // GC 按低水位折叠版本，所以发出去的低水位同时也是历史查询的下限
+    uint64_t lowWatermark(const std::atomic<uint64_t>& clock, uint64_t retain = 0) {
+        std::lock_guard<std::mutex> lock(mtx);
+        uint64_t now = clock.load();
+        uint64_t mark = active_ts.empty() ? now : *active_ts.begin();
+        if (retain > 0) mark = std::min(mark, now > retain ? now - retain : 0);
+        history_floor = std::max(history_floor, mark);
+        return mark;
+    }
+
+    // 最早还能读的历史时间戳
+    uint64_t historyFloor() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return history_floor;
+    }
+
+    // 从表文件恢复时接上保存时的下限
+    void raiseHistoryFloor(uint64_t ts) {
+        std::lock_guard<std::mutex> lock(mtx);
+        history_floor = std::max(history_floor, ts);
+    }
+
+    size_t activeCount() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return active.size();
+    }
+
+    // 登记一块已经摘下来的内存，等旧读者退出后再释放
+    void retire(std::function<void()> deleter) {
+        std::lock_guard<std::mutex> lock(mtx);
+        retired.push_back({next_epoch, std::move(deleter)});
+    }
+
+    // 释放所有不再可能被读者引用的内存，返回释放的个数
+    size_t reclaim() {
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            uint64_t oldest = active.empty() ? next_epoch : active.begin()->first;
+            size_t keep = 0;
+            for (auto& r : retired) {
+                if (r.epoch <= oldest) ready.push_back(std::move(r.deleter));
+                else retired[keep++] = std::move(r);
+            }
+            retired.resize(keep);
+        }
+        // 锁外 delete，大块内存释放比较慢
+        for (auto& d : ready) d();
+        return ready.size();
+    }
+};
+
+// 快照句柄 (RAII)：存活期间钉住一个读时间戳，长时间的分析会话用同一个句柄读到一致的数据
+class Snapshot {
+private:
+    SnapshotRegistry* registry = nullptr;
+    uint64_t ts = 0;
+    uint64_t epoch = 0;
+
+public:
+    Snapshot(SnapshotRegistry& reg, const std::atomic<uint64_t>& clock) : registry(&reg) {
+        ts = reg.pin(clock, epoch);
+    }
+
+    // 历史快照：读 as_of 时刻的数据 (见 SnapshotRegistry::pinAt)
+    Snapshot(SnapshotRegistry& reg, const std::atomic<uint64_t>& clock, uint64_t as_of) : registry(&reg) {
+        ts = reg.pinAt(clock, as_of, epoch);
+    }
+
+    ~Snapshot() { release(); }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    Snapshot(Snapshot&& other) noexcept : registry(other.registry), ts(other.ts), epoch(other.epoch) {
+        other.registry = nullptr;
+    }
+
+    Snapshot& operator=(Snapshot&& other) noexcept {
+        if (this != &other) {
+            release();
+            registry = other.registry;
+            ts = other.ts;
+            epoch = other.epoch;
+            other.registry = nullptr;
+        }
+        return *this;
+    }
+
+    uint64_t timestamp() const { return ts; }
+
+    // 提前释放 (不等析构)
+    void release() {
+        if (registry) registry->unpin(epoch);
+        registry = nullptr;
+    }
+};
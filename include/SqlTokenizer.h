@@ -0,0 +1,165 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <charconv>
+#include <stdexcept>
+
+// --- SQL 词法分析 ---
+// 零拷贝：Token 里的 text 都是指向原 SQL 字符串的 string_view，调用方要保证原串活得比 Token 久
+
+// 前端错误 (语法错误、表或列不存在、类型不符)，what() 就是给用户看的完整提示
+class SqlError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+enum TokenType {
+    TOK_END,     // 读完了
+    TOK_IDENT,   // 标识符 / 关键字 (关键字比较不区分大小写)
+    TOK_NUMBER,  // 整数 (不带符号，负号由 parser 处理)
+    TOK_STRING,  // "..." 或 '...'，text 是引号里面的内容
+    TOK_PARAM,   // ? 占位符
+    TOK_SYMBOL   // ( ) , * = ; 以及 < > <= >= != <>
+};
+
+struct Token {
+    TokenType type = TOK_END;
+    std::string_view text;
+    int64_t number = 0;
+
+    // 关键字 (不区分大小写) 或符号 (精确匹配)
+    bool is(std::string_view s) const {
+        if (type == TOK_SYMBOL) return text == s;
+        if (type != TOK_IDENT || text.size() != s.size()) return false;
+        for (size_t i = 0; i < s.size(); ++i) {
+            char a = text[i], b = s[i];
+            if (a >= 'a' && a <= 'z') a -= 'a' - 'A';
+            if (b >= 'a' && b <= 'z') b -= 'a' - 'A';
+            if (a != b) return false;
+        }
+        return true;
+    }
+};
+
+class SqlTokenizer {
+private:
+    std::string_view src;
+    size_t pos = 0;
+    Token lookahead;
+    bool has_lookahead = false;
+
+    static bool isIdentStart(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    Token scan() {
+        while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\t' || src[pos] == '\n' || src[pos] == '\r')) pos++;
+        Token tok;
+        if (pos >= src.size()) return tok;
+
+        size_t start = pos;
+        char c = src[pos];
+        if (isIdentStart(c)) {
+            while (pos < src.size() && (isIdentStart(src[pos]) || isDigit(src[pos]))) pos++;
+            tok.type = TOK_IDENT;
+            tok.text = src.substr(start, pos - start);
+        } else if (isDigit(c)) {
+            while (pos < src.size() && isDigit(src[pos])) pos++;
+            tok.type = TOK_NUMBER;
+            tok.text = src.substr(start, pos - start);
+            auto res = std::from_chars(src.data() + start, src.data() + pos, tok.number);
+            if (res.ec != std::errc()) throw SqlError("Syntax Error: number out of range: " + std::string(tok.text));
+        } else if (c == '"' || c == '\'') {
+            size_t close = src.find(c, pos + 1);
+            if (close == std::string_view::npos) throw SqlError("Syntax Error: unterminated string literal");
+            tok.type = TOK_STRING;
+            tok.text = src.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+        } else if (c == '?') {
+            pos++;
+            tok.type = TOK_PARAM;
+            tok.text = src.substr(start, 1);
+        } else {
+            // 两字符比较符优先
+            if (pos + 1 < src.size()) {
+                std::string_view two = src.substr(pos, 2);
+                if (two == "<=" || two == ">=" || two == "!=" || two == "<>") {
+                    pos += 2;
+                    tok.type = TOK_SYMBOL;
+                    tok.text = two;
+                    return tok;
+                }
+            }
+            if (std::string_view("(),*=;<>-.").find(c) == std::string_view::npos) {
+                throw SqlError(std::string("Syntax Error: unexpected character '") + c + "'");
+            }
+            pos++;
+            tok.type = TOK_SYMBOL;
+            tok.text = src.substr(start, 1);
+        }
+        return tok;
+    }
+
+public:
+    explicit SqlTokenizer(std::string_view sql) : src(sql) {}
+
+    Token next() {
+        if (has_lookahead) {
+            has_lookahead = false;
+            return lookahead;
+        }
+        return scan();
+    }
+
+    const Token& peek() {
+        if (!has_lookahead) {
+            lookahead = scan();
+            has_lookahead = true;
+        }
+        return lookahead;
+    }
+
+    // 下一个 token 是 s 就吃掉并返回 true
+    bool accept(std::string_view s) {
+        if (!peek().is(s)) return false;
+        has_lookahead = false;
+        return true;
+    }
+
+    // 下一个 token 必须是 s
+    void expect(std::string_view s) {
+        Token tok = next();
+        if (!tok.is(s)) {
+            throw SqlError("Syntax Error: expected '" + std::string(s) + "' near '" + std::string(tok.text) + "'");
+        }
+    }
+
+    // 下一个 token 必须是标识符
+    std::string_view expectIdent() {
+        Token tok = next();
+        if (tok.type != TOK_IDENT) throw SqlError("Syntax Error: expected a name near '" + std::string(tok.text) + "'");
+        return tok.text;
+    }
+
+    // 还没读的部分 (PREPARE name AS <这里>)
+    std::string_view rest() {
+        if (has_lookahead) {
+            has_lookahead = false;
+            if (lookahead.type == TOK_END) {
+                pos = src.size();
+            } else {
+                pos = static_cast<size_t>(lookahead.text.data() - src.data());
+                if (lookahead.type == TOK_STRING) pos--; // text 不含开头的引号
+            }
+        }
+        return src.substr(pos);
+    }
+
+    // 语句结束 (允许末尾一个分号)
+    bool atEnd() {
+        accept(";");
+        return peek().type == TOK_END;
+    }
+};
@@ -261,15 +261,32 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <memory>
 #include <variant>
 #include <atomic>
 #include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_set>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <deque>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <mutex>
 #include "Column.h"
 #include "MvccMeta.h"
 #include "HashIndex.h"
+#include "Rcu.h"
+#include "QueryProfile.h"
 #include "BinaryLogger.h"
+#include "Snapshot.h"
+#include "TableFile.h"
+#include "Metrics.h"
 
 // 聚合类型定义
 enum AggType { 
@@ -279,6 +296,34 @@ enum AggType {
 
 enum ColumnType { TYPE_INT, TYPE_STRING };
 
+// 结果按列存 (SELECT 和 multiGetColumns 共用)；INT 结果统一放 int64 (SUM / COUNT 会超出 int)
+struct ResultColumn {
+    std::string name;
+    ColumnType type = TYPE_INT;
+    std::vector<int64_t> ints;
+    std::vector<std::string> strings;
+
+    size_t size() const { return type == TYPE_INT ? ints.size() : strings.size(); }
+};
+
+struct QueryResult {
+    std::vector<ResultColumn> columns;
+
+    size_t rowCount() const { return columns.empty() ? 0 : columns[0].size(); }
+};
+
+// 行号租约：每个线程一次从全局游标领走一段连续行号，本地慢慢填
+// 4096 行 * 4B = 16KB，远大于 cache line，不同写线程之间不再共享同一条 cache line
+constexpr size_t ROW_LEASE_SIZE = 4096;
+
+// 批量点查一组多少个 key：同时在途的预取够多，又不至于把 L1/L2 冲掉；GC 切换时只重做一组
+constexpr size_t MULTI_GET_GROUP = 64;
+
+// GC: 一批折叠多少个 key (一批的可见性切换在顺序锁内完成，批越小读者重试窗口越短)
+constexpr size_t GC_BATCH_KEYS = 1024;
+// GC: 块里活着的行不足这个比例时，把剩下的行也折叠到表尾，让整块能被回收
+constexpr double GC_COMPACT_LIVE_RATIO = 0.25;
+
 class Table {
 private:
     std::string table_name;
@@ -293,32 +338,125 @@ private:
 
     // 存储引擎核心组件
     std::unordered_map<std::string, std::unique_ptr<AbstractColumn>> columns;
-    std::unordered_map<std::string, std::unique_ptr<HashIndex>> indexes;
+    // 索引：每个 STRING 列一个槽，建列时建好，之后 map 本身不再变 (写入不加锁查它)
+    // live = 查询走的索引；building = 在线建到一半的索引 (写入两边都登记，查询还不用)
+    struct IndexSlot {
+        std::atomic<HashIndex*> live{nullptr};
+        std::atomic<HashIndex*> building{nullptr};
+        std::unique_ptr<HashIndex> owned;
+    };
+    std::unordered_map<std::string, IndexSlot> indexes;
+    std::mutex index_build_mutex;        // 同一时间只建一个索引
     
     // MVCC & 事务
     MvccMeta meta;
-    std::atomic<uint64_t> global_ts{0};
+    CommitClock commit_clock;            // 提交时间戳：写入领号，快照钉提交水位
 
-    // 无锁写入游标
+    // 无锁写入游标 (已经租出去的行号上界，不代表这些行都已写入)
     std::atomic<size_t> tail_index{0};
 
+    // 表实例编号：thread_local 租约按编号区分表 (地址会被复用，编号不会)
+    static inline std::atomic<uint64_t> next_table_uid{1};
+    const uint64_t table_uid = next_table_uid.fetch_add(1);
+
+    // 活着的表 (按编号)：线程退出归还租约时先在这里确认表还在，持锁期间表不会析构
+    static inline std::mutex live_tables_mutex;
+    static inline std::unordered_map<uint64_t, Table*> live_tables;
+
+    struct RowLease {
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    // 语句结束时交还的租约：下一个领租约的线程先用这些行号，落在已写满块里的部分由维护标记为 DEAD_TS
+    std::mutex parked_mutex;
+    std::vector<RowLease> parked_leases;
+
     // 日志管理器
     std::unique_ptr<BinaryLogger> logger;
 
+    // 快照 & 旧版本回收
+    SnapshotRegistry snapshots;
+    std::atomic<uint64_t> gc_seq{0};     // 顺序锁：奇数表示 GC 正在切换一批版本的可见性
+    std::string gc_key_col;              // GC 按哪一列归并版本 (第一个带索引的 String 列)
+    std::mutex gc_mutex;                 // 同一时间只允许一个 GC pass
+    std::atomic<size_t> gc_holds{0};     // 打开着的流式游标数，大于 0 时 GC 不动版本
+    std::atomic<uint64_t> history_retention{0}; // GC 在低水位之前再留多少个时间戳的历史 (AS OF 用)
+
+    // 保留策略 (TTL)：过期的整块由 truncateExpired 摘掉
+    std::atomic<uint64_t> retention_min_ts{0};  // 提交时间戳早于它的行过期，0 = 不按时间戳
+    std::atomic<int64_t> retention_age_ms{0};   // 提交超过这么久的行过期，0 = 不按时间
+    // 时钟采样 (墙上时间, 当时的提交水位)：按时间过期要换算成时间戳 (gc_mutex 保护)
+    struct ClockSample {
+        std::chrono::steady_clock::time_point when;
+        uint64_t ts;
+    };
+    std::deque<ClockSample> clock_samples;
+    std::thread gc_thread;
+    std::atomic<bool> gc_running{false};
+    std::mutex gc_cv_mutex;
+    std::condition_variable gc_cv;
+
+    // 封存信息：块写满且全部提交后，各列换成压缩编码
+    struct SealInfo {
+        std::atomic<bool> sealed{false};
+        uint64_t max_ts = 0;            // 块内最新的提交时间戳
+        bool has_invalidated = false;   // 封存时块里是否已有被折叠的行
+        size_t dead_at_seal = 0;        // 封存时的死亡行数 (之后变了说明又有行被折叠)
+        std::atomic<uint64_t> dropped_at{INF_TS}; // 按保留策略截断的时间戳，INF_TS = 没截断
+    };
+    SealInfo seal_info[MAX_CHUNKS];
+
+    // 映射进来的表文件 (列块和 MVCC 数组直接指向这里)
+    std::vector<std::unique_ptr<MappedFile>> mapped_files;
+
     // 锁 (仅保护 Schema 变更)
     mutable std::shared_mutex schema_lock;
 
 public:
-    using Value = std::variant<int, std::string>;
+    using Value = std::variant<int, std::string, std::monostate>;
 
     // 构造函数
     // truncate_log: true = 清空旧日志(新建表); false = 保留旧日志(用于恢复)
-    Table(std::string name, bool truncate_log = true) : table_name(name) {
-        std::string filename = name + ".log";
-        // 初始化二进制日志
-        logger = std::make_unique<BinaryLogger>(filename, truncate_log);
+    // durability: insertRow 返回前日志要落到什么程度 (见 BinaryLogger.h)
+    // log_streams: 并行日志流个数 (写线程按线程分到各个流，各流独立刷盘)
+    Table(std::string name, bool truncate_log = true, Durability durability = DURABILITY_ASYNC,
+          size_t log_streams = 1)
+        : Table(std::move(name), truncate_log, WalOptions{durability, log_streams, false}) {}
+
+    // 完整的日志选项 (见 BinaryLogger.h 的 WalOptions)
+    Table(std::string name, bool truncate_log, const WalOptions& wal_options) : table_name(name) {
+        // 初始化二进制日志 (目录 <name>.wal 下按流分段)
+        logger = std::make_unique<BinaryLogger>(table_name + ".wal", truncate_log, wal_options);
+
+        std::lock_guard<std::mutex> lock(live_tables_mutex);
+        live_tables[table_uid] = this;
+    }
+
+    ~Table() {
+        stopGarbageCollector();
+        {
+            std::lock_guard<std::mutex> lock(live_tables_mutex);
+            live_tables.erase(table_uid);
+        }
+
+        // 本线程的租约项一起删掉；别的线程的那份在它们下次碰到新表或退出时丢掉
+        if (LeaseHolder* holder = LeaseHolder::current) {
+            holder->leases.erase(table_uid);
+            if (holder->cached_uid == table_uid) {
+                holder->cached_uid = 0;
+                holder->cached = nullptr;
+            }
+        }
     }
 
+    // GC 的统计信息
+    struct GcStats {
+        size_t keys_folded = 0;         // 被折叠的 key 数
+        size_t versions_reclaimed = 0;  // 被折叠掉的旧版本行数
+        size_t chunks_freed = 0;        // 整块摘下的块数
+    };
+
     // DDL: 创建列
     void createColumn(const std::string& name, ColumnType type, AggType agg_type = AGG_LAST, bool has_index = false) {
         std::unique_lock lock(schema_lock);
@@ -331,56 +469,137 @@ public:
             columns[name] = std::make_unique<Column<std::string>>();
         }
 
-        // 2. 创建索引 (目前仅支持 String 索引)
-        if (has_index && type == TYPE_STRING) {
-            indexes[name] = std::make_unique<HashIndex>();
+        // 2. 索引槽 (目前仅支持 String 索引)：声明了索引就直接挂上，否则以后可以 createIndex 在线建
+        if (type == TYPE_STRING) {
+            IndexSlot& slot = indexes[name];
+            if (has_index) {
+                slot.owned = std::make_unique<HashIndex>();
+                slot.live.store(slot.owned.get());
+                if (gc_key_col.empty()) gc_key_col = name;
+            }
         }
     }
 
-    // DML: 插入数据 (支持日志开关)
-    // enable_logging: 正常写入为 true，恢复(Recover)时为 false
-    void insertRow(const std::vector<Value>& row_data, bool enable_logging = true) {
-        // 1. 领号 (Atomic)
-        size_t my_idx = tail_index.fetch_add(1);
+    // DDL: 给已经有数据的 STRING 列在线建索引 (建的过程中写入和查询照常进行)
+    // 1. 新索引先挂到 building 上：之后的写入两边都登记，查询还走原来的路
+    // 2. 等一个 RCU 宽限期：还没看到 building 的写入都已提交，下面的扫描一定能扫到它们
+    // 3. 按块并行扫描已提交的行批量登记 (和写入重复登记的行挂链时去重)
+    // 4. 换成 live，之后的点查走版本链
+    // 建的过程中 GC 暂停 (折叠和截断只改 live 的索引)；同一时间只建一个
+    void createIndex(const std::string& col_name) {
+        std::lock_guard<std::mutex> build_guard(index_build_mutex);
+        auto it = indexes.find(col_name);
+        if (it == indexes.end()) {
+            throw std::invalid_argument("Index requires a STRING column: " + col_name);
+        }
+        IndexSlot& slot = it->second;
+        if (slot.live.load()) throw std::invalid_argument("Column already has an index: " + col_name);
+
+        holdGc();
+        try {
+            slot.owned = std::make_unique<HashIndex>();
+            slot.building.store(slot.owned.get(), std::memory_order_release);
+            RcuDomain::synchronize();
+            {
+                // 快照保住扫描期间被封存换掉的旧块
+                Snapshot snap = openSnapshot();
+                std::shared_lock lock(schema_lock);
+                buildIndex(col_name, *slot.owned, 0, chunkCount(), 0);
+            }
+            // 先挂 live 再清 building：写入先读 building，读到空时一定也读到了 live
+            slot.live.store(slot.owned.get(), std::memory_order_release);
+            slot.building.store(nullptr, std::memory_order_release);
+        } catch (...) {
+            slot.building.store(nullptr, std::memory_order_release);
+            RcuDomain::synchronize();
+            slot.owned.reset();
+            releaseGc();
+            throw;
+        }
 
-        // 2. 自动扩容 (Chunking)
-        size_t chunk_idx = my_idx / CHUNK_SIZE;
-        meta.ensureChunk(chunk_idx);
-        for (auto& kv : columns) kv.second->ensureChunk(chunk_idx);
+        {
+            std::lock_guard<std::mutex> gc_guard(gc_mutex);
+            if (gc_key_col.empty()) gc_key_col = col_name;
+        }
+        releaseGc();
+    }
 
-        uint64_t tx_id = ++global_ts;
+    // --- Schema 查询 (给 SQL 层用；和 insertRow 一样不加锁，DDL 要在读写开始前做完) ---
+    const std::string& name() const { return table_name; }
+    size_t columnCount() const { return schema.size(); }
+    const std::string& columnName(size_t i) const { return schema[i].name; }
+    ColumnType columnType(size_t i) const { return schema[i].type; }
+    AggType columnAgg(size_t i) const { return schema[i].agg_type; }
+    bool hasIndex(const std::string& col_name) const { return liveIndex(col_name) != nullptr; }
 
-        // 3. 写入内存 & 更新索引
+    // 列序号，没有这一列返回 -1
+    int columnIndex(std::string_view col_name) const {
         for (size_t i = 0; i < schema.size(); ++i) {
-            const auto& col_name = schema[i].name;
-            const auto& val = row_data[i];
-
-            if (std::holds_alternative<int>(val)) {
-                columns[col_name]->set(my_idx, std::get<int>(val));
-            } else {
-                const std::string& s_val = std::get<std::string>(val);
-                columns[col_name]->set(my_idx, s_val);
-                
-                // 更新索引
-                if (indexes.find(col_name) != indexes.end()) {
-                    indexes[col_name]->insert(s_val, my_idx);
-                }
-            }
+            if (schema[i].name == col_name) return static_cast<int>(i);
         }
+        return -1;
+    }
 
-        // 4. 提交内存 (MVCC 生效)
-        meta.setCreated(my_idx, tx_id);
+    // DML: 插入数据 (支持日志开关)
+    // 值是 std::monostate 的列为 NULL：只带变了的列的增量行 (稀疏行)，AGG_LAST 查询时跳过它，日志里也不写
+    // enable_logging: 正常写入为 true，恢复(Recover)时为 false
+    // 返回前按表的持久化级别等日志落盘 (ASYNC 不等)
+    void insertRow(const std::vector<Value>& row_data, bool enable_logging = true) {
+        CommitToken token = insertRowAsync(row_data, enable_logging);
+        if (logger && logger->durabilityLevel() != DURABILITY_ASYNC) token.wait();
+    }
 
-        // 5. 写二进制日志 (WAL)
+    // 插入后立刻返回 (行已经可见)，不管表的持久化级别
+    // 返回的提交确认在覆盖这行的那次组提交 fdatasync 之后完成；不写日志时直接是完成状态
+    CommitToken insertRowAsync(const std::vector<Value>& row_data, bool enable_logging = true) {
+        // 1. 领号 (从本线程的租约里拿，租约用完才碰全局游标；块已在租约时分配好)
+        size_t my_idx = nextRowId();
+
+        uint64_t tx_id = commit_clock.issue();
+
+        // 2. 写入内存 & 更新索引 & 提交 (MVCC 生效)
+        //    写到一半出错 (类型不对) 时这一行作废，时间戳照样完成，提交水位不会卡住
+        try {
+            writeRow(my_idx, row_data, tx_id);
+        } catch (...) {
+            meta.markDead(my_idx);
+            commit_clock.finish(tx_id);
+            throw;
+        }
+        commit_clock.finish(tx_id);
+        Metrics::add(METRIC_INSERTS);
+
+        // 4. 写二进制日志 (WAL)，落盘确认交给调用方
         if (enable_logging && logger) {
-            logger->appendEntry(row_data);
+            return logger->appendEntry(row_data, tx_id);
         }
+        return CommitToken();
+    }
+
+    // 归还本线程在这张表上没用完的租约
+    // 剩下的行号标记为 DEAD_TS：永远不可见，也不会再被写入
+    // 不归还的话这些行号一直是 INF_TS，所在的块不能封存 (也就不能按保留策略截断)，GC 也不搬这块；
+    // 线程退出时会自动归还，线程不退出但不再写这张表时要自己调用 (或者 parkRowLease)
+    void releaseRowLease() {
+        RowLease& lease = localLease();
+        for (size_t i = lease.next; i < lease.end; ++i) meta.markDead(i);
+        lease.next = lease.end = 0;
+    }
+
+    // 语句结束时交还本线程没用完的租约 (SQL 的每条 INSERT / EXECUTE 之后调用)
+    // 剩下的行号挂到表上给下一个领租约的线程，不浪费；维护时落在已写满块里的部分标记为 DEAD_TS
+    void parkRowLease() {
+        RowLease& lease = localLease();
+        if (lease.next == lease.end) return;
+        std::lock_guard<std::mutex> lock(parked_mutex);
+        parked_leases.push_back(lease);
+        lease.next = lease.end = 0;
     }
 
     // 崩溃恢复
     void recover() {
-        std::string filename = table_name + ".log";
-        std::cout << "[System] Recovering table '" << table_name << "' from " << filename << "..." << std::endl;
+        std::string log_dir = table_name + ".wal";
+        std::cout << "[System] Recovering table '" << table_name << "' from " << log_dir << "..." << std::endl;
 
         // 准备 Schema 类型映射 (0:INT, 1:STRING)
         std::vector<int> col_types;
@@ -388,71 +607,1356 @@ public:
             col_types.push_back((col.type == TYPE_INT) ? 0 : 1);
         }
 
-        // 读取并重放
-        auto rows = BinaryLogger::readLog(filename, col_types);
+        // 读取并重放：每行按日志里的 lsn (原来的提交时间戳) 提交，不重新领号
+        // 领了没写日志的时间戳 (失败的写入、导入、截断) 留下的空洞照样空着，时钟接上最大的 lsn，
+        // 重启后的新提交不会和旧记录撞号，AS OF 的时间戳也和崩溃前一致
+        // 过期水位之前的行已经被 truncateExpired 截掉了，不再重放 (时钟照样接上)
+        // 调用方保证恢复期间没有别的写入
+        auto records = BinaryLogger::readLog(log_dir, col_types);
+        uint64_t expired = BinaryLogger::readExpiredHorizon(log_dir);
         int count = 0;
-        for (const auto& row : rows) {
-            insertRow(row, false); // false = 不再写日志
+        for (const auto& rec : records) {
+            if (rec.first <= expired) {
+                commit_clock.advanceTo(rec.first);
+                continue;
+            }
+            size_t my_idx = nextRowId();
+            try {
+                writeRow(my_idx, rec.second, rec.first);
+            } catch (...) {
+                meta.markDead(my_idx);
+                throw;
+            }
+            commit_clock.advanceTo(rec.first);
             count++;
         }
+        parkRowLease();
         std::cout << "[System] Recovery complete. Replayed " << count << " rows." << std::endl;
     }
 
-    // 快照查询 (带索引加速 + 混合聚合)
+    // 打开一个快照：句柄存活期间读到的都是同一时刻的数据，GC 也不会回收它还能看到的版本
+    Snapshot openSnapshot() {
+        return Snapshot(snapshots, commit_clock.committedClock());
+    }
+
+    // 历史快照 (AS OF)：读 ts 时刻已提交的数据，晚于当前时刻的 ts 按当前时刻算
+    // ts 早于 historyFloor() 时抛异常：那之前的版本可能已经被 GC 折叠了
+    // 句柄存活期间 GC 不会折叠 ts 时刻还能看到的版本，审计这种长查询可以一直拿着它
+    Snapshot openSnapshotAt(uint64_t ts) {
+        return Snapshot(snapshots, commit_clock.committedClock(), ts);
+    }
+
+    // 当前的提交时间戳 (最近一次提交的 ts)：记下来以后可以 AS OF 回到这一刻
+    uint64_t currentTimestamp() const { return commit_clock.committedTimestamp(); }
+
+    // 最早还能 AS OF 读的时间戳 (GC 发出过的最大低水位)
+    uint64_t historyFloor() { return snapshots.historyFloor(); }
+
+    // GC 在低水位之前再保留 timestamps 个时间戳的历史 (0 = 不保留，默认)
+    // 保留期内的旧版本不会被折叠，AS OF 能回到 currentTimestamp() - timestamps
+    void setHistoryRetention(uint64_t timestamps) { history_retention.store(timestamps); }
+
+    // 保留策略 (TTL)：提交时间戳早于 min_ts 的行过期 (0 = 关掉)
+    void setRetentionTimestamp(uint64_t min_ts) { retention_min_ts.store(min_ts); }
+
+    // 保留策略 (TTL)：提交超过 age 的行过期 (0 = 关掉)
+    // 行上不记墙上时间：truncateExpired 每次记一个 (时间, 时间戳) 采样，过期按采样换算，最多晚 age/64 生效
+    void setRetentionAge(std::chrono::milliseconds age) { retention_age_ms.store(age.count()); }
+
+    // 快照查询 (读当前最新数据)
     std::unordered_map<std::string, std::string> querySnapshot(const std::string& key_col_name, const std::string& key_val) {
-        uint64_t query_ts = global_ts.load();
-        
-        std::unordered_map<std::string, std::string> result;
-        std::unordered_map<std::string, uint64_t> last_seen_ts;
-        std::vector<size_t> candidate_rows;
+        Snapshot snap = openSnapshot();
+        return querySnapshot(key_col_name, key_val, snap);
+    }
 
-        // A. 索引加速
-        if (indexes.find(key_col_name) != indexes.end()) {
-            candidate_rows = indexes[key_col_name]->get(key_val);
-        } else {
-            // B. 全表扫描
+    // 快照查询 (读指定快照)
+    std::unordered_map<std::string, std::string> querySnapshot(const std::string& key_col_name, const std::string& key_val, const Snapshot& snap) {
+        return readStable([&] { return queryAt(key_col_name, key_val, snap.timestamp()); });
+    }
+
+    // 批量点查 (读当前最新数据)：results[i] 和 querySnapshot(key_col_name, keys[i]) 一样
+    // 一批几百个 key 时比逐个调用快得多：哈希、加分片锁和各级访存都批量做，缓存未命中互相重叠
+    std::vector<std::unordered_map<std::string, std::string>> multiGet(const std::string& key_col_name, const std::vector<std::string>& keys) {
+        Snapshot snap = openSnapshot();
+        return multiGet(key_col_name, keys, snap);
+    }
+
+    // 批量点查 (读指定快照)：每 MULTI_GET_GROUP 个 key 一组，一组在一个顺序锁读里
+    std::vector<std::unordered_map<std::string, std::string>> multiGet(const std::string& key_col_name, const std::vector<std::string>& keys,
+                                                                       const Snapshot& snap) {
+        std::vector<std::unordered_map<std::string, std::string>> results;
+        results.reserve(keys.size());
+        for (size_t first = 0; first < keys.size(); first += MULTI_GET_GROUP) {
+            size_t n = std::min(MULTI_GET_GROUP, keys.size() - first);
+            readStable([&] {
+                results.resize(first); // 重试时丢掉上次做了一半的这一组
+                queryBatchAt(key_col_name, keys.data() + first, n, snap.timestamp(),
+                             [&](size_t k, const PointMerge& m, const std::vector<PointColumn>& cols) {
+                                 results.push_back(finishMerge(m, cols, key_col_name, keys[first + k]));
+                             });
+                return true;
+            });
+        }
+        return results;
+    }
+
+    // 批量点查，结果按列放 (和 SELECT 一样的 QueryResult)：不用给每个 key 建一个 map，值直接追加到列里
+    // 列按 schema 顺序；每个在快照里有可见版本的 key 一行，顺序和 keys 一样，没有可见版本的 key 不出结果
+    // NULL 和 SELECT 一样给类型的零值
+    QueryResult multiGetColumns(const std::string& key_col_name, const std::vector<std::string>& keys, const Snapshot& snap) {
+        QueryResult result;
+        std::vector<int> slot_of; // schema 第 i 列在合并状态里的下标，key 列是 -1
+        int next_slot = 0;
+        for (const auto& s : schema) {
+            result.columns.push_back({s.name, s.type, {}, {}});
+            slot_of.push_back(s.name == key_col_name ? -1 : next_slot++);
+        }
+
+        for (size_t first = 0; first < keys.size(); first += MULTI_GET_GROUP) {
+            size_t n = std::min(MULTI_GET_GROUP, keys.size() - first);
+            size_t mark = result.rowCount();
+            readStable([&] {
+                for (auto& col : result.columns) {
+                    col.ints.resize(std::min(col.ints.size(), mark));
+                    col.strings.resize(std::min(col.strings.size(), mark));
+                }
+                queryBatchAt(key_col_name, keys.data() + first, n, snap.timestamp(),
+                             [&](size_t k, const PointMerge& m, const std::vector<PointColumn>& cols) {
+                                 if (!m.merged) return;
+                                 for (size_t c = 0; c < result.columns.size(); ++c) {
+                                     ResultColumn& out = result.columns[c];
+                                     if (slot_of[c] < 0) {
+                                         out.strings.push_back(keys[first + k]);
+                                         continue;
+                                     }
+                                     const PointColumn& pc = cols[slot_of[c]];
+                                     const PointSlot& slot = m.slots[slot_of[c]];
+                                     bool has = pc.agg == AGG_SUM || slot.last_row != NO_VERSION;
+                                     if (out.type == TYPE_INT) {
+                                         out.ints.push_back(pc.agg == AGG_SUM ? slot.sum : has ? pc.ints->get(slot.last_row) : 0);
+                                     } else if (has && pc.agg != AGG_SUM) {
+                                         out.strings.push_back(pc.strs->get(slot.last_row));
+                                     } else {
+                                         out.strings.emplace_back();
+                                     }
+                                 }
+                             });
+                return true;
+            });
+        }
+        return result;
+    }
+
+    // 快照查询，同时记下走了索引还是全表扫描、候选行数、不可见行数和合并耗时 (EXPLAIN ANALYZE)
+    std::unordered_map<std::string, std::string> querySnapshot(const std::string& key_col_name, const std::string& key_val,
+                                                               const Snapshot& snap, QueryProfile* profile) {
+        return readStable([&] { return queryAt(key_col_name, key_val, snap.timestamp(), profile); });
+    }
+
+    // 全表求和 (例如 AGG_SUM 列的总库存)
+    // 封存块整块对快照可见且没有被折叠的行时，直接在压缩数据上求和；否则逐行判可见性
+    int64_t sumColumn(const std::string& col_name, const Snapshot& snap) {
+        std::shared_lock lock(schema_lock);
+        auto it = columns.find(col_name);
+        auto* col = (it == columns.end()) ? nullptr : dynamic_cast<Column<int>*>(it->second.get());
+        if (!col) throw std::runtime_error("sumColumn: '" + col_name + "' is not an INT column");
+        uint64_t ts = snap.timestamp();
+
+        return readStable([&] {
+            int64_t total = 0;
             size_t limit = tail_index.load();
-            candidate_rows.reserve(limit);
-            for(size_t i=0; i<limit; ++i) candidate_rows.push_back(i);
+            for (size_t c = 0; c * CHUNK_SIZE < limit; ++c) {
+                if (!meta.hasChunk(c)) continue;
+                const SealInfo& info = seal_info[c];
+                if (info.sealed.load(std::memory_order_acquire) && info.max_ts <= ts && !info.has_invalidated &&
+                    meta.deadRows(c) == info.dead_at_seal && info.dropped_at.load(std::memory_order_acquire) == INF_TS) {
+                    total += col->sumChunk(c); // 空洞行的值是 0，不影响求和
+                    continue;
+                }
+                size_t end = meta.bornEnd(c, ts); // 历史快照：块里 end 之后的行那时都还没提交
+                if (end == 0) continue;
+                size_t base = c * CHUNK_SIZE;
+                col->scanChunk(c, [&](size_t offset, int v) {
+                    if (offset < end && meta.isVisible(base + offset, ts)) total += v;
+                });
+            }
+            return total;
+        });
+    }
+
+    // 封存：把写满且每行都有结论 (已提交或空洞) 的块换成压缩编码，返回这次封存的块数
+    // 表是 insert-only 的，这样的块以后不会再被写
+    // 和 GC 一样拿 gc_mutex (同样的加锁顺序)：封存之间不会撞车，算 has_invalidated 时 GC 也不会同时折叠
+    size_t sealChunks() {
+        std::lock_guard<std::mutex> gc_guard(gc_mutex);
+        std::shared_lock lock(schema_lock);
+        settleParkedLeases();
+        size_t sealed_now = 0;
+        size_t full_chunks = tail_index.load() / CHUNK_SIZE;
+
+        for (size_t c = 0; c < full_chunks; ++c) {
+            SealInfo& info = seal_info[c];
+            if (info.sealed.load(std::memory_order_acquire) || !meta.hasChunk(c)) continue;
+
+            uint64_t max_ts = 0;
+            bool settled = true;
+            bool has_invalidated = false;
+            for (size_t i = c * CHUNK_SIZE; i < (c + 1) * CHUNK_SIZE; ++i) {
+                uint64_t born = meta.getCreated(i);
+                if (born == INF_TS) {
+                    settled = false; // 还有行没写完 (或者租约没归还)
+                    break;
+                }
+                if (born != DEAD_TS) max_ts = std::max(max_ts, born);
+                if (meta.getInvalidated(i) != INF_TS) has_invalidated = true;
+            }
+            if (!settled) continue;
+
+            std::vector<std::function<void()>> deleters;
+            for (auto& kv : columns) {
+                if (auto d = kv.second->sealChunk(c)) deleters.push_back(std::move(d));
+            }
+            meta.summarize(c);
+            info.max_ts = max_ts;
+            info.has_invalidated = has_invalidated;
+            info.dead_at_seal = meta.deadRows(c);
+            info.sealed.store(true, std::memory_order_release);
+
+            // 原始块可能还有读者，等他们退出再释放
+            snapshots.retire([deleters] {
+                for (auto& d : deleters) d();
+            });
+            sealed_now++;
         }
+        snapshots.reclaim();
+        return sealed_now;
+    }
 
-        auto* key_col = dynamic_cast<Column<std::string>*>(columns[key_col_name].get());
+    // --- 列存表文件 (Checkpoint) ---
+    // 把整张表按块布局写成一个文件，重启时 loadCheckpoint 直接 mmap，不用重放整个日志
+    // 调用方保证写文件期间没有并发 insert (和 DDL 一样)；还没写完的租约空洞在文件里记为 DEAD
+    // 写完后日志里的数据已经全部在文件里，WAL 清空
+    void saveCheckpoint(const std::string& path) {
+        // 快照保住写文件期间还在读的块 (和 createIndex 一样)，gc_mutex 挡住 GC 和封存改版本、换块
+        Snapshot snap = openSnapshot();
+        std::lock_guard<std::mutex> gc_guard(gc_mutex);
+        std::shared_lock lock(schema_lock);
+
+        std::string tmp_path = path + ".tmp";
+        TableFileWriter writer(tmp_path);
+
+        // 1. Schema
+        std::vector<char> schema_bytes;
+        for (const auto& s : schema) {
+            uint32_t len = static_cast<uint32_t>(s.name.size());
+            schema_bytes.push_back(static_cast<char>(s.type));
+            schema_bytes.push_back(static_cast<char>(s.agg_type));
+            schema_bytes.insert(schema_bytes.end(), reinterpret_cast<const char*>(&len), reinterpret_cast<const char*>(&len) + sizeof(len));
+            schema_bytes.insert(schema_bytes.end(), s.name.begin(), s.name.end());
+        }
+        RegionEntry schema_entry{};
+        schema_entry.kind = REGION_SCHEMA;
+        schema_entry.count = static_cast<uint32_t>(schema.size());
+        schema_entry.aux = snapshots.historyFloor(); // 比它早的历史可能已经被折叠，重启后也不能 AS OF 过去
+        writer.writeRegion(schema_entry, schema_bytes.data(), schema_bytes.size());
+
+        // 2. 每一块：MVCC 时间戳 + 每列的数据 (已被 GC 回收的块跳过)
+        size_t num_chunks = (tail_index.load() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        std::vector<uint64_t> created(CHUNK_SIZE);
+        for (size_t c = 0; c < num_chunks; ++c) {
+            const uint64_t* born = meta.createdChunk(c);
+            const uint64_t* died = meta.invalidatedChunk(c);
+            if (!born || !died) continue;
+
+            RegionEntry ts_entry{};
+            ts_entry.chunk = static_cast<uint32_t>(c);
+            ts_entry.count = static_cast<uint32_t>(CHUNK_SIZE);
+            uint32_t dead = 0;
+            for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+                created[i] = (born[i] == INF_TS) ? DEAD_TS : born[i];
+                if (created[i] == DEAD_TS || died[i] != INF_TS) dead++;
+                if (created[i] != DEAD_TS) ts_entry.aux = std::max(ts_entry.aux, created[i]);
+                if (died[i] != INF_TS) ts_entry.flags = 1;
+            }
+            ts_entry.num_values = dead;
+
+            ts_entry.kind = REGION_CREATED;
+            writer.writeRegion(ts_entry, created.data(), CHUNK_SIZE * sizeof(uint64_t));
+            ts_entry.kind = REGION_INVALIDATED;
+            writer.writeRegion(ts_entry, died, CHUNK_SIZE * sizeof(uint64_t));
 
-        for (size_t i : candidate_rows) {
-            // MVCC & Key 检查
-            if (!meta.isVisible(i, query_ts)) continue;
-            if (key_col->get(i) != key_val) continue;
+            for (size_t i = 0; i < schema.size(); ++i) {
+                columns[schema[i].name]->saveChunk(c, writer, static_cast<uint32_t>(i));
+            }
+        }
+        writer.finish(commit_clock.issuedTimestamp(), num_chunks);
 
-            uint64_t row_ts = meta.getCreated(i);
+        // 3. 原子替换：崩在中途也不会留下半个文件
+        //    改名要先落盘再清 WAL，否则崩溃后可能是旧文件 + 空日志
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Failed to rename table file to " + path);
+        }
+        syncParentDirectory(path);
+        if (logger) logger->truncate();
+    }
 
-            // 混合聚合逻辑
-            for (const auto& s : schema) {
-                if (s.name == key_col_name) continue;
+    // 映射表文件：表必须是空的，且 Schema 已经定义好 (和 recover() 一样)
+    // 数据直接留在 page cache 里，访问到哪一页才读哪一页；之后可以 recover() 重放 checkpoint 之后的日志
+    void loadCheckpoint(const std::string& path) {
+        std::unique_lock lock(schema_lock);
+        if (tail_index.load() != 0) throw std::runtime_error("loadCheckpoint requires an empty table");
 
-                if (s.agg_type == AGG_SUM) {
-                    // Delta Accumulation
-                    auto* col = dynamic_cast<Column<int>*>(columns[s.name].get());
-                    int val = col->get(i);
-                    int old_sum = 0;
-                    if (result.find(s.name) != result.end()) old_sum = std::stoi(result[s.name]);
-                    result[s.name] = std::to_string(old_sum + val);
-                } 
-                else if (s.agg_type == AGG_LAST) {
-                    // MVCC Overwrite
-                    if (row_ts > last_seen_ts[s.name]) {
-                        if (s.type == TYPE_INT) {
-                            auto* col = dynamic_cast<Column<int>*>(columns[s.name].get());
-                            result[s.name] = std::to_string(col->get(i));
-                        } else {
-                            auto* col = dynamic_cast<Column<std::string>*>(columns[s.name].get());
-                            result[s.name] = col->get(i);
-                        }
-                        last_seen_ts[s.name] = row_ts;
+        auto file = std::make_unique<MappedFile>(path);
+        const TableFileFooter& footer = file->footer();
+        if (std::memcmp(footer.magic, TABLE_FILE_MAGIC, sizeof(TABLE_FILE_MAGIC)) != 0 ||
+            std::memcmp(file->base(), TABLE_FILE_MAGIC, sizeof(TABLE_FILE_MAGIC)) != 0) {
+            throw std::runtime_error("Not a HavanaDB table file: " + path);
+        }
+        if (file->version() != TABLE_FILE_VERSION) {
+            throw std::runtime_error("Unsupported table file version " + std::to_string(file->version()) + ": " + path);
+        }
+        if (footer.num_chunks > MAX_CHUNKS) throw std::out_of_range("Exceeded DB Max Capacity");
+        if (!file->directoryValid()) throw std::runtime_error("Corrupted table file: " + path);
+
+        char* base = file->base();
+        const RegionEntry* dir = file->directory();
+        std::vector<const RegionEntry*> created(footer.num_chunks, nullptr);
+        std::vector<const RegionEntry*> invalidated(footer.num_chunks, nullptr);
+
+        // 先把目录整个检查一遍再动表：位置、块号、列号和列类型都要对得上，坏文件不会写出界
+        auto corrupt = [&](size_t e) {
+            return std::runtime_error("Corrupted table file: " + path + " (region " + std::to_string(e) + ")");
+        };
+        for (size_t e = 0; e < footer.dir_count; ++e) {
+            const RegionEntry& entry = dir[e];
+            if (!file->regionValid(entry)) throw corrupt(e);
+            switch (entry.kind) {
+                case REGION_SCHEMA:
+                    break;
+                case REGION_CREATED:
+                case REGION_INVALIDATED:
+                    if (entry.chunk >= footer.num_chunks || entry.length != CHUNK_SIZE * sizeof(uint64_t) ||
+                        entry.num_values > CHUNK_SIZE) {
+                        throw corrupt(e);
                     }
+                    break;
+                case REGION_INT_CHUNK:
+                case REGION_STR_CHUNK:
+                case REGION_NULL_BITMAP:
+                    if (entry.chunk >= footer.num_chunks || entry.column >= schema.size()) throw corrupt(e);
+                    if (entry.kind != REGION_NULL_BITMAP &&
+                        (entry.count != CHUNK_SIZE || entry.bits > 32 ||
+                         (entry.kind == REGION_INT_CHUNK) != (schema[entry.column].type == TYPE_INT))) {
+                        throw corrupt(e);
+                    }
+                    break;
+                default:
+                    throw std::runtime_error("Unknown region in table file: " + path);
+            }
+        }
+
+        for (size_t e = 0; e < footer.dir_count; ++e) {
+            const RegionEntry& entry = dir[e];
+            switch (entry.kind) {
+                case REGION_SCHEMA:
+                    checkSchema(base + entry.offset, entry.length, entry.count);
+                    snapshots.raiseHistoryFloor(entry.aux);
+                    break;
+                case REGION_CREATED:
+                    created[entry.chunk] = &entry;
+                    break;
+                case REGION_INVALIDATED:
+                    invalidated[entry.chunk] = &entry;
+                    break;
+                case REGION_INT_CHUNK:
+                case REGION_STR_CHUNK:
+                case REGION_NULL_BITMAP:
+                    columns[schema.at(entry.column).name]->mapChunk(entry.chunk, entry, base);
+                    break;
+                default:
+                    throw std::runtime_error("Unknown region in table file: " + path);
+            }
+        }
+
+        // MVCC 时间戳直接用映射内存；文件里的块都已经写完，标记为封存
+        for (size_t c = 0; c < footer.num_chunks; ++c) {
+            if (!created[c] || !invalidated[c]) continue;
+            meta.mapChunk(c, reinterpret_cast<uint64_t*>(base + created[c]->offset),
+                          reinterpret_cast<uint64_t*>(base + invalidated[c]->offset), created[c]->num_values);
+            seal_info[c].max_ts = created[c]->aux;
+            seal_info[c].has_invalidated = created[c]->flags & 1;
+            seal_info[c].dead_at_seal = created[c]->num_values;
+            meta.summarize(c);
+            seal_info[c].sealed.store(true, std::memory_order_release);
+        }
+
+        // 新写入从文件之后的整块开始
+        tail_index.store(footer.num_chunks * CHUNK_SIZE);
+        commit_clock.advanceTo(footer.global_ts);
+        mapped_files.push_back(std::move(file));
+
+        rebuildIndexes(0, footer.num_chunks);
+    }
+
+    // 所有列数据占用的内存 (字节，估算)
+    size_t dataMemoryBytes() const {
+        std::shared_lock lock(schema_lock);
+        size_t total = 0;
+        for (const auto& kv : columns) total += kv.second->memoryBytes();
+        return total;
+    }
+
+    // --- 查询执行接口 (Query.h 的算子用) ---
+    // 在一致的视图下跑一次只读计算：持有 schema 读锁，碰上 GC 切换一批版本就整体重做
+    // fn 可能被执行多次，不能有副作用 (结果先收集起来，返回后再输出)
+    template <typename Fn>
+    auto readConsistent(Fn&& fn) -> decltype(fn()) {
+        std::shared_lock lock(schema_lock);
+        return readStable(fn);
+    }
+
+    // 流式游标分很多批读同一个快照：期间 GC 不能折叠版本，否则一行会在两批之间被合并掉或者读到两次
+    // holdGc / releaseGc 成对调用；拿 gc_mutex 登记，保证不会和正在进行的一轮 GC 交错
+    void holdGc() {
+        std::lock_guard<std::mutex> gc_guard(gc_mutex);
+        gc_holds++;
+    }
+
+    void releaseGc() { gc_holds--; }
+
+    // 已经租出去的行号覆盖到的块数 (块可能已被 GC 回收，要看 hasChunk)
+    size_t chunkCount() const {
+        return (tail_index.load() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    }
+
+    bool hasChunk(size_t chunk_idx) const { return meta.hasChunk(chunk_idx); }
+
+    // 已经租出去的行号数 (含空洞和未提交的行)
+    size_t rowLimit() const { return tail_index.load(); }
+
+    bool isVisible(size_t row_idx, uint64_t ts) const { return meta.isVisible(row_idx, ts); }
+
+    // 块内偏移 >= 返回值的行在 ts 时都还没提交，扫描停在这里就够了 (0 = 整块跳过)
+    // 按封存时算好的提交时间戳范围二分；还在写的块返回 CHUNK_SIZE
+    size_t scanEnd(size_t chunk_idx, uint64_t ts) const { return meta.bornEnd(chunk_idx, ts); }
+
+    // 块内 [begin, end) 里对 ts 可见的行，块内偏移追加到 out (升序)
+    // 直接扫两个时间戳数组，无分支压缩，编译器可以向量化
+    void visibleOffsets(size_t chunk_idx, size_t begin, size_t end, uint64_t ts, std::vector<uint32_t>& out) const {
+        const uint64_t* born = meta.createdChunk(chunk_idx);
+        const uint64_t* died = meta.invalidatedChunk(chunk_idx);
+        if (!born || !died) return;
+        size_t n = out.size();
+        out.resize(n + (end - begin));
+        uint32_t* dst = out.data();
+        for (size_t i = begin; i < end; ++i) {
+            dst[n] = static_cast<uint32_t>(i);
+            n += (born[i] <= ts) & (died[i] > ts); // 空洞 (DEAD_TS) 和未提交 (INF_TS) 都大于任何快照
+        }
+        out.resize(n);
+    }
+
+    // 块内这些偏移的提交时间戳 (LAST 聚合按它取最新版本)
+    void createdTimestamps(size_t chunk_idx, const uint32_t* offs, size_t n, uint64_t* out) const {
+        const uint64_t* born = meta.createdChunk(chunk_idx);
+        for (size_t i = 0; i < n; ++i) out[i] = born ? born[offs[i]] : 0;
+    }
+
+    // 第 i 列的存储 (按 columnType 转成 Column<int> / Column<std::string>)
+    const AbstractColumn* column(size_t i) const {
+        return columns.at(schema[i].name).get();
+    }
+
+    // 索引查 key 的候选行 (可能含不可见的版本)；这一列没有索引时返回空
+    std::vector<size_t> indexLookup(const std::string& col_name, const std::string& key) {
+        HashIndex* index = liveIndex(col_name);
+        if (!index) return {};
+        return index->get(key);
+    }
+
+    // --- 批量导入接口 (BulkLoader.h 用) ---
+    // 流程：reserveChunks 预留整块 -> 直接往 Column::chunkData 里写 -> commitBulk 一次提交 (出错则 abortBulk)
+    // 和 DDL 一样，导入期间不能改 Schema；普通 insert 可以并发，它们拿到的行号在预留区间之后
+
+    // 在表尾预留 num_chunks 个整块，返回第一块的块号
+    // 预留从块边界开始，前面那块没租出去的零头标成空洞 (否则那块永远封存不了)
+    // 块全部分配好，行的 created 都还是 INF_TS，读者看不见
+    size_t reserveChunks(size_t num_chunks) {
+        size_t cur = tail_index.load();
+        size_t start;
+        do {
+            start = (cur + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE;
+            if (start / CHUNK_SIZE + num_chunks > MAX_CHUNKS) throw std::out_of_range("Exceeded DB Max Capacity");
+        } while (!tail_index.compare_exchange_weak(cur, start + num_chunks * CHUNK_SIZE));
+
+        // 零头那块由领到它前半截的写线程分配，但它可能刚 fetch_add 完还没来得及分配
+        size_t first = (cur < start) ? cur / CHUNK_SIZE : start / CHUNK_SIZE;
+        for (size_t c = first; c < start / CHUNK_SIZE + num_chunks; ++c) {
+            meta.ensureChunk(c);
+            for (auto& kv : columns) kv.second->ensureChunk(c);
+        }
+        for (size_t i = cur; i < start; ++i) meta.markDead(i);
+        return start / CHUNK_SIZE;
+    }
+
+    // 第 i 列的存储 (可写，批量导入直接写块)
+    AbstractColumn* mutableColumn(size_t i) {
+        return columns.at(schema[i].name).get();
+    }
+
+    // 提交预留区间 [first_row, end_row) 里的前 rows 行，后面剩下的标成空洞
+    // 1. 先登记索引，2. 再在顺序锁内把所有行的 created 设成同一个时间戳：
+    //    快照要么一行都看不到，要么全部看到 (正在扫描的读者碰上切换会重读)
+    // 返回这次导入的提交时间戳
+    uint64_t commitBulk(size_t first_row, size_t rows, size_t end_row) {
+        std::lock_guard<std::mutex> gc_guard(gc_mutex); // GC 也写顺序锁，不能同时切换
+        std::shared_lock lock(schema_lock);
+        RcuReadGuard rcu_guard; // 和 insertRow 一样：在线建索引等这次登记 + 提交做完再扫描
+        for (size_t i = first_row + rows; i < end_row; ++i) meta.markDead(i);
+        uint64_t ts = commit_clock.issue(); // 先领时间戳：版本链按它排
+        try {
+            rebuildIndexes(first_row / CHUNK_SIZE, (end_row + CHUNK_SIZE - 1) / CHUNK_SIZE, ts);
+        } catch (...) {
+            commit_clock.finish(ts); // 行还是 INF_TS，调用方 abortBulk
+            throw;
+        }
+
+        uint64_t seq = gc_seq.load(std::memory_order_relaxed);
+        gc_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        meta.setCreatedRange(first_row, first_row + rows, ts);
+        gc_seq.store(seq + 2, std::memory_order_release);
+        commit_clock.finish(ts);
+        return ts;
+    }
+
+    // 导入的行写进 WAL (都用提交时间戳 ts，恢复时逐行重放)；和 insertRow 一样按表的持久化级别等落盘
+    // 导入后不写 checkpoint 时靠它持久化，否则崩溃恢复只重放得出导入之后的普通写入
+    void logBulk(size_t first_row, size_t rows, uint64_t ts) {
+        if (!logger) return;
+        std::shared_lock lock(schema_lock);
+        std::vector<const Column<int>*> ints(schema.size(), nullptr);
+        std::vector<const Column<std::string>*> strs(schema.size(), nullptr);
+        for (size_t i = 0; i < schema.size(); ++i) {
+            const AbstractColumn* col = columns.at(schema[i].name).get();
+            if (schema[i].type == TYPE_INT) ints[i] = dynamic_cast<const Column<int>*>(col);
+            else strs[i] = dynamic_cast<const Column<std::string>*>(col);
+        }
+
+        std::vector<Value> row(schema.size());
+        CommitToken token;
+        for (size_t r = first_row; r < first_row + rows; ++r) {
+            for (size_t i = 0; i < schema.size(); ++i) {
+                if (ints[i]) {
+                    if (ints[i]->isNull(r)) row[i] = std::monostate{};
+                    else row[i] = ints[i]->get(r);
+                } else {
+                    if (strs[i]->isNull(r)) row[i] = std::monostate{};
+                    else row[i] = strs[i]->get(r);
+                }
+            }
+            token = logger->appendEntry(row, ts);
+        }
+        if (logger->durabilityLevel() != DURABILITY_ASYNC) token.wait();
+    }
+
+    // 导入失败：整个预留区间标成空洞，永远不可见 (块照样可以封存、回收)
+    void abortBulk(size_t first_row, size_t end_row) {
+        for (size_t i = first_row; i < end_row; ++i) meta.markDead(i);
+    }
+
+    // --- 旧版本回收 (GC) ---
+    // 1. 折叠：同一个 key 在低水位之前的所有版本合并成表尾的一行
+    //    (AGG_LAST 取最新版本，AGG_SUM 求和)，新行的时间戳等于被折叠的最新版本，
+    //    所以对任何不早于低水位的快照来说结果都不变
+    // 2. 搬迁：活行很少的块，把剩下的行也折叠走
+    // 3. 回收：整块都死掉的块从所有列和 MVCC 上摘下，等旧读者退出后释放
+    GcStats collectGarbage() {
+        std::lock_guard<std::mutex> gc_guard(gc_mutex);
+        std::shared_lock lock(schema_lock);
+        GcStats stats;
+        if (gc_key_col.empty()) return stats;
+        if (gc_holds.load() > 0) return stats; // 有游标在分批读，这一轮跳过
+        settleParkedLeases();
+
+        uint64_t watermark = snapshots.lowWatermark(commit_clock.committedClock(), history_retention.load());
+
+        // 1. 多版本 key
+        foldKeys(liveIndex(gc_key_col)->keysWithRows(2), 2, watermark, stats);
+
+        // 2. 稀疏块里剩下的 key (只有一个版本也要搬)
+        foldKeys(compactionKeys(watermark), 1, watermark, stats);
+
+        // 3. 整块都死了：摘下来
+        size_t chunk_limit = (tail_index.load() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        for (size_t c = 0; c < chunk_limit; ++c) {
+            if (!meta.hasChunk(c) || meta.deadRows(c) != CHUNK_SIZE) continue;
+
+            retireChunk(c);
+            stats.chunks_freed++;
+        }
+
+        // 4. 释放已经没有读者的块；折叠行用剩的租约交还给表，不挡封存
+        snapshots.reclaim();
+        parkRowLease();
+        return stats;
+    }
+
+    // 按保留策略截掉过期的块，返回这一轮摘掉的块数
+    // 只看封存过的块，不搬任何行；截断等同于在一个截断时间戳 drop_ts 上删除整块：
+    // 1. 块里最新的提交都已过期：活行在新领的 drop_ts 上失效，之后的快照看不到它们 (AGG_SUM 的累计值也不再包含)，
+    //    更早的快照 (包括 AS OF) 照样读得到
+    // 2. 低水位越过 drop_ts (没有快照还要读它们，historyFloor 也跟着越过) 以后才整块摘下 (列、MVCC、索引版本链)
+    // WAL 里还留着这些行：摘块前把块里最大的提交时间戳记成日志的过期水位，恢复时跳过水位之前的行
+    // (按时间过期的采样不落盘，重放回来的行要再等一整个保留期才会过期)
+    size_t truncateExpired() {
+        std::lock_guard<std::mutex> gc_guard(gc_mutex);
+        std::shared_lock lock(schema_lock);
+        uint64_t cutoff = retentionCutoff();
+        if (gc_holds.load() > 0) return 0;
+
+        size_t full_chunks = tail_index.load() / CHUNK_SIZE;
+        bool pending = false;
+        std::vector<size_t> expired;
+        uint64_t horizon = 0;
+        for (size_t c = 0; c < full_chunks; ++c) {
+            SealInfo& info = seal_info[c];
+            if (!info.sealed.load(std::memory_order_acquire) || !meta.hasChunk(c)) continue;
+            if (info.dropped_at.load(std::memory_order_relaxed) != INF_TS) {
+                pending = true;
+                continue;
+            }
+            const BornRange* range = meta.bornRange(c);
+            if (cutoff == 0 || !range || range->max_ts > cutoff) continue;
+            expired.push_back(c);
+            horizon = std::max(horizon, range->max_ts);
+        }
+        if (!expired.empty()) {
+            if (logger) logger->saveExpiredHorizon(horizon);
+            for (size_t c : expired) dropChunk(c);
+            pending = true;
+        }
+        if (!pending) return 0;
+
+        size_t retired = 0;
+        uint64_t watermark = snapshots.lowWatermark(commit_clock.committedClock(), history_retention.load());
+        for (size_t c = 0; c < full_chunks; ++c) {
+            uint64_t drop_ts = seal_info[c].dropped_at.load(std::memory_order_relaxed);
+            if (drop_ts == INF_TS || drop_ts > watermark || !meta.hasChunk(c)) continue;
+
+            // 一块一次顺序锁：走版本链的点查和扫描碰上就重来
+            uint64_t seq = gc_seq.load(std::memory_order_relaxed);
+            gc_seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            eraseChunkFromIndexes(c, drop_ts);
+            retireChunk(c);
+            gc_seq.store(seq + 2, std::memory_order_release);
+            retired++;
+        }
+        snapshots.reclaim();
+        return retired;
+    }
+
+    // 后台维护线程：每 interval_ms 跑一轮 collectGarbage + sealChunks + truncateExpired
+    void startGarbageCollector(int interval_ms = 100) {
+        if (gc_running.exchange(true)) return;
+        gc_thread = std::thread([this, interval_ms] {
+            while (gc_running) {
+                {
+                    std::unique_lock<std::mutex> lock(gc_cv_mutex);
+                    gc_cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this] { return !gc_running; });
                 }
+                if (!gc_running) break;
+                collectGarbage();
+                sealChunks();
+                truncateExpired();
+            }
+            // 折叠行用的是 GC 线程自己的租约
+            releaseRowLease();
+        });
+    }
+
+    void stopGarbageCollector() {
+        if (!gc_running.exchange(false)) return;
+        gc_cv.notify_all();
+        if (gc_thread.joinable()) gc_thread.join();
+    }
+
+private:
+    // 列上查询能用的索引，没有 (或还在建) 返回 nullptr
+    HashIndex* liveIndex(const std::string& col_name) const {
+        auto it = indexes.find(col_name);
+        return it == indexes.end() ? nullptr : it->second.live.load(std::memory_order_acquire);
+    }
+
+    // 对每个可用的索引调用 fn(列名, 索引) (GC 摘版本 / 回收块用，建索引期间 GC 不跑)
+    template <typename Fn>
+    void forEachIndex(Fn&& fn) {
+        for (auto& kv : indexes) {
+            if (HashIndex* index = kv.second.live.load(std::memory_order_acquire)) fn(kv.first, *index);
+        }
+    }
+
+    // 顺序锁读：碰上 GC 切换一批版本的瞬间，结果作废重读
+    template <typename Fn>
+    auto readStable(Fn&& fn) -> decltype(fn()) {
+        while (true) {
+            uint64_t seq = gc_seq.load(std::memory_order_acquire);
+            if (seq & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto result = fn();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (gc_seq.load(std::memory_order_relaxed) == seq) return result;
+        }
+    }
+
+    // 点查合并用的列 (schema 顺序，跳过 key 列)：指针在一次查询开始时取好，合并一行不再按列名查 map
+    struct PointColumn {
+        const std::string* name;
+        AggType agg;
+        const Column<int>* ints;          // INT 列，否则为空
+        const Column<std::string>* strs;  // STRING 列，否则为空
+    };
+
+    // 一列的合并状态：AGG_SUM 列累加，AGG_LAST 列只记下取中的行，最后 finishMerge 再取值
+    struct PointSlot {
+        int64_t sum = 0;
+        size_t last_row = NO_VERSION;   // NO_VERSION = 还没有值
+        uint64_t last_ts = 0;
+    };
+
+    // 一个 key 的合并状态；slots 每列一个，由调用方分配 (批量点查一组 key 共用一块)
+    struct PointMerge {
+        PointSlot* slots = nullptr;
+        size_t pending_last = 0;        // 还没拿到值的 AGG_LAST 列数
+        bool has_sum = false;           // 有 AGG_SUM 列时所有版本都要看
+        uint64_t candidates = 0, invisible = 0, mismatched = 0, merged = 0;
+    };
+
+    std::vector<PointColumn> pointColumns(const std::string& key_col_name) const {
+        std::vector<PointColumn> cols;
+        for (const auto& s : schema) {
+            if (s.name == key_col_name) continue;
+            const AbstractColumn* col = columns.at(s.name).get();
+            cols.push_back({&s.name, s.agg_type, dynamic_cast<const Column<int>*>(col), dynamic_cast<const Column<std::string>*>(col)});
+        }
+        return cols;
+    }
+
+    static PointMerge startMerge(const std::vector<PointColumn>& cols, PointSlot* slots) {
+        PointMerge m;
+        m.slots = slots;
+        for (const auto& pc : cols) {
+            if (pc.agg == AGG_SUM) m.has_sum = true;
+            else m.pending_last++;
+        }
+        return m;
+    }
+
+    // 合并一个可见的版本，返回还要不要往下看
+    // AGG_LAST 列取提交时间戳最大的非 NULL 版本 (这一行是 NULL 就跳过，保留更早版本的值)
+    bool mergeVersion(PointMerge& m, const std::vector<PointColumn>& cols, size_t row) const {
+        m.merged++;
+        uint64_t row_ts = meta.getCreated(row);
+        for (size_t c = 0; c < cols.size(); ++c) {
+            const PointColumn& pc = cols[c];
+            PointSlot& slot = m.slots[c];
+            if (pc.agg == AGG_SUM) {
+                // Delta Accumulation
+                if (pc.ints) slot.sum += pc.ints->get(row);
+            } else if (slot.last_row == NO_VERSION || row_ts > slot.last_ts) {
+                // MVCC Overwrite
+                if (pc.ints ? pc.ints->isNull(row) : pc.strs->isNull(row)) continue;
+                if (slot.last_row == NO_VERSION) m.pending_last--;
+                slot.last_row = row;
+                slot.last_ts = row_ts;
+            }
+        }
+        return m.has_sum || m.pending_last > 0;
+    }
+
+    // 合并结果转成一行 (AGG_SUM 列在有可见版本时才出现，AGG_LAST 列全是 NULL 时不出现)
+    std::unordered_map<std::string, std::string> finishMerge(const PointMerge& m, const std::vector<PointColumn>& cols,
+                                                             const std::string& key_col_name, const std::string& key_val) const {
+        std::unordered_map<std::string, std::string> result;
+        result.reserve(cols.size() + 1);
+        for (size_t c = 0; c < cols.size(); ++c) {
+            const PointColumn& pc = cols[c];
+            const PointSlot& slot = m.slots[c];
+            if (pc.agg == AGG_SUM) {
+                if (m.merged) result[*pc.name] = std::to_string(slot.sum);
+            } else if (slot.last_row != NO_VERSION) {
+                result[*pc.name] = pc.ints ? std::to_string(pc.ints->get(slot.last_row)) : pc.strs->get(slot.last_row);
             }
         }
         result[key_col_name] = key_val;
         return result;
     }
-};
\ No newline at end of file
+
+    // 点查：索引列走版本链 (从新到旧)，没有索引时全表扫描
+    // 版本链上 AGG_LAST 列取遇到的第一个有值的可见版本；所有 AGG_LAST 列都有了值、又没有 AGG_SUM 列要累加时就停下，
+    // 所以只有 AGG_LAST 列的表读最新值和这个 key 有过多少次更新无关
+    // profile 非空时整个重填 (readStable 重试时不会累加)
+    std::unordered_map<std::string, std::string> queryAt(const std::string& key_col_name, const std::string& key_val, uint64_t query_ts,
+                                                         QueryProfile* profile = nullptr) {
+        std::vector<PointColumn> cols = pointColumns(key_col_name);
+        std::vector<PointSlot> slots(cols.size());
+        PointMerge m = mergeKeyAt(key_col_name, key_val, query_ts, cols, slots.data(), profile);
+        return finishMerge(m, cols, key_col_name, key_val);
+    }
+
+    // 点查的合并部分 (queryAt 去掉最后转成 map 的一步)：合并状态留在 slots 里，由调用方决定怎么输出
+    PointMerge mergeKeyAt(const std::string& key_col_name, const std::string& key_val, uint64_t query_ts,
+                          const std::vector<PointColumn>& cols, PointSlot* slots, QueryProfile* profile) {
+        uint64_t start = profile ? profileClock() : 0;
+        HashIndex* index = liveIndex(key_col_name);
+        bool use_index = index != nullptr;
+        auto* key_col = dynamic_cast<Column<std::string>*>(columns[key_col_name].get());
+        PointMerge m = startMerge(cols, slots);
+
+        // 合并一个候选行，返回还要不要往下看
+        auto mergeRow = [&](size_t i) {
+            m.candidates++;
+            // MVCC & Key 检查 (版本链上都是这个 key，不用再比)
+            if (!meta.isVisible(i, query_ts)) {
+                m.invisible++;
+                return true;
+            }
+            if (!use_index && (key_col->isNull(i) || key_col->get(i) != key_val)) {
+                m.mismatched++;
+                return true;
+            }
+            return mergeVersion(m, cols, i);
+        };
+
+        uint64_t lookup_done = start;
+        bool stopped_early = false;
+        if (use_index) {
+            // A. 索引加速：从最新版本往旧走
+            size_t row = index->newest(key_val);
+            if (profile) lookup_done = profileClock();
+            for (; row != NO_VERSION; row = index->older(row)) {
+                if (!mergeRow(row)) {
+                    stopped_early = index->older(row) != NO_VERSION;
+                    break;
+                }
+            }
+        } else {
+            // B. 全表扫描 (历史快照只扫每块里那时已经提交的前缀)
+            size_t limit = tail_index.load();
+            if (profile) lookup_done = profileClock();
+            for (size_t base = 0; base < limit; base += CHUNK_SIZE) {
+                size_t end = std::min(limit, base + meta.bornEnd(base / CHUNK_SIZE, query_ts));
+                for (size_t i = base; i < end; ++i) mergeRow(i);
+            }
+        }
+        Metrics::add(METRIC_POINT_QUERIES);
+        Metrics::record(METRIC_VERSIONS_PER_KEY, m.candidates);
+
+        if (profile) {
+            // 合并一级：走版本链 (或逐行扫) + 可见性和 key 检查 + 版本合并；下面一级是找链表头
+            uint64_t end = profileClock();
+            ProfileNode lookup(use_index ? "Index Lookup on " + table_name + " using " + key_col_name
+                                         : "Seq Scan on " + table_name + " (no index on " + key_col_name + ")");
+            lookup.rows = use_index ? (m.candidates ? 1 : 0) : m.candidates;
+            lookup.time_ns = lookup_done - start;
+
+            ProfileNode node("Point Query: " + key_col_name + " = '" + key_val + "'");
+            node.rows = m.merged ? 1 : 0;
+            node.time_ns = end - lookup_done;
+            node.count("candidates", m.candidates);
+            node.count("invisible", m.invisible);
+            node.count("key_mismatch", m.mismatched);
+            node.count("versions_merged", m.merged);
+            if (use_index) node.count("stopped_early", stopped_early ? 1 : 0);
+            node.children.push_back(std::move(lookup));
+
+            profile->analyzed = true;
+            profile->root = std::move(node);
+            profile->threads = 1;
+            profile->total_ns = end - start;
+        }
+        return m;
+    }
+
+    // 批量点查一组 key (一组在一个顺序锁读里，GC 切换时只重做这一组)，和逐个 queryAt 合并的结果一样
+    // 1. 所有 key 先算哈希、按分片分组取表头，一个分片只加一次锁
+    // 2. 给每个表头行预取链节点、MVCC 时间戳和各列的值
+    // 3. 交错走链：每轮每个 key 只合并一个版本，合并完预取它的下一个版本，
+    //    等这一轮其它 key 做完再轮到它时，那几条缓存行已经到了
+    // 合并完按 keys 的顺序交给 emit(k, 合并状态, cols)，输出成 map 还是按列由调用方决定；没有索引时退回逐个合并
+    template <typename Emit>
+    void queryBatchAt(const std::string& key_col_name, const std::string* keys, size_t n, uint64_t query_ts, Emit&& emit) {
+        HashIndex* index = liveIndex(key_col_name);
+        std::vector<PointColumn> cols = pointColumns(key_col_name);
+        if (!index) {
+            std::vector<PointSlot> slots(cols.size());
+            for (size_t k = 0; k < n; ++k) {
+                std::fill(slots.begin(), slots.end(), PointSlot());
+                emit(k, mergeKeyAt(key_col_name, keys[k], query_ts, cols, slots.data(), nullptr), cols);
+            }
+            return;
+        }
+        auto prefetchRow = [&](size_t row) {
+            index->prefetch(row);
+            meta.prefetch(row);
+            for (const auto& pc : cols) {
+                if (pc.ints) pc.ints->prefetch(row);
+                else pc.strs->prefetch(row);
+            }
+        };
+
+        // 1. 表头
+        std::vector<size_t> rows;
+        index->newestBatch(keys, n, rows);
+
+        // 2. 预取
+        std::vector<uint32_t> active;
+        active.reserve(n);
+        for (size_t k = 0; k < n; ++k) {
+            if (rows[k] == NO_VERSION) continue;
+            prefetchRow(rows[k]);
+            active.push_back(static_cast<uint32_t>(k));
+        }
+
+        // 3. 交错走链
+        std::vector<PointSlot> slots(n * cols.size());
+        std::vector<PointMerge> merges(n);
+        for (size_t k = 0; k < n; ++k) merges[k] = startMerge(cols, slots.data() + k * cols.size());
+        while (!active.empty()) {
+            size_t kept = 0;
+            for (uint32_t k : active) {
+                PointMerge& m = merges[k];
+                size_t row = rows[k];
+                m.candidates++;
+                bool more = true;
+                if (meta.isVisible(row, query_ts)) more = mergeVersion(m, cols, row);
+                else m.invisible++;
+                size_t next = more ? index->older(row) : NO_VERSION;
+                if (next == NO_VERSION) continue;
+                rows[k] = next;
+                prefetchRow(next);
+                active[kept++] = k;
+            }
+            active.resize(kept);
+        }
+
+        Metrics::add(METRIC_POINT_QUERIES, n);
+        for (size_t k = 0; k < n; ++k) {
+            Metrics::record(METRIC_VERSIONS_PER_KEY, merges[k].candidates);
+            emit(k, merges[k], cols);
+        }
+    }
+
+    void checkSchema(const char* p, size_t bytes, size_t count) {
+        if (count != schema.size()) throw std::runtime_error("Table file schema does not match table '" + table_name + "'");
+        const char* end = p + bytes;
+        for (size_t i = 0; i < count; ++i) {
+            if (static_cast<size_t>(end - p) < 2 + sizeof(uint32_t)) throw std::runtime_error("Corrupted table file schema");
+            uint8_t type = static_cast<uint8_t>(*p++);
+            uint8_t agg = static_cast<uint8_t>(*p++);
+            uint32_t len;
+            std::memcpy(&len, p, sizeof(len));
+            p += sizeof(len);
+            if (static_cast<size_t>(end - p) < len) throw std::runtime_error("Corrupted table file schema");
+            std::string name(p, len);
+            p += len;
+            if (name != schema[i].name || type != schema[i].type || agg != schema[i].agg_type) {
+                throw std::runtime_error("Table file schema does not match table '" + table_name + "' at column " + name);
+            }
+        }
+    }
+
+    // 按块并行扫描 [first_chunk, end_chunk)，把没死的行 (不是空洞、没被折叠) 登记到所有索引 (含在建的)
+    // 批量导入时这些行还没提交，先进索引也没关系 (索引本来就可能含不可见的版本)，版本链按 pending_ts 排
+    void rebuildIndexes(size_t first_chunk, size_t end_chunk, uint64_t pending_ts = 0) {
+        for (auto& kv : indexes) {
+            HashIndex* building = kv.second.building.load(std::memory_order_acquire);
+            HashIndex* live = kv.second.live.load(std::memory_order_acquire);
+            if (live) buildIndex(kv.first, *live, first_chunk, end_chunk, pending_ts);
+            if (building && building != live) buildIndex(kv.first, *building, first_chunk, end_chunk, pending_ts);
+        }
+    }
+
+    // 按块并行把 col_name 列 [first_chunk, end_chunk) 的行登记到 index，一块一批 (insertBatch 按分片排好再加锁)
+    // 没提交的行 (INF_TS) 按 pending_ts 登记；pending_ts = 0 时跳过 (在线建索引：它们的写入自己会登记)
+    // 各块并行登记，同一个 key 的版本到达顺序不定，挂链时按时间戳找位置
+    void buildIndex(const std::string& col_name, HashIndex& target, size_t first_chunk, size_t end_chunk, uint64_t pending_ts) {
+        auto* col = dynamic_cast<Column<std::string>*>(columns[col_name].get());
+        std::atomic<size_t> next_chunk{first_chunk};
+        auto worker = [&] {
+            std::vector<IndexEntry> entries;
+            for (size_t c = next_chunk++; c < end_chunk; c = next_chunk++) {
+                size_t base = c * CHUNK_SIZE;
+                entries.clear();
+                const NullBitmap* nulls = col->nullBitmap(c);
+                col->scanChunk(c, [&](size_t offset, const auto& v) {
+                    size_t row = base + offset;
+                    if (nulls && nulls->test(offset)) return; // NULL 不进索引
+                    uint64_t born = meta.getCreated(row);
+                    if (born == INF_TS && pending_ts == 0) return;
+                    if (born != DEAD_TS && meta.getInvalidated(row) == INF_TS) {
+                        entries.push_back({std::string_view(v), row, born == INF_TS ? pending_ts : born});
+                    }
+                });
+                target.insertBatch(entries); // 一块一批
+            }
+        };
+
+        size_t n = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), end_chunk - first_chunk));
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < n; ++t) threads.emplace_back(worker);
+        worker();
+        for (auto& th : threads) th.join();
+    }
+
+    // 把一块从 MVCC、所有列和索引版本链上摘下，等旧读者退出后释放 (调用方持有 gc_mutex)
+    void retireChunk(size_t c) {
+        std::vector<std::function<void()>> deleters;
+        deleters.push_back(meta.detachChunk(c));
+        for (auto& kv : columns) deleters.push_back(kv.second->detachChunk(c));
+        forEachIndex([&](const std::string&, HashIndex& index) { deleters.push_back(index.detachChunk(c)); });
+        snapshots.retire([deleters] {
+            for (auto& d : deleters) d();
+        });
+    }
+
+    // 在新领的时间戳上截断一块：还活着的行从 drop_ts 起失效 (调用方持有 gc_mutex)
+    // 和提交一样，drop_ts 完成之前提交水位过不去：快照要么看到整块都在，要么整块都没了
+    void dropChunk(size_t c) {
+        uint64_t drop_ts = commit_clock.issue();
+        seal_info[c].dropped_at.store(drop_ts, std::memory_order_release); // 先关掉 sumColumn 的整块快速路径
+
+        uint64_t seq = gc_seq.load(std::memory_order_relaxed);
+        gc_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = c * CHUNK_SIZE; i < (c + 1) * CHUNK_SIZE; ++i) {
+            if (meta.getCreated(i) == DEAD_TS || meta.getInvalidated(i) != INF_TS) continue;
+            meta.setDropped(i, drop_ts);
+        }
+        gc_seq.store(seq + 2, std::memory_order_release);
+        commit_clock.finish(drop_ts);
+    }
+
+    // 块里还挂在索引上的行 (没死、没被折叠、不是 NULL) 从版本链上摘掉，按 key 分组一次摘一批
+    // drop_ts：截断时失效的行还挂在链上，也要摘
+    void eraseChunkFromIndexes(size_t c, uint64_t drop_ts) {
+        size_t base = c * CHUNK_SIZE;
+        forEachIndex([&](const std::string& col_name, HashIndex& index) {
+            auto* col = dynamic_cast<Column<std::string>*>(columns[col_name].get());
+            const NullBitmap* nulls = col->nullBitmap(c);
+            std::unordered_map<std::string, std::vector<size_t>> by_value;
+            col->scanChunk(c, [&](size_t offset, const auto& v) {
+                size_t row = base + offset;
+                if (nulls && nulls->test(offset)) return;
+                if (meta.getCreated(row) == DEAD_TS) return;
+                uint64_t died = meta.getInvalidated(row);
+                if (died != INF_TS && died != drop_ts) return;
+                by_value[std::string(v)].push_back(row);
+            });
+            for (auto& bv : by_value) index.erase(bv.first, std::move(bv.second));
+        });
+    }
+
+    // 保留策略换算成时间戳：这个时间戳及之前提交的行都过期了，0 = 没有过期的
+    // 按时间过期用时钟采样：采样 (when, ts) 说明 ts 及之前的行在 when 之前都已提交
+    uint64_t retentionCutoff() {
+        uint64_t min_ts = retention_min_ts.load();
+        uint64_t cutoff = min_ts > 0 ? min_ts - 1 : 0;
+        auto age = std::chrono::milliseconds(retention_age_ms.load());
+        if (age.count() <= 0) {
+            clock_samples.clear();
+            return cutoff;
+        }
+
+        // 采样间隔 age/64：最多留几十个采样，过期最多晚 age/64
+        auto now = std::chrono::steady_clock::now();
+        if (clock_samples.empty() || now - clock_samples.back().when >= age / 64) {
+            clock_samples.push_back({now, commit_clock.committedTimestamp()});
+        }
+        // 留下最新的一个已经够老的采样，更老的没用了
+        while (clock_samples.size() >= 2 && now - clock_samples[1].when >= age) clock_samples.pop_front();
+        if (now - clock_samples.front().when >= age) cutoff = std::max(cutoff, clock_samples.front().ts);
+        return cutoff;
+    }
+
+    // 把每个 key 在水位之前可见的版本 (至少 min_versions 个) 折叠成表尾的一行
+    void foldKeys(const std::vector<std::string>& keys, size_t min_versions, uint64_t watermark, GcStats& stats) {
+        struct Fold {
+            size_t new_row;
+            uint64_t ts;                  // 被折叠的最新版本的时间戳
+            std::vector<size_t> old_rows;
+        };
+        HashIndex* key_index = liveIndex(gc_key_col);
+
+        for (size_t begin = 0; begin < keys.size(); begin += GC_BATCH_KEYS) {
+            size_t end = std::min(keys.size(), begin + GC_BATCH_KEYS);
+            std::vector<Fold> folds;
+
+            // A. 在表尾写好合并行 (created 还是 INF_TS，读者看不见)
+            for (size_t k = begin; k < end; ++k) {
+                Fold f{0, 0, {}};
+                for (size_t r : key_index->get(keys[k])) {
+                    if (!meta.isVisible(r, watermark)) continue;
+                    // 截断了的块等自己被摘，不把过期的值折叠进新行
+                    if (seal_info[r / CHUNK_SIZE].dropped_at.load(std::memory_order_relaxed) != INF_TS) continue;
+                    f.ts = std::max(f.ts, meta.getCreated(r));
+                    f.old_rows.push_back(r);
+                }
+                if (f.old_rows.size() < min_versions) continue;
+                if (!foldedSumsFit(f.old_rows)) continue; // 合并后的和装不进 int，留着原来的版本
+
+                f.new_row = nextRowId();
+                writeFoldedRow(f.new_row, f.old_rows, f.ts);
+                folds.push_back(std::move(f));
+            }
+            if (folds.empty()) continue;
+
+            // B. 顺序锁内切换可见性：新行出生、旧行死亡，读者要么全看到旧的要么全看到新的
+            uint64_t seq = gc_seq.load(std::memory_order_relaxed);
+            gc_seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (const auto& f : folds) {
+                meta.setCreated(f.new_row, f.ts);
+                for (size_t r : f.old_rows) meta.setInvalidated(r, f.ts);
+            }
+            gc_seq.store(seq + 2, std::memory_order_release);
+
+            // C. 旧行已经对所有快照不可见，从索引里删掉 (非主键索引列的旧值可能各不相同)
+            //    摘版本链也在顺序锁内：正在走链的点查重来一遍，之后回收整块时不会有读者还停在被摘的行上
+            seq = gc_seq.load(std::memory_order_relaxed);
+            gc_seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (const auto& f : folds) {
+                forEachIndex([&](const std::string& col_name, HashIndex& index) {
+                    auto* col = dynamic_cast<Column<std::string>*>(columns[col_name].get());
+                    std::unordered_map<std::string, std::vector<size_t>> by_value;
+                    for (size_t r : f.old_rows) {
+                        if (!col->isNull(r)) by_value[col->get(r)].push_back(r);
+                    }
+                    for (auto& bv : by_value) index.erase(bv.first, std::move(bv.second));
+                });
+                stats.keys_folded++;
+                stats.versions_reclaimed += f.old_rows.size();
+            }
+            gc_seq.store(seq + 2, std::memory_order_release);
+        }
+    }
+
+    // old_rows 里这一列有值的最新版本；全是 NULL 返回 -1
+    template <typename T>
+    long newestPresent(const Column<T>& col, const std::vector<size_t>& old_rows) const {
+        long best = -1;
+        uint64_t best_ts = 0;
+        for (size_t r : old_rows) {
+            if (col.isNull(r)) continue;
+            uint64_t ts = meta.getCreated(r);
+            if (best < 0 || ts > best_ts) {
+                best = static_cast<long>(r);
+                best_ts = ts;
+            }
+        }
+        return best;
+    }
+
+    // AGG_SUM 列在 int64 里求和 (NULL 槽是 0)
+    static int64_t foldedSum(const Column<int>& col, const std::vector<size_t>& old_rows) {
+        int64_t sum = 0;
+        for (size_t r : old_rows) sum += col.get(r);
+        return sum;
+    }
+
+    // 每个 AGG_SUM 列的和都装得进 int 才能折叠成一行
+    bool foldedSumsFit(const std::vector<size_t>& old_rows) {
+        for (const auto& s : schema) {
+            if (s.type != TYPE_INT || s.agg_type != AGG_SUM) continue;
+            int64_t sum = foldedSum(*dynamic_cast<Column<int>*>(columns[s.name].get()), old_rows);
+            if (sum < std::numeric_limits<int>::min() || sum > std::numeric_limits<int>::max()) return false;
+        }
+        return true;
+    }
+
+    // 按混合聚合语义把 old_rows 合并写到 new_row，并按 ts (被折叠的最新版本的时间戳) 挂到所有索引的版本链上
+    // AGG_SUM 求和；其余列取最新的有值版本，所有版本都是 NULL 时合并行也是 NULL
+    void writeFoldedRow(size_t new_row, const std::vector<size_t>& old_rows, uint64_t ts) {
+        for (const auto& s : schema) {
+            if (s.type == TYPE_INT) {
+                auto* col = dynamic_cast<Column<int>*>(columns[s.name].get());
+                if (s.agg_type == AGG_SUM) {
+                    // 调用方已经用 foldedSumsFit 确认装得下
+                    col->set(new_row, static_cast<int>(foldedSum(*col, old_rows)));
+                    continue;
+                }
+                long newest = newestPresent(*col, old_rows);
+                if (newest < 0) col->setNull(new_row);
+                else col->set(new_row, col->get(newest));
+            } else {
+                auto* col = dynamic_cast<Column<std::string>*>(columns[s.name].get());
+                long newest = newestPresent(*col, old_rows);
+                if (newest < 0) {
+                    col->setNull(new_row);
+                    continue;
+                }
+                std::string val = col->get(newest);
+                col->set(new_row, val);
+                if (HashIndex* index = liveIndex(s.name)) index->insert(val, new_row, ts);
+            }
+        }
+    }
+
+    // 找出活行很少的块里剩下的 key
+    // 块里还有未提交的行，或者有比水位新的行，这一轮先不动它
+    std::vector<std::string> compactionKeys(uint64_t watermark) {
+        std::unordered_set<std::string> keys;
+        auto* key_col = dynamic_cast<Column<std::string>*>(columns[gc_key_col].get());
+        size_t limit = tail_index.load();
+        size_t max_live = static_cast<size_t>(CHUNK_SIZE * GC_COMPACT_LIVE_RATIO);
+
+        for (size_t c = 0; c < limit / CHUNK_SIZE; ++c) {
+            if (!meta.hasChunk(c)) continue;
+            size_t dead = meta.deadRows(c);
+            if (dead == CHUNK_SIZE || CHUNK_SIZE - dead > max_live) continue;
+
+            std::vector<size_t> live;
+            bool settled = true;
+            for (size_t i = c * CHUNK_SIZE; i < (c + 1) * CHUNK_SIZE; ++i) {
+                uint64_t born = meta.getCreated(i);
+                if (born == DEAD_TS || meta.getInvalidated(i) <= watermark) continue;
+                if (born > watermark) {
+                    settled = false;
+                    break;
+                }
+                live.push_back(i);
+            }
+            if (!settled) continue;
+            for (size_t i : live) {
+                if (!key_col->isNull(i)) keys.insert(key_col->get(i));
+            }
+        }
+        return std::vector<std::string>(keys.begin(), keys.end());
+    }
+
+    // 每个线程一份的租约表：线程退出时析构，把还活着的表上没用完的行号标记为 DEAD_TS
+    struct LeaseHolder {
+        static inline thread_local LeaseHolder* current = nullptr; // 析构后清空，~Table 不会碰到已销毁的对象
+
+        uint64_t cached_uid = 0;
+        RowLease* cached = nullptr;
+        std::unordered_map<uint64_t, RowLease> leases;
+
+        LeaseHolder() { current = this; }
+
+        ~LeaseHolder() {
+            current = nullptr;
+            std::lock_guard<std::mutex> lock(live_tables_mutex);
+            for (const auto& kv : leases) {
+                auto it = live_tables.find(kv.first);
+                if (it == live_tables.end()) continue;
+                for (size_t i = kv.second.next; i < kv.second.end; ++i) it->second->meta.markDead(i);
+            }
+        }
+
+        // 丢掉已经销毁的表的租约项
+        void prune() {
+            std::lock_guard<std::mutex> lock(live_tables_mutex);
+            for (auto it = leases.begin(); it != leases.end();) {
+                if (live_tables.count(it->first)) ++it;
+                else it = leases.erase(it);
+            }
+        }
+    };
+
+    static LeaseHolder& leaseHolder() {
+        thread_local LeaseHolder holder;
+        return holder;
+    }
+
+    // 本线程在这张表上的租约
+    // 单项缓存挡住绝大多数查找，只有一个线程交替写多张表时才会查 map
+    RowLease& localLease() {
+        LeaseHolder& holder = leaseHolder();
+        if (holder.cached_uid != table_uid) {
+            auto it = holder.leases.find(table_uid);
+            if (it == holder.leases.end()) {
+                holder.prune(); // 第一次写这张表：顺手清掉已销毁的表
+                it = holder.leases.emplace(table_uid, RowLease{}).first;
+            }
+            holder.cached = &it->second; // unordered_map 的节点地址在 rehash 后保持不变
+            holder.cached_uid = table_uid;
+        }
+        return *holder.cached;
+    }
+
+    // 交还的租约里落在已写满块 (游标已经越过块尾) 的行号标记为 DEAD_TS，这些块才能封存、截断
+    // 尾块里的留给下一个语句 (调用方持有 gc_mutex)
+    void settleParkedLeases() {
+        size_t full_end = tail_index.load() / CHUNK_SIZE * CHUNK_SIZE;
+        std::lock_guard<std::mutex> lock(parked_mutex);
+        for (auto& lease : parked_leases) {
+            while (lease.next < lease.end && lease.next < full_end) meta.markDead(lease.next++);
+        }
+        parked_leases.erase(std::remove_if(parked_leases.begin(), parked_leases.end(),
+                                           [](const RowLease& l) { return l.next == l.end; }),
+                            parked_leases.end());
+    }
+
+    // 先用别的语句交还的租约
+    bool takeParkedLease(RowLease& lease) {
+        std::lock_guard<std::mutex> lock(parked_mutex);
+        if (parked_leases.empty()) return false;
+        lease = parked_leases.back();
+        parked_leases.pop_back();
+        return true;
+    }
+
+    // 把一行写进 my_idx 并在 tx_id 上提交 (出错抛异常，调用方把行作废)
+    // 整段在 RCU 读临界区里：在线建索引挂上新索引后等宽限期，没看到新索引的写入到那时都已提交，扫描能扫到
+    void writeRow(size_t my_idx, const std::vector<Value>& row_data, uint64_t tx_id) {
+        RcuReadGuard guard;
+        for (size_t i = 0; i < schema.size(); ++i) {
+            const auto& col_name = schema[i].name;
+            const auto& val = row_data[i];
+
+            if (std::holds_alternative<int>(val)) {
+                columns[col_name]->set(my_idx, std::get<int>(val));
+            } else if (const std::string* s_val = std::get_if<std::string>(&val)) {
+                columns[col_name]->set(my_idx, *s_val);
+
+                // 更新索引 (在建的索引也登记；先读 building：读到它被清空时一定也能读到换上去的 live)
+                auto it = indexes.find(col_name);
+                if (it != indexes.end()) {
+                    HashIndex* building = it->second.building.load(std::memory_order_acquire);
+                    HashIndex* live = it->second.live.load(std::memory_order_acquire);
+                    if (live) live->insert(*s_val, my_idx, tx_id);
+                    if (building && building != live) building->insert(*s_val, my_idx, tx_id);
+                }
+            } else {
+                // 稀疏行没给出这一列：只记空值位图 (NULL 不进索引)
+                columns[col_name]->setNull(my_idx);
+            }
+        }
+
+        meta.setCreated(my_idx, tx_id);
+    }
+
+    size_t nextRowId() {
+        RowLease& lease = localLease();
+        if (lease.next == lease.end && !takeParkedLease(lease)) {
+            // 租约用完：一次 fetch_add 领 ROW_LEASE_SIZE 行，全局游标争用降为原来的 1/4096
+            size_t begin = tail_index.fetch_add(ROW_LEASE_SIZE);
+            size_t end = begin + ROW_LEASE_SIZE;
+
+            // 租约可能跨块，把覆盖到的块一次性分配好，逐行写入时不再检查
+            MetricTimer timer(METRIC_ENSURE_CHUNK_NS);
+            for (size_t c = begin / CHUNK_SIZE; c <= (end - 1) / CHUNK_SIZE; ++c) {
+                meta.ensureChunk(c);
+                for (auto& kv : columns) kv.second->ensureChunk(c);
+            }
+            lease.next = begin;
+            lease.end = end;
+        }
+        return lease.next++;
+    }
+};
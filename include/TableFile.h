@@ -0,0 +1,192 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// --- 列存表文件 (Checkpoint) ---
+// 布局和内存里的分块一一对应，整个文件 mmap 进来就能直接查询：
+//   [Header 4KB] [Region] [Region] ... [Directory: RegionEntry x N] [Footer]
+// 每个 Region 是一列的一个块 (或者一块的 MVCC 时间戳、一列一块的空值位图)，按页对齐，缺页时才真正读盘
+
+constexpr char TABLE_FILE_MAGIC[8] = {'H', 'A', 'V', 'A', 'N', 'A', 'T', 'F'};
+constexpr uint32_t TABLE_FILE_VERSION = 1;
+constexpr size_t TABLE_FILE_ALIGN = 4096;
+
+enum RegionKind : uint32_t {
+    REGION_SCHEMA      = 1, // [type u8][agg u8][name_len u32][name] x 列数
+    REGION_INT_CHUNK   = 2, // PackedChunk<int> 的数据
+    REGION_STR_CHUNK   = 3, // PackedChunk<std::string> 的数据
+    REGION_CREATED     = 4, // uint64 created[CHUNK_SIZE]
+    REGION_INVALIDATED = 5, // uint64 invalidated[CHUNK_SIZE]
+    REGION_NULL_BITMAP = 6  // 一列一块的空值位图 uint64[NULL_BITMAP_WORDS]，num_values 存 NULL 个数
+};
+
+// 目录项：一个 Region 的位置 + 解码需要的参数
+struct RegionEntry {
+    uint32_t kind;
+    uint32_t column;      // 列序号 (schema 顺序)
+    uint32_t chunk;       // 块号
+    uint8_t encoding;     // ChunkEncoding
+    uint8_t bits;
+    uint16_t reserved;
+    int32_t base;
+    uint32_t num_values;  // RLE 段数 / 字典大小；REGION_CREATED 里存死亡行数
+    uint32_t count;       // 行数
+    uint32_t flags;       // REGION_CREATED: 1 = 块里有被折叠的行
+    uint64_t aux;         // REGION_CREATED: 块内最新的提交时间戳；REGION_SCHEMA: 历史查询 (AS OF) 的下限
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct TableFileFooter {
+    uint64_t dir_offset;
+    uint64_t dir_count;
+    uint64_t global_ts;   // 写文件时的全局时间戳
+    uint64_t num_chunks;  // 块数 (行数 = num_chunks * CHUNK_SIZE)
+    char magic[8];
+};
+
+// 只读打开 + MAP_PRIVATE 映射
+// 私有映射可写：GC 改 invalidated 时只复制被改的那一页，不会写回文件
+class MappedFile {
+private:
+    void* addr = MAP_FAILED;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open table file: " + path);
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(TABLE_FILE_ALIGN + sizeof(TableFileFooter))) {
+            ::close(fd);
+            throw std::runtime_error("Corrupted table file: " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd); // 映射建立后 fd 就不需要了
+        if (addr == MAP_FAILED) throw std::runtime_error("mmap failed: " + path);
+    }
+
+    ~MappedFile() {
+        if (addr != MAP_FAILED) ::munmap(addr, length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char* base() const { return static_cast<char*>(addr); }
+    size_t size() const { return length; }
+
+    const TableFileFooter& footer() const {
+        return *reinterpret_cast<const TableFileFooter*>(base() + length - sizeof(TableFileFooter));
+    }
+
+    const RegionEntry* directory() const {
+        return reinterpret_cast<const RegionEntry*>(base() + footer().dir_offset);
+    }
+
+    // 文件头的版本号
+    uint32_t version() const {
+        uint32_t v;
+        std::memcpy(&v, base() + sizeof(TABLE_FILE_MAGIC), sizeof(v));
+        return v;
+    }
+
+    // 目录整个落在文件里 (头之后、尾部之前)，并且按 RegionEntry 对齐
+    bool directoryValid() const {
+        const TableFileFooter& f = footer();
+        size_t dir_end = length - sizeof(TableFileFooter);
+        return f.dir_offset >= TABLE_FILE_ALIGN && f.dir_offset <= dir_end && f.dir_offset % alignof(RegionEntry) == 0 &&
+               f.dir_count <= (dir_end - f.dir_offset) / sizeof(RegionEntry);
+    }
+
+    // Region 的数据整个落在头和目录之间
+    bool regionValid(const RegionEntry& e) const {
+        uint64_t dir_offset = footer().dir_offset;
+        return e.offset >= TABLE_FILE_ALIGN && e.offset <= dir_offset && e.length <= dir_offset - e.offset &&
+               e.offset % sizeof(uint64_t) == 0;
+    }
+};
+
+// 让目录里的改名 (新建 / rename) 落盘：只 fsync 文件本身，崩溃后目录项可能还是旧的
+inline void syncParentDirectory(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) throw std::runtime_error("Cannot open directory " + dir);
+    int rc = ::fsync(fd);
+    ::close(fd);
+    if (rc != 0) throw std::runtime_error("fsync failed on directory " + dir);
+}
+
+// 顺序写表文件：先写 Region，最后写目录和尾部
+class TableFileWriter {
+private:
+    std::string path;
+    std::ofstream out;
+    uint64_t pos = 0;
+    std::vector<RegionEntry> entries;
+
+    void pad(size_t align) {
+        static const char zeros[TABLE_FILE_ALIGN] = {0};
+        size_t rem = pos % align;
+        if (rem == 0) return;
+        out.write(zeros, align - rem);
+        pos += align - rem;
+    }
+
+public:
+    explicit TableFileWriter(const std::string& file_path) : path(file_path) {
+        out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) throw std::runtime_error("Cannot create table file: " + path);
+
+        // 头部占满一页，数据从第二页开始
+        char header[TABLE_FILE_ALIGN] = {0};
+        std::memcpy(header, TABLE_FILE_MAGIC, sizeof(TABLE_FILE_MAGIC));
+        std::memcpy(header + sizeof(TABLE_FILE_MAGIC), &TABLE_FILE_VERSION, sizeof(TABLE_FILE_VERSION));
+        out.write(header, sizeof(header));
+        pos = sizeof(header);
+    }
+
+    // 写一个页对齐的 Region，entry 的 offset/length 由这里填
+    void writeRegion(RegionEntry entry, const void* data, size_t bytes) {
+        pad(TABLE_FILE_ALIGN);
+        entry.offset = pos;
+        entry.length = bytes;
+        out.write(static_cast<const char*>(data), bytes);
+        pos += bytes;
+        entries.push_back(entry);
+    }
+
+    void finish(uint64_t global_ts, uint64_t num_chunks) {
+        pad(sizeof(uint64_t));
+        TableFileFooter footer{};
+        footer.dir_offset = pos;
+        footer.dir_count = entries.size();
+        footer.global_ts = global_ts;
+        footer.num_chunks = num_chunks;
+        std::memcpy(footer.magic, TABLE_FILE_MAGIC, sizeof(TABLE_FILE_MAGIC));
+
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(RegionEntry));
+        out.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+        out.flush();
+        if (!out) throw std::runtime_error("Failed to write table file: " + path);
+        out.close();
+
+        // fstream 只写到 page cache，真正落盘要 fsync
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot reopen table file: " + path);
+        int rc = ::fsync(fd);
+        ::close(fd);
+        if (rc != 0) throw std::runtime_error("fsync failed on table file: " + path);
+    }
+};
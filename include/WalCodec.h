@@ -0,0 +1,285 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <variant>
+#include <unordered_map>
+#include <stdexcept>
+#ifdef HAVANA_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+// --- WAL 紧凑编码 ---
+// 段文件 = 一串块 (每次刷盘一个块)：
+//   [stored_len u32][raw_len u32][crc32 u32][flags u32][data]
+//   stored_len = 0 表示段结束 (预分配的文件后面全是 0)；CRC 覆盖 data，不对说明是崩溃时没写完的尾巴
+//   flags & WAL_BLOCK_ZLIB：data 是 zlib 压缩过的，解压后 raw_len 字节
+// 块解压后 = 一串记录：[(payload_len << 1 | sparse) varint][lsn 差值 zigzag varint][payload]
+//   lsn 是这行的提交时间戳；同一流里不同线程的提交会交错，所以差值可能为负
+//   sparse = 1：稀疏行 (有 NULL 列)，payload 先是 (列数 + 7) / 8 字节的在场位图 (第 i 位 = 第 i 列有值)，
+//               后面只有有值的列
+// payload 按列顺序：
+//   int    -> zigzag varint
+//   string -> varint h；h 最低位是 1：字典引用，编号 h >> 1
+//                      h 最低位是 0：字面量，长度 h >> 1，后面跟字节
+//             字面量长度不超过 WAL_DICT_MAX_LEN 且字典没满时，写和读两边同时把它加进字典
+// 字典和 lsn 差值的基准每段重置：读的时候每段从头顺序重放就能还原，不依赖别的段
+
+constexpr size_t WAL_BLOCK_HEADER = 16;
+constexpr uint32_t WAL_BLOCK_ZLIB = 1;
+constexpr size_t WAL_DICT_MAX_ENTRIES = 65536;
+constexpr size_t WAL_DICT_MAX_LEN = 64;
+// 字典满了以后命中率低于 1/8 就不再查 (key 基本不重复时省掉每行一次哈希查找)
+constexpr size_t WAL_DICT_PROBE_WINDOW = 4096;
+// 太小的块压缩不划算 (同步提交时一块往往只有一两行)
+constexpr size_t WAL_COMPRESS_MIN_BYTES = 4096;
+
+inline uint32_t walCrc32(const char* data, size_t len) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+inline uint64_t walZigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t walUnzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+inline void walPutVarint(std::vector<char>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+inline bool walGetVarint(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// 写端：每个日志流一个，状态受流的 buffer_mutex 保护
+class WalEncoder {
+private:
+    std::unordered_map<std::string, uint32_t> dict;
+    uint64_t prev_lsn = 0;
+    std::vector<char> payload; // 复用的临时缓冲
+
+    // 字典满了之后的命中统计 (只影响写端查不查，读端不受影响：字典满了两边都不再加词)
+    bool lookups_enabled = true;
+    size_t probes = 0;
+    size_t hits = 0;
+
+    const uint32_t* lookup(const std::string& s) {
+        if (!lookups_enabled) return nullptr;
+        auto it = dict.find(s);
+        if (dict.size() >= WAL_DICT_MAX_ENTRIES) {
+            probes++;
+            if (it != dict.end()) hits++;
+            if (probes == WAL_DICT_PROBE_WINDOW) {
+                lookups_enabled = hits * 8 >= probes;
+                probes = hits = 0;
+            }
+        }
+        return it == dict.end() ? nullptr : &it->second;
+    }
+
+public:
+    // 换段：字典和 lsn 基准从头开始
+    void reset() {
+        dict.clear();
+        prev_lsn = 0;
+        lookups_enabled = true;
+        probes = hits = 0;
+    }
+
+    // 把一行编码成一条记录追加到 out 后面，返回追加的字节数
+    size_t encode(std::vector<char>& out, const std::vector<std::variant<int, std::string, std::monostate>>& row, uint64_t lsn) {
+        payload.clear();
+        bool sparse = false;
+        for (const auto& val : row) {
+            if (std::holds_alternative<std::monostate>(val)) {
+                sparse = true;
+                break;
+            }
+        }
+        if (sparse) {
+            payload.resize((row.size() + 7) / 8, 0);
+            for (size_t i = 0; i < row.size(); ++i) {
+                if (!std::holds_alternative<std::monostate>(row[i])) payload[i >> 3] |= static_cast<char>(1 << (i & 7));
+            }
+        }
+
+        for (const auto& val : row) {
+            if (std::holds_alternative<std::monostate>(val)) continue;
+            if (std::holds_alternative<int>(val)) {
+                walPutVarint(payload, walZigzag(std::get<int>(val)));
+                continue;
+            }
+            const std::string& s = std::get<std::string>(val);
+            if (const uint32_t* id = lookup(s)) {
+                walPutVarint(payload, (static_cast<uint64_t>(*id) << 1) | 1);
+                continue;
+            }
+            walPutVarint(payload, static_cast<uint64_t>(s.size()) << 1);
+            payload.insert(payload.end(), s.begin(), s.end());
+            if (s.size() <= WAL_DICT_MAX_LEN && dict.size() < WAL_DICT_MAX_ENTRIES) {
+                dict.emplace(s, static_cast<uint32_t>(dict.size()));
+            }
+        }
+
+        size_t before = out.size();
+        walPutVarint(out, (static_cast<uint64_t>(payload.size()) << 1) | (sparse ? 1 : 0));
+        walPutVarint(out, walZigzag(static_cast<int64_t>(lsn - prev_lsn)));
+        out.insert(out.end(), payload.begin(), payload.end());
+        prev_lsn = lsn;
+        return out.size() - before;
+    }
+};
+
+// 读端：每个段一个，按顺序喂块
+class WalDecoder {
+private:
+    std::vector<std::string> dict;
+    uint64_t prev_lsn = 0;
+
+    bool decodeRow(const char* p, const char* end, bool sparse, const std::vector<int>& col_types,
+                   std::vector<std::variant<int, std::string, std::monostate>>& row) {
+        const char* present = nullptr;
+        if (sparse) {
+            size_t bytes = (col_types.size() + 7) / 8;
+            if (static_cast<size_t>(end - p) < bytes) return false;
+            present = p;
+            p += bytes;
+        }
+        for (size_t i = 0; i < col_types.size(); ++i) {
+            int type = col_types[i];
+            if (present && !((present[i >> 3] >> (i & 7)) & 1)) {
+                row.emplace_back(std::monostate{});
+                continue;
+            }
+            uint64_t v;
+            if (!walGetVarint(p, end, v)) return false;
+            if (type == 0) { // TYPE_INT
+                row.push_back(static_cast<int>(walUnzigzag(v)));
+            } else if (v & 1) { // 字典引用
+                if ((v >> 1) >= dict.size()) return false;
+                row.push_back(dict[v >> 1]);
+            } else { // 字面量
+                uint64_t len = v >> 1;
+                if (static_cast<uint64_t>(end - p) < len) return false;
+                std::string s(p, len);
+                p += len;
+                if (len <= WAL_DICT_MAX_LEN && dict.size() < WAL_DICT_MAX_ENTRIES) dict.push_back(s);
+                row.push_back(std::move(s));
+            }
+        }
+        return p == end;
+    }
+
+public:
+    // 解一个块里的所有记录：fn(lsn, row)；格式不对返回 false (之后的数据都不可信)
+    template <typename Fn>
+    bool decodeBlock(const char* p, const char* end, const std::vector<int>& col_types, Fn&& fn) {
+        while (p < end) {
+            uint64_t head, delta;
+            if (!walGetVarint(p, end, head) || !walGetVarint(p, end, delta)) return false;
+            uint64_t len = head >> 1;
+            if (static_cast<uint64_t>(end - p) < len) return false;
+
+            std::vector<std::variant<int, std::string, std::monostate>> row;
+            if (!decodeRow(p, p + len, head & 1, col_types, row)) return false;
+            prev_lsn += static_cast<uint64_t>(walUnzigzag(delta));
+            fn(prev_lsn, std::move(row));
+            p += len;
+        }
+        return true;
+    }
+};
+
+// 把一批记录包成一个块追加到 out；compress = true 且压缩后更小时存压缩数据
+inline void walWrapBlock(std::vector<char>& out, const char* raw, size_t len, bool compress) {
+    size_t header_pos = out.size();
+    out.resize(header_pos + WAL_BLOCK_HEADER);
+    uint32_t flags = 0;
+
+#ifdef HAVANA_WITH_ZLIB
+    if (compress && len >= WAL_COMPRESS_MIN_BYTES) {
+        uLongf bound = compressBound(static_cast<uLong>(len));
+        out.resize(header_pos + WAL_BLOCK_HEADER + bound);
+        Bytef* dst = reinterpret_cast<Bytef*>(out.data() + header_pos + WAL_BLOCK_HEADER);
+        if (compress2(dst, &bound, reinterpret_cast<const Bytef*>(raw), static_cast<uLong>(len), Z_BEST_SPEED) == Z_OK &&
+            bound < len) {
+            out.resize(header_pos + WAL_BLOCK_HEADER + bound);
+            flags = WAL_BLOCK_ZLIB;
+        } else {
+            out.resize(header_pos + WAL_BLOCK_HEADER);
+        }
+    }
+#else
+    (void)compress; // 没有 zlib 时总是存原始数据
+#endif
+    if (flags == 0) out.insert(out.end(), raw, raw + len);
+
+    uint32_t stored = static_cast<uint32_t>(out.size() - header_pos - WAL_BLOCK_HEADER);
+    uint32_t raw_len = static_cast<uint32_t>(len);
+    uint32_t crc = walCrc32(out.data() + header_pos + WAL_BLOCK_HEADER, stored);
+    std::memcpy(out.data() + header_pos, &stored, 4);
+    std::memcpy(out.data() + header_pos + 4, &raw_len, 4);
+    std::memcpy(out.data() + header_pos + 8, &crc, 4);
+    std::memcpy(out.data() + header_pos + 12, &flags, 4);
+}
+
+// 逐块遍历一个段文件，遇到结束标记或坏块停下：fn(raw, raw_len) 返回 false 也停下
+template <typename Fn>
+void walForEachBlock(const std::vector<char>& data, Fn&& fn) {
+    std::vector<char> inflated;
+    size_t pos = 0;
+    while (data.size() - pos >= WAL_BLOCK_HEADER) {
+        uint32_t stored, raw_len, crc, flags;
+        std::memcpy(&stored, data.data() + pos, 4);
+        std::memcpy(&raw_len, data.data() + pos + 4, 4);
+        std::memcpy(&crc, data.data() + pos + 8, 4);
+        std::memcpy(&flags, data.data() + pos + 12, 4);
+        if (stored == 0 || stored > data.size() - pos - WAL_BLOCK_HEADER) break;
+        const char* body = data.data() + pos + WAL_BLOCK_HEADER;
+        if (walCrc32(body, stored) != crc) break; // 撕裂的尾巴
+        pos += WAL_BLOCK_HEADER + stored;
+
+        if (!(flags & WAL_BLOCK_ZLIB)) {
+            if (!fn(body, static_cast<size_t>(stored))) break;
+            continue;
+        }
+#ifdef HAVANA_WITH_ZLIB
+        inflated.resize(raw_len);
+        uLongf out_len = raw_len;
+        if (uncompress(reinterpret_cast<Bytef*>(inflated.data()), &out_len,
+                       reinterpret_cast<const Bytef*>(body), stored) != Z_OK || out_len != raw_len) {
+            break;
+        }
+        if (!fn(inflated.data(), inflated.size())) break;
+#else
+        throw std::runtime_error("WAL block is zlib-compressed but this build has no zlib");
+#endif
+    }
+}
@@ -0,0 +1,278 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if !defined(HAVANA_NO_IO_URING) && __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define HAVANA_HAS_IO_URING 1
+#endif
+
+// Direct I/O 的对齐粒度 (扇区/页)
+constexpr size_t WAL_BLOCK = 4096;
+// 每次预分配的段大小：文件长度提前定好，fdatasync 不用再刷文件大小这类元数据
+constexpr size_t WAL_SEGMENT_BYTES = 64ull << 20;
+
+#ifdef HAVANA_HAS_IO_URING
+// 最小的 io_uring 封装：只做 "WRITE -> FSYNC(DATASYNC)" 这一条链
+// 不依赖 liburing，直接用系统调用；内核不支持时构造失败，由 WalFile 退回 pwrite
+class IoUring {
+private:
+    int ring_fd = -1;
+    void* sq_ptr = MAP_FAILED;
+    void* cq_ptr = MAP_FAILED;
+    size_t sq_size = 0, cq_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe* cqes;
+
+    io_uring_sqe* nextSqe(unsigned& tail) {
+        unsigned idx = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[idx] = idx;
+        ++tail;
+        return sqe;
+    }
+
+public:
+    bool init(unsigned entries = 8) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (ring_fd < 0) return false;
+
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_size = cq_size = std::max(sq_size, cq_size);
+
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) return false;
+        cq_ptr = single ? sq_ptr
+                        : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) return false;
+        sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(s);
+
+        char* sq = static_cast<char*>(sq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        char* cq = static_cast<char*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    ~IoUring() {
+        if (sqes) munmap(sqes, sqes_size);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+        if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+        if (ring_fd >= 0) close(ring_fd);
+    }
+
+    // 一次提交 写 + 数据同步 (链式，写成功才同步)，等两者都完成
+    // 返回写入的字节数，出错返回 -errno
+    long writeAndSync(int fd, const void* buf, size_t len, uint64_t offset, bool sync) {
+        unsigned tail = *sq_tail;
+        io_uring_sqe* w = nextSqe(tail);
+        w->opcode = IORING_OP_WRITE;
+        w->fd = fd;
+        w->addr = reinterpret_cast<uint64_t>(buf);
+        w->len = static_cast<uint32_t>(len);
+        w->off = offset;
+        unsigned submit = 1;
+        if (sync) {
+            w->flags = IOSQE_IO_LINK;
+            io_uring_sqe* f = nextSqe(tail);
+            f->opcode = IORING_OP_FSYNC;
+            f->fd = fd;
+            f->fsync_flags = IORING_FSYNC_DATASYNC;
+            submit = 2;
+        }
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+        long ret = syscall(__NR_io_uring_enter, ring_fd, submit, submit, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0) return -errno;
+
+        // 收割完成事件：第一个是写，第二个是 fsync
+        long written = 0;
+        for (unsigned done = 0; done < submit; ++done) {
+            unsigned head = *cq_head;
+            while (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                if (syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) return -errno;
+            }
+            const io_uring_cqe& cqe = cqes[head & *cq_mask];
+            if (done == 0) written = cqe.res;
+            else if (cqe.res < 0 && written >= 0) written = cqe.res;
+            __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        }
+        return written;
+    }
+};
+#endif
+
+// WAL 文件：O_DIRECT 对齐写 + 预分配 + fdatasync
+// - 所有写都是 WAL_BLOCK 对齐的整块，最后不满一块的尾巴留在缓冲里，下次连同新数据一起重写
+// - 文件按 WAL_SEGMENT_BYTES 预分配 (未写部分是 0)，日志格式里长度为 0 的记录表示结束
+// - 有 io_uring 时写和 fdatasync 一次提交；否则 pwrite + fdatasync
+class WalFile {
+private:
+    std::string path;
+    int fd = -1;
+    bool direct = false;
+    char* buf = nullptr;        // 对齐缓冲：[尾巴][新数据]
+    size_t buf_cap = 0;
+    size_t tail_len = 0;        // 缓冲开头有多少字节属于还没写满的最后一块
+    uint64_t block_pos = 0;     // 最后一块在文件里的 (对齐) 偏移
+    uint64_t allocated = 0;     // 已经预分配的文件长度
+#ifdef HAVANA_HAS_IO_URING
+    IoUring ring;
+    bool use_ring = false;
+#endif
+
+    void ensureBuffer(size_t need) {
+        if (need <= buf_cap) return;
+        size_t cap = std::max(need, buf_cap * 2);
+        cap = (cap + WAL_BLOCK - 1) / WAL_BLOCK * WAL_BLOCK;
+        void* p = nullptr;
+        if (posix_memalign(&p, WAL_BLOCK, cap) != 0) throw std::bad_alloc();
+        if (buf) {
+            std::memcpy(p, buf, tail_len);
+            std::free(buf);
+        }
+        buf = static_cast<char*>(p);
+        buf_cap = cap;
+    }
+
+    void preallocate(uint64_t upto) {
+        if (upto <= allocated) return;
+        uint64_t target = (upto + WAL_SEGMENT_BYTES - 1) / WAL_SEGMENT_BYTES * WAL_SEGMENT_BYTES;
+        // 真正分配块并把文件长度设好 (不是 KEEP_SIZE)，之后的 fdatasync 只刷数据
+        if (posix_fallocate(fd, 0, static_cast<off_t>(target)) != 0) {
+            if (ftruncate(fd, static_cast<off_t>(target)) != 0) throw std::runtime_error("Cannot extend WAL: " + path);
+        }
+        allocated = target;
+    }
+
+    void writeAt(const char* data, size_t len, uint64_t offset, bool sync) {
+#ifdef HAVANA_HAS_IO_URING
+        if (use_ring) {
+            long n = ring.writeAndSync(fd, data, len, offset, sync);
+            if (n == static_cast<long>(len)) return;
+            use_ring = false; // 出错或短写：剩下的交给 pwrite 路径重做
+        }
+#endif
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = pwrite(fd, data + done, len - done, static_cast<off_t>(offset + done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("WAL write failed: " + path);
+            }
+            done += static_cast<size_t>(n);
+        }
+        if (sync && fdatasync(fd) != 0) throw std::runtime_error("WAL fdatasync failed: " + path);
+    }
+
+public:
+    // start_offset: 已有日志的逻辑长度 (从这里接着写)；新文件传 0
+    WalFile(const std::string& file_path, bool truncate, uint64_t start_offset = 0) : path(file_path) {
+        int flags = O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0);
+        fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        direct = fd >= 0;
+        if (fd < 0) fd = ::open(path.c_str(), flags, 0644); // 文件系统不支持 O_DIRECT (如 tmpfs)
+        if (fd < 0) throw std::runtime_error("Cannot open WAL: " + path);
+
+        struct stat st;
+        if (fstat(fd, &st) == 0) allocated = static_cast<uint64_t>(st.st_size);
+
+        ensureBuffer(WAL_BLOCK * 16);
+        block_pos = start_offset / WAL_BLOCK * WAL_BLOCK;
+        tail_len = start_offset - block_pos;
+        if (tail_len > 0) {
+            // 把最后一块不满的部分读回缓冲 (对齐读)
+            if (pread(fd, buf, WAL_BLOCK, static_cast<off_t>(block_pos)) < static_cast<ssize_t>(tail_len)) {
+                throw std::runtime_error("Cannot read WAL tail: " + path);
+            }
+        }
+        preallocate(start_offset + 1);
+
+#ifdef HAVANA_HAS_IO_URING
+        use_ring = ring.init();
+#endif
+    }
+
+    ~WalFile() {
+        // 正常关闭时把预分配的尾巴裁掉，退役的段只占实际写入的大小
+        if (fd >= 0 && ftruncate(fd, static_cast<off_t>(logicalSize())) != 0) {}
+        if (fd >= 0) ::close(fd);
+        std::free(buf);
+    }
+
+    WalFile(const WalFile&) = delete;
+    WalFile& operator=(const WalFile&) = delete;
+
+    // 追加一批字节；sync = true 时返回前数据已经 fdatasync 到盘上
+    void append(const char* data, size_t len, bool sync) {
+        if (len == 0) {
+            if (sync) this->sync(); // 没有新数据也要把之前没同步的写刷下去，失败照样抛
+            return;
+        }
+        ensureBuffer(tail_len + len + WAL_BLOCK);
+        std::memcpy(buf + tail_len, data, len);
+        size_t total = tail_len + len;
+        size_t padded = (total + WAL_BLOCK - 1) / WAL_BLOCK * WAL_BLOCK;
+        std::memset(buf + total, 0, padded - total); // 尾部补 0 = 日志结束标记
+
+        preallocate(block_pos + padded);
+        writeAt(buf, padded, block_pos, sync);
+
+        // 整块已经落定，只把最后不满的一块留在缓冲开头
+        size_t full = total / WAL_BLOCK * WAL_BLOCK;
+        tail_len = total - full;
+        if (full > 0 && tail_len > 0) std::memmove(buf, buf + full, tail_len);
+        block_pos += full;
+    }
+
+    void sync() {
+        if (fdatasync(fd) != 0) throw std::runtime_error("WAL fdatasync failed: " + path);
+    }
+
+    // 清空 (checkpoint 之后)：长度归零再重新预分配
+    void reset() {
+        if (ftruncate(fd, 0) != 0) throw std::runtime_error("Cannot truncate WAL: " + path);
+        allocated = 0;
+        block_pos = 0;
+        tail_len = 0;
+        preallocate(1);
+        sync();
+    }
+
+    uint64_t logicalSize() const { return block_pos + tail_len; }
+    bool isDirect() const { return direct; }
+
+    const char* backendName() const {
+#ifdef HAVANA_HAS_IO_URING
+        if (use_ring) return direct ? "io_uring+O_DIRECT" : "io_uring";
+#endif
+        return direct ? "pwrite+O_DIRECT" : "pwrite";
+    }
+};
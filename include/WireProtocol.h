@@ -0,0 +1,347 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "Table.h"
+
+// --- 服务端 / 客户端之间的二进制协议 ---
+// 请求帧: u32 长度 (不含这 4 字节) | u8 操作码 | u32 请求号 | 负载
+// 响应帧: u32 长度 (不含这 4 字节) | u8 状态   | u32 请求号 | 负载
+// 整数都是本机字节序 (只走本机的 Unix socket / 回环 TCP)
+// 流水线：客户端可以连发多个请求不等响应；同一个连接上的请求按发送顺序执行，响应也按这个顺序回来
+//
+// 操作码和负载：
+//   PING          空                                   -> 空
+//   SQL           一条 SQL 文本 (任意语句)              -> 文本 (shell 里会打印的内容)
+//   QUERY         一条 SELECT                           -> 二进制结果流 (BinaryResultWriter 的格式)
+//                 按批分成多帧：若干帧 STATUS_MORE，最后一帧 OK (或 ERROR)，负载按顺序拼起来是完整的结果流
+//   PREPARE       带 ? 的 INSERT                        -> u32 语句号 (只在这个连接里有效)
+//   INSERT_BATCH  u32 语句号 | u32 行数 | 每行的参数值  -> u64 插入的行数
+//                 参数值: u8 类型 (0 = INT, 1 = STRING, 2 = NULL) | INT: i32 | STRING: u32 长度 + 字节 | NULL: 空
+// 出错时状态是 STATUS_ERROR，负载是错误信息
+
+// 一帧最大 64MB：长度字段超过这个就当作协议错误断开
+constexpr uint32_t WIRE_MAX_FRAME = 64u << 20;
+// 帧头：长度 + 操作码 / 状态 + 请求号
+constexpr size_t WIRE_HEADER_SIZE = 4 + 1 + 4;
+
+enum WireOp : uint8_t {
+    WIRE_PING = 0,
+    WIRE_SQL = 1,
+    WIRE_QUERY = 2,
+    WIRE_PREPARE = 3,
+    WIRE_INSERT_BATCH = 4,
+};
+
+enum WireStatus : uint8_t {
+    WIRE_OK = 0,
+    WIRE_ERROR = 1,
+    WIRE_MORE = 2,  // 流式响应的中间一帧，同一个请求后面还有
+};
+
+// 解出来的一帧 (请求和响应共用：code 是操作码或状态)
+struct WireFrame {
+    uint8_t code = 0;
+    uint32_t id = 0;
+    std::string payload;
+};
+
+// --- 编码 ---
+class WireWriter {
+private:
+    std::string& buf;
+    size_t frame_start = 0;
+
+public:
+    explicit WireWriter(std::string& b) : buf(b) {}
+
+    template <typename T>
+    void put(const T& v) {
+        buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    void putBytes(std::string_view s) { buf.append(s.data(), s.size()); }
+
+    void putString(std::string_view s) {
+        put(static_cast<uint32_t>(s.size()));
+        putBytes(s);
+    }
+
+    void putValue(const Table::Value& v) {
+        if (const int* i = std::get_if<int>(&v)) {
+            put(static_cast<uint8_t>(0));
+            put(static_cast<int32_t>(*i));
+        } else if (const std::string* s = std::get_if<std::string>(&v)) {
+            put(static_cast<uint8_t>(1));
+            putString(*s);
+        } else {
+            put(static_cast<uint8_t>(2));
+        }
+    }
+
+    // 帧头先占位，endFrame 时回填长度
+    void beginFrame(uint8_t code, uint32_t id) {
+        frame_start = buf.size();
+        put(static_cast<uint32_t>(0));
+        put(code);
+        put(id);
+    }
+
+    void endFrame() {
+        uint32_t len = static_cast<uint32_t>(buf.size() - frame_start - sizeof(uint32_t));
+        std::memcpy(&buf[frame_start], &len, sizeof(len));
+    }
+
+    void frame(uint8_t code, uint32_t id, std::string_view payload) {
+        beginFrame(code, id);
+        putBytes(payload);
+        endFrame();
+    }
+};
+
+// --- 解码 ---
+class WireReader {
+private:
+    std::string_view in;
+    size_t pos = 0;
+
+public:
+    explicit WireReader(std::string_view data) : in(data) {}
+
+    const char* take(size_t n) {
+        if (in.size() - pos < n) throw std::runtime_error("Malformed request: truncated payload");
+        const char* p = in.data() + pos;
+        pos += n;
+        return p;
+    }
+
+    template <typename T>
+    T get() {
+        T v;
+        std::memcpy(&v, take(sizeof(T)), sizeof(T));
+        return v;
+    }
+
+    std::string_view getString() {
+        uint32_t len = get<uint32_t>();
+        return std::string_view(take(len), len);
+    }
+
+    // 参数值读进 out (复用 string 的内存)
+    void getValue(Table::Value& out) {
+        uint8_t type = get<uint8_t>();
+        if (type == 0) {
+            out = static_cast<int>(get<int32_t>());
+        } else if (type == 1) {
+            std::string_view s = getString();
+            if (std::string* str = std::get_if<std::string>(&out)) str->assign(s.data(), s.size());
+            else out = std::string(s);
+        } else if (type == 2) {
+            out = std::monostate{};
+        } else {
+            throw std::runtime_error("Malformed request: unknown value type " + std::to_string(type));
+        }
+    }
+
+    bool atEnd() const { return pos == in.size(); }
+};
+
+// 从 buf[pos..] 解出一帧：不完整返回 false (pos 不动)；长度非法抛 runtime_error
+inline bool parseFrame(const std::string& buf, size_t& pos, WireFrame& frame) {
+    if (buf.size() - pos < sizeof(uint32_t)) return false;
+    uint32_t len;
+    std::memcpy(&len, buf.data() + pos, sizeof(len));
+    if (len < WIRE_HEADER_SIZE - sizeof(uint32_t) || len > WIRE_MAX_FRAME) {
+        throw std::runtime_error("Bad frame length " + std::to_string(len));
+    }
+    if (buf.size() - pos - sizeof(uint32_t) < len) return false;
+    const char* p = buf.data() + pos + sizeof(uint32_t);
+    frame.code = static_cast<uint8_t>(p[0]);
+    std::memcpy(&frame.id, p + 1, sizeof(frame.id));
+    frame.payload.assign(p + 5, len - 5);
+    pos += sizeof(uint32_t) + len;
+    return true;
+}
+
+// --- 地址 ---
+// "unix:/path/to/sock"、"/path/to/sock" (Unix socket) 或 "host:port" / "port" (回环 TCP)
+struct WireAddress {
+    bool is_unix = true;
+    std::string path;
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;
+
+    static WireAddress parse(const std::string& s) {
+        WireAddress a;
+        if (s.rfind("unix:", 0) == 0) {
+            a.path = s.substr(5);
+        } else if (!s.empty() && s[0] == '/') {
+            a.path = s;
+        } else {
+            a.is_unix = false;
+            size_t colon = s.rfind(':');
+            if (colon != std::string::npos) a.host = s.substr(0, colon);
+            a.port = static_cast<uint16_t>(std::stoul(colon == std::string::npos ? s : s.substr(colon + 1)));
+        }
+        return a;
+    }
+
+    std::string text() const { return is_unix ? "unix:" + path : host + ":" + std::to_string(port); }
+};
+
+inline std::string socketError(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+// --- 阻塞客户端 (压测工具和测试用) ---
+// 发送可以先攒在缓冲里 (queue*)，flush 一次写出去，这样流水线里的多个请求只要一次系统调用
+// 一个客户端对象只给一个线程用
+class WireClient {
+private:
+    int fd = -1;
+    uint32_t next_id = 1;
+    std::string out;      // 待发送
+    std::string in;       // 已收到、还没解析的字节
+    size_t in_pos = 0;
+
+public:
+    explicit WireClient(const WireAddress& addr) {
+        if (addr.is_unix) {
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0) throw std::runtime_error(socketError("socket"));
+            sockaddr_un sa{};
+            sa.sun_family = AF_UNIX;
+            if (addr.path.size() >= sizeof(sa.sun_path)) throw std::runtime_error("Socket path too long: " + addr.path);
+            std::memcpy(sa.sun_path, addr.path.c_str(), addr.path.size() + 1);
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) < 0) {
+                std::string err = socketError("connect " + addr.text());
+                ::close(fd);
+                throw std::runtime_error(err);
+            }
+        } else {
+            fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (fd < 0) throw std::runtime_error(socketError("socket"));
+            sockaddr_in sa{};
+            sa.sin_family = AF_INET;
+            sa.sin_port = htons(addr.port);
+            if (::inet_pton(AF_INET, addr.host.c_str(), &sa.sin_addr) != 1) {
+                ::close(fd);
+                throw std::runtime_error("Bad IPv4 address: " + addr.host);
+            }
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) < 0) {
+                std::string err = socketError("connect " + addr.text());
+                ::close(fd);
+                throw std::runtime_error(err);
+            }
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+    }
+
+    ~WireClient() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    WireClient(const WireClient&) = delete;
+    WireClient& operator=(const WireClient&) = delete;
+
+    // 排一个请求，返回请求号
+    uint32_t queue(WireOp op, std::string_view payload) {
+        uint32_t id = next_id++;
+        WireWriter(out).frame(op, id, payload);
+        return id;
+    }
+
+    // 排一个批量插入：rows 是按行展开的参数值 (每行 params_per_row 个)
+    uint32_t queueInsertBatch(uint32_t stmt, const std::vector<Table::Value>& values, size_t params_per_row) {
+        uint32_t id = next_id++;
+        WireWriter w(out);
+        w.beginFrame(WIRE_INSERT_BATCH, id);
+        w.put(stmt);
+        w.put(static_cast<uint32_t>(params_per_row ? values.size() / params_per_row : 0));
+        for (const auto& v : values) w.putValue(v);
+        w.endFrame();
+        return id;
+    }
+
+    void flush() {
+        size_t off = 0;
+        while (off < out.size()) {
+            ssize_t n = ::send(fd, out.data() + off, out.size() - off, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(socketError("send"));
+            }
+            off += static_cast<size_t>(n);
+        }
+        out.clear();
+    }
+
+    // 阻塞读下一个请求的完整响应 (流式响应的 MORE 帧拼起来，返回最后一帧的状态)
+    WireFrame receive() {
+        std::string streamed;
+        while (true) {
+            WireFrame frame = receiveFrame();
+            if (frame.code == WIRE_MORE) {
+                streamed += frame.payload;
+                continue;
+            }
+            if (frame.code == WIRE_OK && !streamed.empty()) {
+                streamed += frame.payload;
+                frame.payload = std::move(streamed);
+            }
+            return frame;
+        }
+    }
+
+    // 阻塞读下一帧
+    WireFrame receiveFrame() {
+        WireFrame frame;
+        while (true) {
+            if (parseFrame(in, in_pos, frame)) {
+                // 解析过的前缀攒多了再一次性挪掉
+                if (in_pos > (1u << 20) || in_pos == in.size()) {
+                    in.erase(0, in_pos);
+                    in_pos = 0;
+                }
+                return frame;
+            }
+            char chunk[64 * 1024];
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(socketError("recv"));
+            }
+            if (n == 0) throw std::runtime_error("Connection closed by server");
+            in.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+    // 发一个请求并等它的响应；STATUS_ERROR 抛 runtime_error
+    std::string call(WireOp op, std::string_view payload) {
+        queue(op, payload);
+        flush();
+        WireFrame resp = receive();
+        if (resp.code != WIRE_OK) throw std::runtime_error(resp.payload);
+        return std::move(resp.payload);
+    }
+
+    uint32_t prepare(std::string_view sql) {
+        std::string resp = call(WIRE_PREPARE, sql);
+        uint32_t stmt = 0;
+        if (resp.size() != sizeof(stmt)) throw std::runtime_error("Malformed PREPARE response");
+        std::memcpy(&stmt, resp.data(), sizeof(stmt));
+        return stmt;
+    }
+};
@@ -4,7 +4,11 @@
 #include <chrono>
 #include <atomic>
 #include <iomanip>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 #include "Table.h"
+#include "Database.h"
 
 // 简易计时器
 class Timer {
@@ -32,6 +36,23 @@ void worker(Table* table, int start_id, int count) {
         row[2] = 1; 
         table->insertRow(row);
     }
+    table->releaseRowLease();
+}
+
+// 工作线程 (提交确认版)：不等每一行落盘，每攒 batch 行等最后一个确认 (同一次组提交会覆盖前面的行)
+void worker_token(Table* table, int start_id, int count, int batch) {
+    std::vector<Table::Value> row(3);
+    CommitToken last;
+    for (int i = 0; i < count; ++i) {
+        int id = start_id + i;
+        row[0] = "Prod_" + std::to_string(id);
+        row[1] = id;
+        row[2] = 1;
+        last = table->insertRowAsync(row);
+        if ((i + 1) % batch == 0) last.wait();
+    }
+    last.wait();
+    table->releaseRowLease();
 }
 
 // 1. 逻辑正确性验证 (MVCC + Delta)
@@ -94,6 +115,498 @@ void run_benchmark(const std::string& label, int total_rows, int thread_count) {
     std::cout << "  Read Time (Index Lookup): " << read_ms << " ms" << std::endl;
 }
 
+// 持久化级别对比：同样的写入分别用 ASYNC / GROUP / SYNC
+// GROUP 和 SYNC 每次提交都要等 fdatasync，行数少一些
+void run_durability_benchmark(const std::string& label, Durability level, int total_rows, int thread_count,
+                              size_t log_streams = 1) {
+    Table t("DurableTable", true, level, log_streams);
+    t.createColumn("Key",   TYPE_STRING, AGG_LAST, true);
+    t.createColumn("Price", TYPE_INT,    AGG_LAST);
+    t.createColumn("Qty",   TYPE_INT,    AGG_SUM);
+
+    Timer timer;
+    std::vector<std::thread> threads;
+    int rows_per_thread = total_rows / thread_count;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back(worker, &t, i * rows_per_thread, rows_per_thread);
+    }
+    for (auto& th : threads) th.join();
+
+    double write_ms = std::max(timer.elapsed_ms(), 1.0);
+    long write_tps = (long)((double)total_rows / write_ms * 1000);
+    std::cout << "  " << std::left << std::setw(6) << label << " Streams: " << log_streams
+              << " Rows: " << std::setw(8) << total_rows
+              << " Time: " << std::setw(7) << write_ms << " ms | TPS: " << write_tps << std::endl;
+}
+
+// 提交确认：ASYNC 表 + insertRowAsync，每 batch 行等一次确认，所有行都是持久化的
+void run_token_benchmark(int total_rows, int thread_count, int batch) {
+    Table t("DurableTable", true, DURABILITY_ASYNC);
+    t.createColumn("Key",   TYPE_STRING, AGG_LAST, true);
+    t.createColumn("Price", TYPE_INT,    AGG_LAST);
+    t.createColumn("Qty",   TYPE_INT,    AGG_SUM);
+
+    Timer timer;
+    std::vector<std::thread> threads;
+    int rows_per_thread = total_rows / thread_count;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back(worker_token, &t, i * rows_per_thread, rows_per_thread, batch);
+    }
+    for (auto& th : threads) th.join();
+
+    double write_ms = std::max(timer.elapsed_ms(), 1.0);
+    long write_tps = (long)((double)total_rows / write_ms * 1000);
+    std::cout << "  TOKEN  Rows: " << std::setw(8) << total_rows << " Time: " << std::setw(7) << write_ms
+              << " ms | TPS: " << write_tps << " (wait every " << batch << " rows)" << std::endl;
+
+    // 单线程逐行等确认：看一次提交的延迟 (没有固定的刷盘间隔下限)
+    const int probes = 200;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < probes; ++i) {
+        t.insertRowAsync({std::string("Probe_") + std::to_string(i), i, 1}).wait();
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "  Commit latency (1 thread): " << us / probes << " us avg" << std::endl;
+}
+
+// WAL 体积：distinct_keys 个商品反复下单 (key 重复，数量小)，看每行落盘多少字节
+void run_wal_size_benchmark(const std::string& label, bool block_compression, int total_rows, int distinct_keys) {
+    {
+        WalOptions opts;
+        opts.block_compression = block_compression;
+        Table t("WalSizeTable", true, opts);
+        t.createColumn("Key",   TYPE_STRING, AGG_LAST, true);
+        t.createColumn("Price", TYPE_INT,    AGG_LAST);
+        t.createColumn("Qty",   TYPE_INT,    AGG_SUM);
+
+        std::vector<Table::Value> row(3);
+        for (int i = 0; i < total_rows; ++i) {
+            int key = i % distinct_keys;
+            row[0] = "Prod_" + std::to_string(key);
+            row[1] = 1000 + key % 500;
+            row[2] = 1 + i % 3;
+            t.insertRow(row);
+        }
+        t.releaseRowLease();
+    } // 析构时刷完并裁掉预分配的尾巴
+
+    size_t bytes = 0;
+    for (const auto& entry : std::filesystem::directory_iterator("WalSizeTable.wal")) bytes += entry.file_size();
+    std::cout << "  " << std::left << std::setw(6) << label << " WAL bytes: " << std::setw(10) << bytes
+              << " (" << std::fixed << std::setprecision(2) << (double)bytes / total_rows << " B/row)"
+              << std::defaultfloat << std::endl;
+}
+
+// SQL 导入：同样的行分别走 单行 INSERT / 多行 INSERT / 预编译语句 / 原生 insertRow
+void run_sql_ingest_benchmark(int total_rows) {
+    Database db;
+    db.setVerbose(false);
+    auto report = [&](const std::string& label, double ms) {
+        ms = std::max(ms, 1.0);
+        std::cout << "  " << std::left << std::setw(10) << label << " Rows: " << total_rows
+                  << " Time: " << std::setw(7) << ms << " ms | TPS: " << (long)(total_rows / ms * 1000) << std::endl;
+    };
+    auto create = [&](const std::string& name) {
+        db.executeSQL("CREATE TABLE " + name + " (Key STRING INDEX, Price INT, Qty INT SUM)");
+    };
+
+    create("SqlSingle");
+    Timer timer;
+    for (int i = 0; i < total_rows; ++i) {
+        db.executeSQL("INSERT INTO SqlSingle VALUES (\"Prod_" + std::to_string(i) + "\", " + std::to_string(i) + ", 1)");
+    }
+    report("SINGLE", timer.elapsed_ms());
+
+    create("SqlMulti");
+    const int batch = 100;
+    timer.reset();
+    for (int i = 0; i < total_rows; i += batch) {
+        std::string sql = "INSERT INTO SqlMulti VALUES ";
+        for (int j = i; j < i + batch; ++j) {
+            if (j > i) sql += ", ";
+            sql += "(\"Prod_" + std::to_string(j) + "\", " + std::to_string(j) + ", 1)";
+        }
+        db.executeSQL(sql);
+    }
+    report("MULTI x100", timer.elapsed_ms());
+
+    create("SqlPrepared");
+    auto stmt = db.prepare("INSERT INTO SqlPrepared VALUES (?, ?, 1)");
+    std::vector<Table::Value> params(2);
+    timer.reset();
+    for (int i = 0; i < total_rows; ++i) {
+        params[0] = "Prod_" + std::to_string(i);
+        params[1] = i;
+        stmt->execute(params);
+    }
+    report("PREPARED", timer.elapsed_ms());
+
+    create("SqlNative");
+    Table* t = db.getTable("SqlNative");
+    std::vector<Table::Value> row(3);
+    timer.reset();
+    for (int i = 0; i < total_rows; ++i) {
+        row[0] = "Prod_" + std::to_string(i);
+        row[1] = i;
+        row[2] = 1;
+        t->insertRow(row);
+    }
+    report("NATIVE", timer.elapsed_ms());
+}
+
+// SQL 查询：全表聚合 / 过滤 / 分组 / 索引点查，封存前后各跑一遍
+void run_sql_query_benchmark(int total_rows, int distinct_keys) {
+    Database db;
+    db.setVerbose(false);
+    db.executeSQL("CREATE TABLE SqlQuery (Key STRING INDEX, Price INT, Qty INT SUM)");
+    Table* t = db.getTable("SqlQuery");
+    std::vector<Table::Value> row(3);
+    for (int i = 0; i < total_rows; ++i) {
+        row[0] = "Prod_" + std::to_string(i % distinct_keys);
+        row[1] = i % 1000;
+        row[2] = 1;
+        t->insertRow(row, false);
+    }
+    t->releaseRowLease();
+
+    auto run = [&](const std::string& label, const std::string& sql, int repeat) {
+        Timer timer;
+        size_t rows = 0;
+        for (int r = 0; r < repeat; ++r) rows = db.query(sql).rowCount();
+        double ms = timer.elapsed_ms();
+        std::cout << "  " << std::left << std::setw(10) << label << " Result rows: " << std::setw(6) << rows
+                  << " Time: " << ms << " ms";
+        if (repeat == 1) std::cout << " | " << (long)(total_rows / std::max(ms, 1.0) / 1000) << "M rows/s";
+        else std::cout << " (" << repeat << " queries)";
+        std::cout << std::endl;
+    };
+
+    for (int pass = 0; pass < 2; ++pass) {
+        std::cout << (pass == 0 ? "  -- raw chunks --" : "  -- sealed chunks --") << std::endl;
+        run("SUM", "SELECT SUM(Qty) FROM SqlQuery", 1);
+        run("FILTER", "SELECT COUNT(*), MAX(Key) FROM SqlQuery WHERE Price >= 500 AND Price < 510", 1);
+        run("GROUP BY", "SELECT Key, SUM(Qty), MAX(Price) FROM SqlQuery GROUP BY Key", 1);
+        run("INDEX", "SELECT * FROM SqlQuery WHERE Key = 'Prod_42'", 1000);
+        t->sealChunks();
+    }
+}
+
+// 全表汇总 (混合语义 GROUP BY)：一次并行扫描 vs 逐个 key 调 querySnapshot
+void run_rollup_benchmark(int total_rows, int distinct_keys) {
+    Table table("RollupTable");
+    table.createColumn("Key", TYPE_STRING, AGG_LAST, true);
+    table.createColumn("Price", TYPE_INT, AGG_LAST);
+    table.createColumn("Qty", TYPE_INT, AGG_SUM);
+    std::vector<Table::Value> row(3);
+    for (int i = 0; i < total_rows; ++i) {
+        row[0] = "Prod_" + std::to_string(i % distinct_keys);
+        row[1] = i % 1000;
+        row[2] = 1;
+        table.insertRow(row, false);
+    }
+    table.releaseRowLease();
+    table.sealChunks();
+
+    Snapshot snap = table.openSnapshot();
+    SelectPlan plan = makeRollupPlan(table, "Key");
+    size_t hw = std::max<size_t>(1, std::thread::hardware_concurrency());
+    for (size_t threads : {size_t(1), hw}) {
+        Timer timer;
+        QueryResult r = QueryExecutor::run(plan, snap, threads);
+        double ms = std::max(timer.elapsed_ms(), 1.0);
+        std::cout << "  ROLLUP  Threads: " << threads << " Keys: " << r.rowCount() << " Time: " << ms
+                  << " ms | " << (long)(total_rows / ms / 1000) << "M rows/s" << std::endl;
+        if (hw == 1) break;
+    }
+
+    // 对照：逐 key 点查 (只跑 1000 个 key，按比例估算全部)
+    int sample = std::min(distinct_keys, 1000);
+    Timer timer;
+    for (int k = 0; k < sample; ++k) table.querySnapshot("Key", "Prod_" + std::to_string(k), snap);
+    double ms = timer.elapsed_ms();
+    std::cout << "  PER-KEY querySnapshot: " << ms << " ms for " << sample << " keys (~"
+              << (long)(ms * distinct_keys / sample) << " ms for all)" << std::endl;
+}
+
+// 两表等值连接：事实表 (INT 外键) JOIN 维表，基数分区哈希连接
+void run_join_benchmark(int fact_rows, int dim_rows) {
+    Database db;
+    db.setVerbose(false);
+    db.executeSQL("CREATE TABLE Fact (DimId INT, Amount INT)");
+    db.executeSQL("CREATE TABLE Dim (Id INT, Name STRING)");
+    Table* fact = db.getTable("Fact");
+    Table* dim = db.getTable("Dim");
+    std::vector<Table::Value> row(2);
+    for (int i = 0; i < fact_rows; ++i) {
+        row[0] = static_cast<int>((i * 2654435761u) % (dim_rows * 2)); // 一半能连上
+        row[1] = i % 1000;
+        fact->insertRow(row, false);
+    }
+    for (int i = 0; i < dim_rows; ++i) {
+        row[0] = i;
+        row[1] = "Dim_" + std::to_string(i);
+        dim->insertRow(row, false);
+    }
+    fact->releaseRowLease();
+    dim->releaseRowLease();
+    fact->sealChunks();
+    dim->sealChunks();
+
+    auto run = [&](const std::string& label, const std::string& sql) {
+        Timer timer;
+        QueryResult r = db.query(sql);
+        double ms = std::max(timer.elapsed_ms(), 1.0);
+        std::cout << "  " << std::left << std::setw(10) << label << " Result: " << std::setw(10)
+                  << (r.columns.size() == 1 && r.rowCount() == 1 ? r.columns[0].ints[0] : (int64_t)r.rowCount())
+                  << " Time: " << ms << " ms | " << (long)((fact_rows + dim_rows) / ms / 1000) << "M rows/s" << std::endl;
+    };
+    run("COUNT", "SELECT COUNT(*) FROM Fact f JOIN Dim d ON f.DimId = d.Id");
+    run("FILTER", "SELECT COUNT(*) FROM Fact f JOIN Dim d ON f.DimId = d.Id WHERE f.Amount < 10");
+    run("PROJECT", "SELECT d.Name, f.Amount FROM Fact f JOIN Dim d ON f.DimId = d.Id WHERE f.Amount < 10");
+}
+
+// 批量导入：同样的数据逐行 insertRow vs CSV / 列存文件并行导入
+void run_bulk_load_benchmark(int total_rows, int distinct_keys) {
+    std::string csv_path = "BulkLoad.csv";
+    std::string col_path = "BulkLoad.hvc";
+    {
+        std::ofstream csv(csv_path);
+        ColumnarFileWriter col(col_path, {TYPE_STRING, TYPE_INT, TYPE_INT});
+        std::string line;
+        for (int i = 0; i < total_rows; ++i) {
+            std::string key = "Prod_" + std::to_string(i % distinct_keys);
+            line = key + "," + std::to_string(i % 1000) + ",1\n";
+            csv << line;
+            col.addRow({key, i % 1000, 1});
+        }
+        col.finish();
+    }
+
+    auto make_table = [] {
+        auto t = std::make_unique<Table>("BulkLoad");
+        t->createColumn("Key", TYPE_STRING, AGG_LAST, true);
+        t->createColumn("Price", TYPE_INT, AGG_LAST);
+        t->createColumn("Qty", TYPE_INT, AGG_SUM);
+        return t;
+    };
+    auto report = [&](const std::string& label, double ms) {
+        ms = std::max(ms, 1.0);
+        std::cout << "  " << std::left << std::setw(10) << label << " Time: " << ms << " ms | "
+                  << (long)(total_rows / ms * 1000) << " rows/s" << std::endl;
+    };
+
+    {
+        auto t = make_table();
+        std::vector<Table::Value> row(3);
+        Timer timer;
+        for (int i = 0; i < total_rows; ++i) {
+            row[0] = "Prod_" + std::to_string(i % distinct_keys);
+            row[1] = i % 1000;
+            row[2] = 1;
+            t->insertRow(row, false);
+        }
+        t->releaseRowLease();
+        t->sealChunks();
+        report("INSERT", timer.elapsed_ms());
+    }
+    {
+        auto t = make_table();
+        Timer timer;
+        BulkLoader::loadCsv(*t, csv_path);
+        report("CSV", timer.elapsed_ms());
+    }
+    {
+        auto t = make_table();
+        Timer timer;
+        BulkLoader::loadColumnar(*t, col_path);
+        report("COLUMNAR", timer.elapsed_ms());
+    }
+    std::filesystem::remove(csv_path);
+    std::filesystem::remove(col_path);
+}
+
+// 结果输出：物化后逐值 operator<< vs 游标 + 缓冲序列化 (都写到 /dev/null)
+void run_result_stream_benchmark(int total_rows, int distinct_keys) {
+    Database db;
+    db.setVerbose(false);
+    db.executeSQL("CREATE TABLE Stream (Key STRING INDEX, Price INT, Qty INT SUM)");
+    Table* t = db.getTable("Stream");
+    std::vector<Table::Value> row(3);
+    for (int i = 0; i < total_rows; ++i) {
+        row[0] = "Prod_" + std::to_string(i % distinct_keys);
+        row[1] = i % 1000;
+        row[2] = 1;
+        t->insertRow(row, false);
+    }
+    t->releaseRowLease();
+    t->sealChunks();
+
+    const std::string sql = "SELECT * FROM Stream";
+    std::ofstream null_out("/dev/null");
+    auto report = [&](const std::string& label, size_t rows, double ms) {
+        ms = std::max(ms, 1.0);
+        std::cout << "  " << std::left << std::setw(10) << label << " Rows: " << rows << " Time: " << ms << " ms | "
+                  << (long)(rows / ms * 1000) << " rows/s" << std::endl;
+    };
+
+    {
+        Timer timer;
+        QueryResult r = db.query(sql);
+        size_t rows = r.rowCount();
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t c = 0; c < r.columns.size(); ++c) {
+                if (c > 0) null_out << '\t';
+                if (r.columns[c].type == TYPE_INT) null_out << r.columns[c].ints[i];
+                else null_out << r.columns[c].strings[i];
+            }
+            null_out << '\n';
+        }
+        null_out.flush();
+        report("OSTREAM", rows, timer.elapsed_ms());
+    }
+    {
+        Timer timer;
+        auto cursor = db.openCursor(sql);
+        TextResultWriter writer(null_out);
+        size_t rows = writer.drain(*cursor);
+        report("TEXT", rows, timer.elapsed_ms());
+    }
+    {
+        Timer timer;
+        auto cursor = db.openCursor(sql);
+        BinaryResultWriter writer(null_out);
+        size_t rows = writer.drain(*cursor);
+        report("BINARY", rows, timer.elapsed_ms());
+    }
+}
+
+// 表目录：threads 个线程不停查表 (每条 SQL 都要查一次)，同时另一个线程在建新表
+// 查表不加锁，吞吐应该随线程数涨，也不受建表影响
+void run_catalog_benchmark(int tables, int lookups_per_thread, int thread_count) {
+    Database db;
+    db.setVerbose(false);
+    std::vector<std::string> names;
+    for (int i = 0; i < tables; ++i) {
+        names.push_back("Cat_" + std::to_string(i));
+        db.executeSQL("CREATE TABLE " + names.back() + " (Key STRING, V INT)");
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<int> created{0};
+    std::thread creator([&] {
+        // 没有 DROP TABLE，建的表数封顶，别让 WAL 目录无限多
+        for (int i = 0; i < 200 && !done.load(); ++i) {
+            db.executeSQL("CREATE TABLE CatNew_" + std::to_string(i) + " (Key STRING, V INT)");
+            created++;
+        }
+    });
+
+    std::atomic<long> hits{0};
+    Timer timer;
+    std::vector<std::thread> threads;
+    for (int w = 0; w < thread_count; ++w) {
+        threads.emplace_back([&, w] {
+            long local = 0;
+            for (int i = 0; i < lookups_per_thread; ++i) local += db.getTable(names[(i + w) % tables]) != nullptr;
+            hits += local;
+        });
+    }
+    for (auto& t : threads) t.join();
+    double ms = std::max(timer.elapsed_ms(), 1.0);
+    done = true;
+    creator.join();
+    std::cout << "  Lookups: " << hits.load() << " Time: " << ms << " ms | " << (long)(hits.load() / ms * 1000)
+              << " lookups/s | tables created meanwhile: " << created.load() << std::endl;
+}
+
+// 点查 vs 每个 key 的版本数：只有 AGG_LAST 列的表走版本链拿到最新值就停，带 AGG_SUM 列的表要看完所有版本
+void run_version_chain_benchmark(int keys, int versions, int lookups) {
+    auto run = [&](const std::string& label, bool with_sum) {
+        Table t("ChainBench", false);
+        t.createColumn("Key",   TYPE_STRING, AGG_LAST, true);
+        t.createColumn("Price", TYPE_INT,    AGG_LAST);
+        if (with_sum) t.createColumn("Qty", TYPE_INT, AGG_SUM);
+        std::vector<Table::Value> row(with_sum ? 3 : 2);
+        for (int v = 0; v < versions; ++v) {
+            for (int k = 0; k < keys; ++k) {
+                row[0] = "Key_" + std::to_string(k);
+                row[1] = v;
+                if (with_sum) row[2] = 1;
+                t.insertRow(row);
+            }
+        }
+        t.releaseRowLease();
+
+        Timer timer;
+        long checksum = 0;
+        for (int i = 0; i < lookups; ++i) checksum += t.querySnapshot("Key", "Key_" + std::to_string(i % keys)).size();
+        double ms = std::max(timer.elapsed_ms(), 1.0);
+        std::cout << "  " << label << " versions/key=" << versions << ": " << ms * 1000.0 / lookups << " us/lookup (" << checksum
+                  << " cols)" << std::endl;
+    };
+    run("LAST only", false);
+    run("LAST+SUM ", true);
+}
+
+// 批量点查：同一批随机 key，逐个 querySnapshot vs multiGet (一次一批，共享一个快照) vs multiGetColumns (按列输出)
+// key 数多到索引和列数据放不进缓存，单个点查每一步都是一次缓存未命中
+void run_multi_get_benchmark(int keys, int versions, int batch, int batches) {
+    Table t("MultiGetBench", false);
+    t.createColumn("Key",   TYPE_STRING, AGG_LAST, true);
+    t.createColumn("Price", TYPE_INT,    AGG_LAST);
+    t.createColumn("Qty",   TYPE_INT,    AGG_SUM);
+    std::vector<Table::Value> row(3);
+    for (int v = 0; v < versions; ++v) {
+        for (int k = 0; k < keys; ++k) {
+            row[0] = "Key_" + std::to_string(k);
+            row[1] = v;
+            row[2] = 1;
+            t.insertRow(row);
+        }
+    }
+    t.releaseRowLease();
+
+    std::vector<std::vector<std::string>> requests(batches);
+    uint64_t seed = 42;
+    for (auto& req : requests) {
+        for (int i = 0; i < batch; ++i) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            req.push_back("Key_" + std::to_string((seed >> 33) % keys));
+        }
+    }
+
+    long single_sum = 0, batch_sum = 0;
+    Timer single_timer;
+    for (const auto& req : requests) {
+        Snapshot snap = t.openSnapshot();
+        for (const auto& key : req) single_sum += std::stol(t.querySnapshot("Key", key, snap)["Qty"]);
+    }
+    double single_ms = std::max(single_timer.elapsed_ms(), 1.0);
+
+    Timer batch_timer;
+    for (const auto& req : requests) {
+        for (auto& res : t.multiGet("Key", req)) batch_sum += std::stol(res["Qty"]);
+    }
+    double batch_ms = std::max(batch_timer.elapsed_ms(), 1.0);
+
+    long columns_sum = 0;
+    Timer columns_timer;
+    for (const auto& req : requests) {
+        Snapshot snap = t.openSnapshot();
+        QueryResult res = t.multiGetColumns("Key", req, snap);
+        for (int64_t q : res.columns[2].ints) columns_sum += q;
+    }
+    double columns_ms = std::max(columns_timer.elapsed_ms(), 1.0);
+
+    double lookups = static_cast<double>(batch) * batches;
+    std::cout << "  querySnapshot loop: " << single_ms * 1000.0 / lookups << " us/key" << std::endl;
+    std::cout << "  multiGet (batch " << batch << "): " << batch_ms * 1000.0 / lookups << " us/key (x" << single_ms / batch_ms
+              << ")" << (single_sum == batch_sum ? "" : "  MISMATCH") << std::endl;
+    std::cout << "  multiGetColumns (batch " << batch << "): " << columns_ms * 1000.0 / lookups << " us/key (x"
+              << single_ms / columns_ms << ")" << (single_sum == columns_sum ? "" : "  MISMATCH") << std::endl;
+}
+
 // 3. 崩溃恢复测试
 void test_recovery() {
     std::cout << "\n[5. Recovery Test] Writing, Simulating Crash, Reloading..." << std::endl;
@@ -135,6 +648,41 @@ void test_recovery() {
             std::cout << "  >>> FAIL: Data lost! Got " << res["Val"] << std::endl;
         }
     }
+
+    // --- Phase 3: 时间戳空洞之后重启两次 ---
+    // 失败的写入领了时间戳但不写日志；恢复要按日志里的时间戳提交，重启后的新写入才排在旧记录后面
+    std::string gap_name = "RecoverGapDB";
+    auto open_gap = [&](bool fresh) {
+        auto t = std::make_unique<Table>(gap_name, fresh);
+        t->createColumn("Key", TYPE_STRING, AGG_LAST, true);
+        t->createColumn("Price", TYPE_INT);
+        if (!fresh) t->recover();
+        return t;
+    };
+    {
+        auto t = open_gap(true);
+        t->insertRow({std::string("P"), 1});
+        for (int i = 0; i < 2; ++i) {
+            try {
+                t->insertRow({std::string("P"), std::string("bad")}); // 类型不对：作废，时间戳照样用掉
+            } catch (const std::exception&) {
+            }
+        }
+        t->insertRow({std::string("P"), 2});
+    }
+    {
+        auto t = open_gap(false);
+        t->insertRow({std::string("P"), 3});
+    }
+    {
+        auto t = open_gap(false);
+        auto res = t->querySnapshot("Key", "P");
+        if (res["Price"] == "3") {
+            std::cout << "  >>> PASS: Restart after a timestamp gap keeps commit order" << std::endl;
+        } else {
+            std::cout << "  >>> FAIL: Expected Price 3 after restart, got " << res["Price"] << std::endl;
+        }
+    }
 }
 
 int main() {
@@ -152,5 +700,51 @@ int main() {
 
     test_recovery();
 
+    std::cout << "\n[6. Durability Levels] Threads: 4" << std::endl;
+    {
+        BinaryLogger probe("DurableTable.wal", true);
+        std::cout << "  WAL backend: " << probe.backendName() << std::endl;
+    }
+    run_durability_benchmark("ASYNC", DURABILITY_ASYNC, 1000000, 4);
+    run_durability_benchmark("GROUP", DURABILITY_GROUP, 100000, 4);
+    run_durability_benchmark("SYNC",  DURABILITY_SYNC,  20000, 4);
+    run_durability_benchmark("GROUP", DURABILITY_GROUP, 100000, 4, 4);
+    run_durability_benchmark("SYNC",  DURABILITY_SYNC,  20000, 4, 4);
+    run_token_benchmark(1000000, 4, 64);
+
+    std::cout << "\n[7. WAL Size] 1M rows, 10K distinct keys" << std::endl;
+    run_wal_size_benchmark("PLAIN", false, 1000000, 10000);
+    run_wal_size_benchmark("ZLIB",  true,  1000000, 10000);
+
+    std::cout << "\n[8. SQL Ingest] 1 thread" << std::endl;
+    run_sql_ingest_benchmark(200000);
+
+    std::cout << "\n[9. SQL Query] 5M rows, 10K distinct keys" << std::endl;
+    run_sql_query_benchmark(5000000, 10000);
+
+    std::cout << "\n[10. Rollup] 10M rows, 100K distinct keys" << std::endl;
+    run_rollup_benchmark(10000000, 100000);
+
+    std::cout << "\n[11. Hash Join] 5M fact rows JOIN 100K dim rows" << std::endl;
+    run_join_benchmark(5000000, 100000);
+
+    std::cout << "\n[12. Bulk Load] 5M rows, 100K distinct keys (INSERT = row by row, no WAL)" << std::endl;
+    run_bulk_load_benchmark(5000000, 100000);
+
+    std::cout << "\n[13. Result Streaming] SELECT * over 5M rows to /dev/null" << std::endl;
+    run_result_stream_benchmark(5000000, 100000);
+
+    std::cout << "\n[14. Catalog] 4 threads x 2M table lookups over 100 tables, concurrent CREATE TABLE" << std::endl;
+    run_catalog_benchmark(100, 2000000, 4);
+
+    std::cout << "\n[15. Version Chains] point lookups, 1K keys" << std::endl;
+    run_version_chain_benchmark(1000, 1, 100000);
+    run_version_chain_benchmark(1000, 100, 100000);
+    run_version_chain_benchmark(1000, 1000, 20000);
+
+    std::cout << "\n[16. Multi-Get] 1M keys x 3 versions, random keys" << std::endl;
+    run_multi_get_benchmark(1000000, 3, 256, 2000);
+
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include "WireProtocol.h"
+#include "ResultCursor.h"
+#include "LatencyHistogram.h"
+
+// --- 服务端压测客户端 ---
+// clients 个连接 (每个一个线程) 一共发 ops 个请求，每个连接最多 pipeline 个请求在路上 (流水线)
+// 请求按比例随机选：
+//   INSERT = 预编译的 INSERT 一次带 batch 行 (INSERT_BATCH)
+//   READ   = 按 key 点查的 SELECT (QUERY，二进制结果)
+//   PING   = 空请求 (只测协议和调度的开销)
+// 延迟是从请求发出到收到它的响应 (含排队)；结束后合并各线程的直方图，报告吞吐和 p50 / p99 / p999
+//
+// 用法: ./load_client [--connect=unix:/tmp/havana.sock] [--clients=4] [--ops=100000] [--pipeline=16]
+//                     [--batch=100] [--records=100000] [--insert=I --read=R --ping=P] [--seed=1] [--json=FILE]
+// 表 LoadTest (Key STRING INDEX, Price INT, Qty INT SUM) 不存在时自动建，先装 records 个 key 供 READ 用
+
+enum LoadOp { LOAD_INSERT, LOAD_READ, LOAD_PING, LOAD_OP_COUNT };
+const char* const LOAD_OP_NAMES[LOAD_OP_COUNT] = {"insert", "read", "ping"};
+
+struct LoadConfig {
+    std::string connect = "unix:/tmp/havana.sock";
+    size_t clients = 4;
+    size_t ops = 100000;
+    size_t pipeline = 16;
+    size_t batch = 100;
+    size_t records = 100000;
+    double mix[LOAD_OP_COUNT] = {0.5, 0.5, 0.0};
+    uint64_t seed = 1;
+    std::string json_path;
+};
+
+void printUsage() {
+    std::cout << "Usage: load_client [--connect=unix:PATH|HOST:PORT] [--clients=N] [--ops=N] [--pipeline=N]\n"
+                 "                   [--batch=N] [--records=N] [--insert=P] [--read=P] [--ping=P] [--seed=N] [--json=FILE]"
+              << std::endl;
+}
+
+// 出错返回错误信息，成功返回空串
+std::string parseArgs(int argc, char** argv, LoadConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) return "bad argument '" + arg + "'";
+        std::string key = arg.substr(2, eq - 2);
+        std::string val = arg.substr(eq + 1);
+        try {
+            if (key == "connect") cfg.connect = val;
+            else if (key == "clients") cfg.clients = std::stoul(val);
+            else if (key == "ops") cfg.ops = std::stoul(val);
+            else if (key == "pipeline") cfg.pipeline = std::stoul(val);
+            else if (key == "batch") cfg.batch = std::stoul(val);
+            else if (key == "records") cfg.records = std::stoul(val);
+            else if (key == "insert") cfg.mix[LOAD_INSERT] = std::stod(val);
+            else if (key == "read") cfg.mix[LOAD_READ] = std::stod(val);
+            else if (key == "ping") cfg.mix[LOAD_PING] = std::stod(val);
+            else if (key == "seed") cfg.seed = std::stoull(val);
+            else if (key == "json") cfg.json_path = val;
+            else return "unknown option '--" + key + "'";
+        } catch (const std::exception&) {
+            return "bad value for --" + key + ": '" + val + "'";
+        }
+    }
+
+    double total = 0;
+    for (double p : cfg.mix) {
+        if (p < 0) return "operation proportions must not be negative";
+        total += p;
+    }
+    if (total <= 0) return "operation proportions sum to 0";
+    for (double& p : cfg.mix) p /= total;
+    if (cfg.clients == 0) return "--clients must be at least 1";
+    if (cfg.pipeline == 0) return "--pipeline must be at least 1";
+    if (cfg.batch == 0) return "--batch must be at least 1";
+    if (cfg.records == 0 && cfg.mix[LOAD_READ] > 0) return "--records must be > 0 when the mix has reads";
+    return "";
+}
+
+const char* const LOAD_TABLE_SQL = "CREATE TABLE LoadTest (Key STRING INDEX, Price INT, Qty INT SUM)";
+const char* const LOAD_INSERT_SQL = "INSERT INTO LoadTest VALUES (?, ?, ?)";
+
+std::string keyName(uint64_t id) { return "user" + std::to_string(id); }
+
+void appendRow(std::vector<Table::Value>& values, uint64_t id, std::mt19937_64& rng) {
+    values.emplace_back(keyName(id));
+    values.emplace_back(static_cast<int>(rng() % 1000));
+    values.emplace_back(1);
+}
+
+struct PhaseResult {
+    double ms = 0;
+    uint64_t rows_inserted = 0;
+    uint64_t rows_read = 0;
+    uint64_t errors = 0;
+    LatencyHistogram ops[LOAD_OP_COUNT];
+
+    uint64_t total() const {
+        uint64_t n = 0;
+        for (const auto& h : ops) n += h.count();
+        return n;
+    }
+};
+
+struct alignas(64) ThreadState {
+    uint64_t rows_inserted = 0;
+    uint64_t rows_read = 0;
+    uint64_t errors = 0;
+    std::string first_error;
+    LatencyHistogram ops[LOAD_OP_COUNT];
+};
+
+class LoadRunner {
+private:
+    const LoadConfig& cfg;
+    WireAddress addr;
+    using Clock = std::chrono::steady_clock;
+
+public:
+    LoadRunner(const LoadConfig& c) : cfg(c), addr(WireAddress::parse(c.connect)) {}
+
+    // 建表 (已经有了就算了)，再由 clients 个连接并行装 records 个 key (不计入结果)
+    void setup() {
+        WireClient admin(addr);
+        try {
+            admin.call(WIRE_SQL, LOAD_TABLE_SQL);
+        } catch (const std::exception& e) {
+            if (std::string(e.what()).find("already exists") == std::string::npos) throw;
+        }
+        if (cfg.records == 0) return;
+
+        std::vector<std::thread> threads;
+        std::vector<std::string> errors(cfg.clients);
+        for (size_t w = 0; w < cfg.clients; ++w) {
+            threads.emplace_back([&, w] {
+                try {
+                    WireClient client(addr);
+                    uint32_t stmt = client.prepare(LOAD_INSERT_SQL);
+                    std::mt19937_64 rng(cfg.seed * 31 + w);
+                    std::vector<Table::Value> values;
+                    size_t begin = cfg.records * w / cfg.clients, end = cfg.records * (w + 1) / cfg.clients;
+                    size_t inflight = 0;
+                    for (size_t id = begin; id < end || inflight > 0;) {
+                        for (; id < end && inflight < cfg.pipeline; ++inflight) {
+                            values.clear();
+                            for (size_t stop = std::min(end, id + cfg.batch); id < stop; ++id) appendRow(values, id, rng);
+                            client.queueInsertBatch(stmt, values, 3);
+                        }
+                        client.flush();
+                        WireFrame resp = client.receive();
+                        inflight--;
+                        if (resp.code != WIRE_OK) throw std::runtime_error(resp.payload);
+                    }
+                } catch (const std::exception& e) {
+                    errors[w] = e.what();
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        for (const auto& e : errors) {
+            if (!e.empty()) throw std::runtime_error("load failed: " + e);
+        }
+    }
+
+    PhaseResult run() {
+        std::vector<ThreadState> states(cfg.clients);
+        std::atomic<uint64_t> next_id{cfg.records};
+        auto start = Clock::now();
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < cfg.clients; ++w) {
+            threads.emplace_back([&, w] {
+                ThreadState& st = states[w];
+                try {
+                    runClient(w, st, next_id);
+                } catch (const std::exception& e) {
+                    st.errors++;
+                    if (st.first_error.empty()) st.first_error = e.what();
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+
+        PhaseResult res;
+        res.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        for (const auto& s : states) {
+            res.rows_inserted += s.rows_inserted;
+            res.rows_read += s.rows_read;
+            res.errors += s.errors;
+            for (int op = 0; op < LOAD_OP_COUNT; ++op) res.ops[op].merge(s.ops[op]);
+            if (!s.first_error.empty()) std::cout << "  client error: " << s.first_error << std::endl;
+        }
+        return res;
+    }
+
+private:
+    // 一个连接：窗口里始终保持 pipeline 个请求，收到一个响应就补一个
+    void runClient(size_t w, ThreadState& st, std::atomic<uint64_t>& next_id) {
+        WireClient client(addr);
+        uint32_t stmt = client.prepare(LOAD_INSERT_SQL);
+        std::mt19937_64 rng(cfg.seed * 7919 + w + 1);
+        std::uniform_real_distribution<double> u01(0.0, 1.0);
+        std::vector<Table::Value> values;
+
+        struct InFlight {
+            int op;
+            Clock::time_point sent;
+        };
+        std::deque<InFlight> window; // 响应按发送顺序回来
+        size_t count = cfg.ops * (w + 1) / cfg.clients - cfg.ops * w / cfg.clients;
+        size_t sent = 0;
+
+        while (sent < count || !window.empty()) {
+            for (; sent < count && window.size() < cfg.pipeline; ++sent) {
+                double p = u01(rng);
+                int op = 0;
+                while (op < LOAD_OP_COUNT - 1 && p >= cfg.mix[op]) p -= cfg.mix[op++];
+
+                switch (op) {
+                    case LOAD_INSERT: {
+                        values.clear();
+                        uint64_t first = next_id.fetch_add(cfg.batch);
+                        for (size_t i = 0; i < cfg.batch; ++i) appendRow(values, first + i, rng);
+                        client.queueInsertBatch(stmt, values, 3);
+                        break;
+                    }
+                    case LOAD_READ: {
+                        uint64_t id = rng() % cfg.records;
+                        client.queue(WIRE_QUERY, "SELECT Key, Price FROM LoadTest WHERE Key = '" + keyName(id) + "'");
+                        break;
+                    }
+                    default:
+                        client.queue(WIRE_PING, {});
+                }
+                window.push_back({op, Clock::now()});
+            }
+            client.flush();
+
+            WireFrame resp = client.receive();
+            InFlight req = window.front();
+            window.pop_front();
+            st.ops[req.op].record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - req.sent).count());
+            if (resp.code != WIRE_OK) {
+                st.errors++;
+                if (st.first_error.empty()) st.first_error = resp.payload;
+                continue;
+            }
+            if (req.op == LOAD_INSERT) {
+                uint64_t n = 0;
+                if (resp.payload.size() == sizeof(n)) std::memcpy(&n, resp.payload.data(), sizeof(n));
+                st.rows_inserted += n;
+            } else if (req.op == LOAD_READ) {
+                st.rows_read += BinaryResultReader(resp.payload).read().rowCount();
+            }
+        }
+    }
+};
+
+// --- 输出 ---
+double perSec(uint64_t n, double ms) { return ms > 0 ? n / ms * 1000.0 : 0.0; }
+
+void printResult(const PhaseResult& res) {
+    std::cout << "[RUN] " << res.total() << " requests in " << std::fixed << std::setprecision(1) << res.ms << " ms | "
+              << std::setprecision(0) << perSec(res.total(), res.ms) << " req/s | " << perSec(res.rows_inserted, res.ms)
+              << " rows inserted/s | " << res.rows_read << " rows read | " << res.errors << " errors" << std::endl;
+    for (int op = 0; op < LOAD_OP_COUNT; ++op) {
+        const LatencyHistogram& h = res.ops[op];
+        if (h.count() == 0) continue;
+        std::cout << "  " << std::left << std::setw(7) << LOAD_OP_NAMES[op] << std::right << std::setprecision(2)
+                  << " count " << std::setw(9) << h.count() << " | us: mean " << std::setw(8) << h.mean() / 1000.0
+                  << " p50 " << std::setw(8) << h.percentile(0.50) / 1000.0
+                  << " p99 " << std::setw(8) << h.percentile(0.99) / 1000.0
+                  << " p999 " << std::setw(9) << h.percentile(0.999) / 1000.0
+                  << " max " << std::setw(10) << h.max() / 1000.0 << std::endl;
+    }
+}
+
+void writeJson(const std::string& path, const LoadConfig& cfg, const PhaseResult& res) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Cannot open " + path);
+    out << std::setprecision(6);
+    out << "{\n  \"config\": {\"connect\": \"" << cfg.connect << "\", \"clients\": " << cfg.clients << ", \"ops\": " << cfg.ops
+        << ", \"pipeline\": " << cfg.pipeline << ", \"batch\": " << cfg.batch << ", \"records\": " << cfg.records
+        << ", \"seed\": " << cfg.seed << ", \"mix\": {";
+    for (int op = 0; op < LOAD_OP_COUNT; ++op) out << (op ? ", " : "") << "\"" << LOAD_OP_NAMES[op] << "\": " << cfg.mix[op];
+    out << "}},\n  \"run\": {\"ms\": " << res.ms << ", \"requests\": " << res.total()
+        << ", \"requests_per_sec\": " << perSec(res.total(), res.ms) << ", \"rows_inserted\": " << res.rows_inserted
+        << ", \"rows_read\": " << res.rows_read << ", \"errors\": " << res.errors << ", \"latency_ns\": {";
+    bool first = true;
+    for (int op = 0; op < LOAD_OP_COUNT; ++op) {
+        const LatencyHistogram& h = res.ops[op];
+        if (h.count() == 0) continue;
+        out << (first ? "" : ", ") << "\"" << LOAD_OP_NAMES[op] << "\": {\"count\": " << h.count() << ", \"mean\": " << h.mean()
+            << ", \"min\": " << h.min() << ", \"p50\": " << h.percentile(0.50) << ", \"p99\": " << h.percentile(0.99)
+            << ", \"p999\": " << h.percentile(0.999) << ", \"max\": " << h.max() << "}";
+        first = false;
+    }
+    out << "}}\n}\n";
+}
+
+int main(int argc, char** argv) {
+    LoadConfig cfg;
+    std::string err = parseArgs(argc, argv, cfg);
+    if (!err.empty()) {
+        std::cout << "Error: " << err << std::endl;
+        printUsage();
+        return 1;
+    }
+
+    std::cout << "=== HavanaDB Load Client ===" << std::endl;
+    std::cout << "server " << cfg.connect << " | clients " << cfg.clients << " | ops " << cfg.ops << " | pipeline "
+              << cfg.pipeline << " | batch " << cfg.batch << " | records " << cfg.records << std::endl;
+    std::cout << "mix:";
+    for (int op = 0; op < LOAD_OP_COUNT; ++op) {
+        if (cfg.mix[op] > 0) std::cout << " " << LOAD_OP_NAMES[op] << " " << cfg.mix[op] * 100 << "%";
+    }
+    std::cout << std::endl;
+
+    try {
+        LoadRunner runner(cfg);
+        auto t0 = std::chrono::steady_clock::now();
+        runner.setup();
+        std::cout << "[SETUP] " << cfg.records << " keys loaded in " << std::fixed << std::setprecision(1)
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() << " ms"
+                  << std::endl;
+        PhaseResult res = runner.run();
+        printResult(res);
+        if (!cfg.json_path.empty()) {
+            writeJson(cfg.json_path, cfg, res);
+            std::cout << "Results written to " << cfg.json_path << std::endl;
+        }
+        return res.errors ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -16,19 +16,17 @@ int main() {
     myTable.insertRow({std::string("Tires"), 100, 50});
 
     // 2. 业务动作：涨价了！价格变成 120
-    // 注意：Stock 填 0，表示库存没变。
     // 在 Delta 架构下，我们不需要读旧数据，直接插入“价格变更事件”。
-    myTable.insertRow({std::string("Tires"), 120, 0});
+    // 库存没变：Stock 填 NULL (std::monostate)，这一行只带变了的列 (稀疏行)
+    const Table::Value NONE = std::monostate{};
+    myTable.insertRow({std::string("Tires"), 120, NONE});
 
     // 3. 业务动作：卖出了 5 个
-    // 注意：Price 填 0 或任意值？
-    // 如果填 0，会被 AGG_LAST 忽略（只要我们保证涨价那条的时间戳更新）。
-    // 但为了严谨，通常会填入“当前已知价格”或者设计 Null 值。
-    // 这里我们假设填 0，且涨价发生在前，所以最终会取到 120。
-    myTable.insertRow({std::string("Tires"), 0, -5});
+    // 价格没变：Price 填 NULL，AGG_LAST 会跳过它，而不是被一个假的 0 覆盖
+    myTable.insertRow({std::string("Tires"), NONE, -5});
 
     // 4. 业务动作：又入库 10 个
-    myTable.insertRow({std::string("Tires"), 0, 10});
+    myTable.insertRow({std::string("Tires"), NONE, 10});
 
     // --- 查询时刻 ---
     // 数据库里现在有 4 条记录。查询引擎会自动“折叠”它们。
@@ -37,13 +35,10 @@ int main() {
 
     std::cout << "Product: " << result["Product"] << std::endl;
     std::cout << "Price (Last Write): " << result["Price"] << std::endl; 
-    // 预期：120 (因为第2条记录时间比第1条晚，且后两条如果你处理得当应该被忽略或保持)
-    // *代码里的 bug 提示*：如果第4条记录 Price 是 0 且时间最新，它会覆盖成 0。
-    // *修正*：通常 Delta Update 时，普通属性如果不改，应该填 Null，代码里遇到 Null 跳过。
-    // 简单起见，我们假设 Price 0 表示无效。
+    // 预期：120 (第 3、4 条记录的 Price 是 NULL，不参与 AGG_LAST)
 
     std::cout << "Stock (Sum): " << result["Stock"] << std::endl;
-    // 预期：50 + 0 - 5 + 10 = 55
+    // 预期：50 - 5 + 10 = 55 (第 2 条记录的 Stock 是 NULL)
     
     return 0;
 }
\ No newline at end of file
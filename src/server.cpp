@@ -0,0 +1,84 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <csignal>
+#include "Server.h"
+
+// --- HavanaDB 服务端 ---
+// 在 Unix socket 和 / 或回环 TCP 上监听，协议见 include/WireProtocol.h，压测客户端见 src/load_client.cpp
+//
+// 用法: ./server [--listen=unix:/tmp/havana.sock] [--listen=127.0.0.1:7070] [--workers=N] [--init=FILE]
+//       --listen 可以给多个；--init 启动前逐行执行一个 SQL 文件 (建表等)
+// Ctrl-C / SIGTERM 退出
+
+namespace {
+Server* g_server = nullptr;
+
+void onSignal(int) {
+    if (g_server) g_server->requestStop();
+}
+}
+
+void printUsage() {
+    std::cout << "Usage: server [--listen=unix:PATH|HOST:PORT ...] [--workers=N] [--init=FILE]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    ServerOptions opts;
+    std::string init_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = eq == std::string::npos ? arg : arg.substr(0, eq);
+        std::string val = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (key == "--listen") opts.listen.push_back(WireAddress::parse(val));
+            else if (key == "--workers") opts.workers = std::stoul(val);
+            else if (key == "--init") init_path = val;
+            else {
+                std::cout << "Error: unknown option '" << arg << "'" << std::endl;
+                printUsage();
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cout << "Error: bad value for " << key << ": '" << val << "'" << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+    if (opts.listen.empty()) opts.listen.push_back(WireAddress::parse("unix:/tmp/havana.sock"));
+
+    Database db;
+    if (!init_path.empty()) {
+        std::ifstream in(init_path);
+        if (!in) {
+            std::cout << "Error: cannot open " << init_path << std::endl;
+            return 1;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) db.executeSQL(line);
+        }
+    }
+
+    Server server(db, opts);
+    try {
+        server.start();
+    } catch (const std::exception& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    g_server = &server;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    std::cout << "=== HavanaDB Server ===" << std::endl;
+    for (const auto& addr : opts.listen) std::cout << "listening on " << addr.text() << std::endl;
+
+    server.run();
+    server.shutdown();
+    g_server = nullptr;
+    std::cout << "Served " << server.requestCount() << " requests on " << server.connectionCount() << " connections." << std::endl;
+    return 0;
+}
@@ -0,0 +1,433 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <random>
+#include <cmath>
+#include <map>
+#include "Table.h"
+#include "LatencyHistogram.h"
+
+// --- YCSB 风格的统一负载压测 ---
+// 1. 装载：threads 个线程并行写入 records 行 (key = user0 .. user{records-1})
+// 2. 运行：threads 个线程一共执行 ops 次操作，按比例随机选 READ / UPDATE / INSERT / RMW
+//    READ = querySnapshot 点查，UPDATE = 给已有 key 写一个新版本，INSERT = 新 key，RMW = 先读再写
+// 3. 每个线程每种操作一个延迟直方图 (纳秒)，结束后合并，报告 p50 / p99 / p999，可选写 JSON
+//
+// 用法: ./workload_bench [--workload=A] [--threads=4] [--records=1000000] [--ops=1000000]
+//                        [--read=R --update=U --insert=I --rmw=M] [--dist=uniform|zipfian|latest]
+//                        [--theta=0.99] [--schema=kv|ints|ycsb] [--durability=none|async|group|sync]
+//                        [--gc_ms=0] [--seed=1] [--json=result.json]
+
+enum OpType { OP_READ, OP_UPDATE, OP_INSERT, OP_RMW, OP_COUNT };
+const char* const OP_NAMES[OP_COUNT] = {"read", "update", "insert", "rmw"};
+
+struct BenchConfig {
+    std::string workload = "A";
+    size_t threads = 4;
+    size_t records = 1000000;
+    size_t ops = 1000000;
+    double mix[OP_COUNT] = {0.5, 0.5, 0.0, 0.0};
+    std::string dist = "zipfian";
+    double theta = 0.99;
+    std::string schema = "kv";
+    std::string durability = "async";
+    int gc_ms = 0;          // > 0：运行期间开后台 GC / 封存线程
+    uint64_t seed = 1;
+    std::string json_path;
+};
+
+// 预设负载 (和 YCSB core workloads 对应；没有 E，表没有有序索引做不了范围扫描)
+// L = 只写入 (原来的 chunking / concurrent 压测)
+bool applyWorkload(BenchConfig& cfg, const std::string& name) {
+    struct Preset {
+        double read, update, insert, rmw;
+        const char* dist;
+    };
+    static const std::map<std::string, Preset> presets = {
+        {"A", {0.50, 0.50, 0.00, 0.00, "zipfian"}},  // 读写各半 (会话存储)
+        {"B", {0.95, 0.05, 0.00, 0.00, "zipfian"}},  // 读多写少 (照片标签)
+        {"C", {1.00, 0.00, 0.00, 0.00, "zipfian"}},  // 只读 (用户资料缓存)
+        {"D", {0.95, 0.00, 0.05, 0.00, "latest"}},   // 读最新写入的 (状态更新)
+        {"F", {0.50, 0.00, 0.00, 0.50, "zipfian"}},  // 读-改-写 (用户数据库)
+        {"L", {0.00, 0.00, 1.00, 0.00, "uniform"}},  // 只插入
+    };
+    auto it = presets.find(name);
+    if (it == presets.end()) return false;
+    cfg.workload = name;
+    cfg.mix[OP_READ] = it->second.read;
+    cfg.mix[OP_UPDATE] = it->second.update;
+    cfg.mix[OP_INSERT] = it->second.insert;
+    cfg.mix[OP_RMW] = it->second.rmw;
+    cfg.dist = it->second.dist;
+    return true;
+}
+
+void printUsage() {
+    std::cout << "Usage: workload_bench [--workload=A|B|C|D|F|L] [--threads=N] [--records=N] [--ops=N]\n"
+                 "                      [--read=P] [--update=P] [--insert=P] [--rmw=P]\n"
+                 "                      [--dist=uniform|zipfian|latest] [--theta=T] [--schema=kv|ints|ycsb]\n"
+                 "                      [--durability=none|async|group|sync] [--gc_ms=N] [--seed=N] [--json=FILE]"
+              << std::endl;
+}
+
+// 出错返回错误信息，成功返回空串
+std::string parseArgs(int argc, char** argv, BenchConfig& cfg) {
+    // 先看 --workload，预设之后再被单独给出的比例覆盖
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--workload=", 0) == 0 && !applyWorkload(cfg, arg.substr(11))) {
+            return "unknown workload '" + arg.substr(11) + "'";
+        }
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) return "bad argument '" + arg + "'";
+        std::string key = arg.substr(2, eq - 2);
+        std::string val = arg.substr(eq + 1);
+        try {
+            if (key == "workload") continue;
+            else if (key == "threads") cfg.threads = std::stoul(val);
+            else if (key == "records") cfg.records = std::stoul(val);
+            else if (key == "ops") cfg.ops = std::stoul(val);
+            else if (key == "read") cfg.mix[OP_READ] = std::stod(val);
+            else if (key == "update") cfg.mix[OP_UPDATE] = std::stod(val);
+            else if (key == "insert") cfg.mix[OP_INSERT] = std::stod(val);
+            else if (key == "rmw") cfg.mix[OP_RMW] = std::stod(val);
+            else if (key == "dist") cfg.dist = val;
+            else if (key == "theta") cfg.theta = std::stod(val);
+            else if (key == "schema") cfg.schema = val;
+            else if (key == "durability") cfg.durability = val;
+            else if (key == "gc_ms") cfg.gc_ms = std::stoi(val);
+            else if (key == "seed") cfg.seed = std::stoull(val);
+            else if (key == "json") cfg.json_path = val;
+            else return "unknown option '--" + key + "'";
+        } catch (const std::exception&) {
+            return "bad value for --" + key + ": '" + val + "'";
+        }
+    }
+
+    double total = 0;
+    for (double p : cfg.mix) {
+        if (p < 0) return "operation proportions must not be negative";
+        total += p;
+    }
+    if (total <= 0) return "operation proportions sum to 0";
+    for (double& p : cfg.mix) p /= total;
+    if (cfg.threads == 0) return "--threads must be at least 1";
+    if (cfg.dist != "uniform" && cfg.dist != "zipfian" && cfg.dist != "latest") return "unknown distribution '" + cfg.dist + "'";
+    if (cfg.theta <= 0 || cfg.theta >= 1) return "--theta must be in (0, 1)";
+    if (cfg.schema != "kv" && cfg.schema != "ints" && cfg.schema != "ycsb") return "unknown schema '" + cfg.schema + "'";
+    if (cfg.schema == "ints" && (cfg.mix[OP_READ] > 0 || cfg.mix[OP_RMW] > 0)) {
+        return "schema 'ints' has no index, only --workload=L / inserts and updates are supported";
+    }
+    if (cfg.records == 0 && (cfg.mix[OP_INSERT] < 1.0)) return "--records must be > 0 unless the workload is insert-only";
+    if (cfg.durability != "none" && cfg.durability != "async" && cfg.durability != "group" && cfg.durability != "sync") {
+        return "unknown durability '" + cfg.durability + "'";
+    }
+    return "";
+}
+
+// --- key 分布 ---
+// Zipf：Gray 等人 "Quickly Generating Billion-Record Synthetic Databases" 的算法 (YCSB ZipfianGenerator)
+// 排名 0 最热；zeta(n) 建表时算一次 (O(n))
+class ZipfGenerator {
+private:
+    uint64_t n;
+    double theta, alpha, zetan, eta, half_pow_theta;
+
+public:
+    ZipfGenerator(uint64_t items, double t) : n(std::max<uint64_t>(items, 1)), theta(t) {
+        zetan = 0;
+        for (uint64_t i = 1; i <= n; ++i) zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+        double zeta2 = 1.0 + std::pow(0.5, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+        half_pow_theta = std::pow(0.5, theta);
+    }
+
+    // u 是 [0, 1) 的均匀随机数
+    uint64_t next(double u) const {
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + half_pow_theta) return 1;
+        uint64_t r = static_cast<uint64_t>(n * std::pow(eta * u - eta + 1.0, alpha));
+        return std::min(r, n - 1);
+    }
+};
+
+// 打散热点：排名相邻的 key 不落在同一块里 (YCSB ScrambledZipfian)
+inline uint64_t fnv1a64(uint64_t v) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+        h ^= (v >> (i * 8)) & 0xff;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// --- 表结构 ---
+// kv   : Key STRING INDEX (LAST), Price INT (LAST), Qty INT (SUM)      与 comp_benchmark 相同
+// ints : ID INT (LAST), Val1 INT (SUM), Val2 INT (SUM)                 纯 INT，没有索引 (原 chunking 压测)
+// ycsb : Key STRING INDEX, Field0..Field9 STRING (每个 100 字节)         YCSB 的 usertable
+constexpr int YCSB_FIELDS = 10;
+constexpr size_t YCSB_FIELD_BYTES = 100;
+
+std::unique_ptr<Table> makeTable(const BenchConfig& cfg) {
+    Durability level = DURABILITY_ASYNC;
+    if (cfg.durability == "group") level = DURABILITY_GROUP;
+    else if (cfg.durability == "sync") level = DURABILITY_SYNC;
+    auto t = std::make_unique<Table>("WorkloadBench", true, level);
+    if (cfg.schema == "kv") {
+        t->createColumn("Key", TYPE_STRING, AGG_LAST, true);
+        t->createColumn("Price", TYPE_INT, AGG_LAST);
+        t->createColumn("Qty", TYPE_INT, AGG_SUM);
+    } else if (cfg.schema == "ints") {
+        t->createColumn("ID", TYPE_INT, AGG_LAST);
+        t->createColumn("Val1", TYPE_INT, AGG_SUM);
+        t->createColumn("Val2", TYPE_INT, AGG_SUM);
+    } else {
+        t->createColumn("Key", TYPE_STRING, AGG_LAST, true);
+        for (int f = 0; f < YCSB_FIELDS; ++f) t->createColumn("Field" + std::to_string(f), TYPE_STRING, AGG_LAST);
+    }
+    return t;
+}
+
+std::string keyName(uint64_t id) { return "user" + std::to_string(id); }
+
+// 按表结构填一行 (row 复用，只改值)
+void fillRow(const BenchConfig& cfg, uint64_t id, std::mt19937_64& rng, std::vector<Table::Value>& row) {
+    if (cfg.schema == "kv") {
+        row.resize(3);
+        row[0] = keyName(id);
+        row[1] = static_cast<int>(rng() % 1000);
+        row[2] = 1;
+    } else if (cfg.schema == "ints") {
+        row.resize(3);
+        row[0] = static_cast<int>(id);
+        row[1] = static_cast<int>(rng() % 1000);
+        row[2] = 1;
+    } else {
+        row.resize(1 + YCSB_FIELDS);
+        row[0] = keyName(id);
+        for (int f = 1; f <= YCSB_FIELDS; ++f) {
+            std::string v(YCSB_FIELD_BYTES, 'a');
+            uint64_t bits = rng();
+            for (size_t i = 0; i < v.size(); ++i, bits = bits * 6364136223846793005ULL + 1) v[i] = 'a' + (bits >> 59);
+            row[f] = std::move(v);
+        }
+    }
+}
+
+// 一个阶段的结果：每种操作一个直方图 (纳秒)
+struct PhaseResult {
+    double ms = 0;
+    LatencyHistogram ops[OP_COUNT];
+
+    uint64_t total() const {
+        uint64_t n = 0;
+        for (const auto& h : ops) n += h.count();
+        return n;
+    }
+};
+
+// 每个线程一份，按缓存行对齐避免伪共享
+struct alignas(64) ThreadState {
+    LatencyHistogram ops[OP_COUNT];
+};
+
+class WorkloadRunner {
+private:
+    const BenchConfig& cfg;
+    Table& table;
+    std::atomic<uint64_t> next_id;          // 下一个新 key (INSERT 用)
+    std::unique_ptr<ZipfGenerator> zipf;
+    bool log_writes;
+
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t chooseKey(std::mt19937_64& rng, std::uniform_real_distribution<double>& u01) const {
+        uint64_t inserted = std::max<uint64_t>(1, next_id.load(std::memory_order_relaxed));
+        if (cfg.dist == "uniform") return rng() % inserted;
+        uint64_t rank = zipf->next(u01(rng));
+        if (cfg.dist == "latest") return inserted - 1 - std::min(rank, inserted - 1); // 越新越热
+        return fnv1a64(rank) % cfg.records;
+    }
+
+    void write(std::mt19937_64& rng, uint64_t id, std::vector<Table::Value>& row) {
+        fillRow(cfg, id, rng, row);
+        table.insertRow(row, log_writes);
+    }
+
+    void read(uint64_t id) {
+        auto res = table.querySnapshot("Key", keyName(id));
+        (void)res;
+    }
+
+public:
+    WorkloadRunner(const BenchConfig& c, Table& t) : cfg(c), table(t), next_id(0), log_writes(c.durability != "none") {
+        if (cfg.dist != "uniform") zipf = std::make_unique<ZipfGenerator>(std::max<size_t>(cfg.records, 1), cfg.theta);
+    }
+
+    // 装载：key 0 .. records-1，按线程切成连续区间
+    PhaseResult load() {
+        std::vector<ThreadState> states(cfg.threads);
+        auto start = Clock::now();
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < cfg.threads; ++w) {
+            threads.emplace_back([&, w] {
+                std::mt19937_64 rng(cfg.seed * 1000003 + w);
+                std::vector<Table::Value> row;
+                size_t begin = cfg.records * w / cfg.threads, end = cfg.records * (w + 1) / cfg.threads;
+                for (size_t id = begin; id < end; ++id) {
+                    auto t0 = Clock::now();
+                    write(rng, id, row);
+                    states[w].ops[OP_INSERT].record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+                }
+                table.releaseRowLease();
+            });
+        }
+        for (auto& th : threads) th.join();
+        next_id = cfg.records;
+        return collect(states, start);
+    }
+
+    PhaseResult run() {
+        std::vector<ThreadState> states(cfg.threads);
+        auto start = Clock::now();
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < cfg.threads; ++w) {
+            threads.emplace_back([&, w] {
+                std::mt19937_64 rng(cfg.seed * 7919 + w + 1);
+                std::uniform_real_distribution<double> u01(0.0, 1.0);
+                std::vector<Table::Value> row;
+                size_t count = cfg.ops * (w + 1) / cfg.threads - cfg.ops * w / cfg.threads;
+                for (size_t i = 0; i < count; ++i) {
+                    // 选操作
+                    double p = u01(rng);
+                    int op = 0;
+                    while (op < OP_COUNT - 1 && p >= cfg.mix[op]) p -= cfg.mix[op++];
+
+                    auto t0 = Clock::now();
+                    switch (op) {
+                        case OP_READ: read(chooseKey(rng, u01)); break;
+                        case OP_UPDATE: write(rng, chooseKey(rng, u01), row); break;
+                        case OP_INSERT: write(rng, next_id.fetch_add(1), row); break;
+                        case OP_RMW: {
+                            uint64_t id = chooseKey(rng, u01);
+                            read(id);
+                            write(rng, id, row);
+                            break;
+                        }
+                    }
+                    states[w].ops[op].record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+                }
+                table.releaseRowLease();
+            });
+        }
+        for (auto& th : threads) th.join();
+        return collect(states, start);
+    }
+
+private:
+    static PhaseResult collect(const std::vector<ThreadState>& states, Clock::time_point start) {
+        PhaseResult res;
+        res.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        for (const auto& s : states) {
+            for (int op = 0; op < OP_COUNT; ++op) res.ops[op].merge(s.ops[op]);
+        }
+        return res;
+    }
+};
+
+// --- 输出 ---
+double opsPerSec(uint64_t n, double ms) { return ms > 0 ? n / ms * 1000.0 : 0.0; }
+
+void printPhase(const std::string& label, const PhaseResult& res) {
+    std::cout << "[" << label << "] " << res.total() << " ops in " << std::fixed << std::setprecision(1) << res.ms
+              << " ms | " << std::setprecision(0) << opsPerSec(res.total(), res.ms) << " ops/s" << std::endl;
+    for (int op = 0; op < OP_COUNT; ++op) {
+        const LatencyHistogram& h = res.ops[op];
+        if (h.count() == 0) continue;
+        std::cout << "  " << std::left << std::setw(7) << OP_NAMES[op] << std::right << std::setprecision(2)
+                  << " count " << std::setw(9) << h.count() << " | us: mean " << std::setw(8) << h.mean() / 1000.0
+                  << " p50 " << std::setw(8) << h.percentile(0.50) / 1000.0
+                  << " p99 " << std::setw(8) << h.percentile(0.99) / 1000.0
+                  << " p999 " << std::setw(9) << h.percentile(0.999) / 1000.0
+                  << " max " << std::setw(10) << h.max() / 1000.0 << std::endl;
+    }
+}
+
+void jsonPhase(std::ostream& out, const PhaseResult& res) {
+    out << "{\"ms\": " << res.ms << ", \"ops\": " << res.total() << ", \"ops_per_sec\": " << opsPerSec(res.total(), res.ms)
+        << ", \"latency_ns\": {";
+    bool first = true;
+    for (int op = 0; op < OP_COUNT; ++op) {
+        const LatencyHistogram& h = res.ops[op];
+        if (h.count() == 0) continue;
+        out << (first ? "" : ", ") << "\"" << OP_NAMES[op] << "\": {\"count\": " << h.count() << ", \"mean\": " << h.mean()
+            << ", \"min\": " << h.min() << ", \"p50\": " << h.percentile(0.50) << ", \"p99\": " << h.percentile(0.99)
+            << ", \"p999\": " << h.percentile(0.999) << ", \"max\": " << h.max() << "}";
+        first = false;
+    }
+    out << "}}";
+}
+
+void writeJson(const std::string& path, const BenchConfig& cfg, const PhaseResult& load, const PhaseResult& run) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Cannot open " + path);
+    out << std::setprecision(6);
+    out << "{\n  \"config\": {\"workload\": \"" << cfg.workload << "\", \"threads\": " << cfg.threads
+        << ", \"records\": " << cfg.records << ", \"ops\": " << cfg.ops << ", \"schema\": \"" << cfg.schema
+        << "\", \"distribution\": \"" << cfg.dist << "\", \"theta\": " << cfg.theta << ", \"durability\": \""
+        << cfg.durability << "\", \"gc_ms\": " << cfg.gc_ms << ", \"seed\": " << cfg.seed << ", \"mix\": {";
+    for (int op = 0; op < OP_COUNT; ++op) out << (op ? ", " : "") << "\"" << OP_NAMES[op] << "\": " << cfg.mix[op];
+    out << "}},\n  \"load\": ";
+    jsonPhase(out, load);
+    out << ",\n  \"run\": ";
+    jsonPhase(out, run);
+    out << "\n}\n";
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    std::string err = parseArgs(argc, argv, cfg);
+    if (!err.empty()) {
+        std::cout << "Error: " << err << std::endl;
+        printUsage();
+        return 1;
+    }
+
+    std::cout << "=== HavanaDB Workload Benchmark ===" << std::endl;
+    std::cout << "workload " << cfg.workload << " | schema " << cfg.schema << " | threads " << cfg.threads
+              << " | records " << cfg.records << " | ops " << cfg.ops << " | dist " << cfg.dist;
+    if (cfg.dist != "uniform") std::cout << " (theta " << cfg.theta << ")";
+    std::cout << " | durability " << cfg.durability << std::endl;
+    std::cout << "mix:";
+    for (int op = 0; op < OP_COUNT; ++op) {
+        if (cfg.mix[op] > 0) std::cout << " " << OP_NAMES[op] << " " << cfg.mix[op] * 100 << "%";
+    }
+    std::cout << std::endl;
+
+    auto table = makeTable(cfg);
+    WorkloadRunner runner(cfg, *table);
+    PhaseResult load = runner.load();
+    printPhase("LOAD", load);
+
+    if (cfg.gc_ms > 0) table->startGarbageCollector(cfg.gc_ms);
+    PhaseResult run = runner.run();
+    table->stopGarbageCollector();
+    printPhase("RUN", run);
+
+    if (!cfg.json_path.empty()) {
+        writeJson(cfg.json_path, cfg, load, run);
+        std::cout << "Results written to " << cfg.json_path << std::endl;
+    }
+    return 0;
+}